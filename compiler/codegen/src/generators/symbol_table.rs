@@ -7,7 +7,7 @@ use std::sync::Arc;
 use libeir_intern::{Ident, Symbol};
 use libeir_ir::FunctionIdent;
 
-use liblumen_core::symbols::FunctionSymbol;
+use liblumen_core::symbols::{FunctionSymbol, PerfectHash};
 use liblumen_llvm as llvm;
 use liblumen_llvm::builder::ModuleBuilder;
 use liblumen_llvm::enums::{Linkage, ThreadLocalMode};
@@ -22,8 +22,11 @@ use crate::Result;
 /// This is similar to the atom table generation, but simpler, in that we just generate
 /// a large list of `FunctionSybmol` structs, which reference extern declarations of all
 /// the functions defined by the build. At link time these will be resolved to pointers
-/// to the actual functions, and when we boot the runtime, we can reify this array into
-/// a more efficient search structure for dispatch.
+/// to the actual functions.
+///
+/// The list is laid out as a `DispatchTable`: each symbol is placed in the slot given by a
+/// minimal perfect hash chosen here, and the hash parameters are emitted alongside it, so
+/// the runtime can dispatch through the table directly, without building anything at boot.
 pub fn generate(
     options: &Options,
     context: &llvm::Context,
@@ -59,9 +62,15 @@ pub fn generate(
         &[usize_type, usize_type, i8_type, fn_ptr_type],
     );
 
-    // Build values for array
+    // Sort the symbols so that the generated table is reproducible, then
+    // choose the perfect hash which determines the slot of each of them
+    let mut symbols = symbols.into_iter().collect::<Vec<_>>();
+    symbols.sort_by_key(|s| (s.module, s.function, s.arity));
+    let hash = PerfectHash::build(symbols.as_slice());
+
+    // Build values for array, in slot order
     let mut functions = Vec::with_capacity(symbols.len());
-    for symbol in symbols.iter() {
+    for symbol in hash.slots.iter().map(|&i| &symbols[i]) {
         let decl = declare_extern_symbol(&builder, symbol)?;
         let decl_ptr = builder.build_pointer_cast(decl, fn_ptr_type);
         let module = builder.build_constant_uint(usize_type, symbol.module as u64);
@@ -86,7 +95,7 @@ pub fn generate(
 
     let function_ptr_type = builder.get_pointer_type(function_symbol_type);
     let table_global_init = builder.build_const_inbounds_gep(functions_const, &[0, 0]);
-    let table_global = builder.build_global(
+    let table_global = builder.build_constant(
         function_ptr_type,
         "__LUMEN_SYMBOL_TABLE",
         Some(table_global_init),
@@ -95,13 +104,52 @@ pub fn generate(
 
     // Generate array length global
     let table_size_global_init = builder.build_constant_uint(usize_type, functions.len() as u64);
-    let table_size_global = builder.build_global(
+    let table_size_global = builder.build_constant(
         usize_type,
         "__LUMEN_SYMBOL_TABLE_SIZE",
         Some(table_size_global_init),
     );
     builder.set_alignment(table_size_global, 8);
 
+    // Generate the perfect hash parameters for the table
+    let i64_type = builder.get_i64_type();
+    let displacements = hash
+        .displacements
+        .iter()
+        .map(|&d| builder.build_constant_uint(i64_type, d))
+        .collect::<Vec<_>>();
+    let displacements_const_init = builder.build_constant_array(i64_type, displacements.as_slice());
+    let displacements_const_ty = builder.type_of(displacements_const_init);
+    let displacements_const = builder.build_constant(
+        displacements_const_ty,
+        "__LUMEN_DISPATCH_DISPLACEMENTS_ENTRIES",
+        Some(displacements_const_init),
+    );
+    builder.set_linkage(displacements_const, Linkage::Private);
+    builder.set_alignment(displacements_const, 8);
+
+    let displacements_global_init = builder.build_const_inbounds_gep(displacements_const, &[0, 0]);
+    let displacements_global = builder.build_constant(
+        builder.get_pointer_type(i64_type),
+        "__LUMEN_DISPATCH_DISPLACEMENTS",
+        Some(displacements_global_init),
+    );
+    builder.set_alignment(displacements_global, 8);
+
+    let displacements_size_init =
+        builder.build_constant_uint(usize_type, displacements.len() as u64);
+    let displacements_size_global = builder.build_constant(
+        usize_type,
+        "__LUMEN_DISPATCH_DISPLACEMENTS_SIZE",
+        Some(displacements_size_init),
+    );
+    builder.set_alignment(displacements_size_global, 8);
+
+    let hash_key_init = builder.build_constant_uint(i64_type, hash.key);
+    let hash_key_global =
+        builder.build_constant(i64_type, "__LUMEN_DISPATCH_HASH_KEY", Some(hash_key_init));
+    builder.set_alignment(hash_key_global, 8);
+
     // Generate thread local variable for current reduction count
     let i32_type = builder.get_i32_type();
     let reduction_count_init = builder.build_constant_uint(i32_type, 0);
@@ -122,6 +170,17 @@ pub fn generate(
     builder.set_linkage(process_signal_global, Linkage::External);
     builder.set_alignment(process_signal_global, 8);
 
+    // Generate thread local variables for the bounds of the allocation buffer
+    // used by generated code to allocate terms inline on the process heap
+    let i8ptr_type = builder.get_pointer_type(i8_type);
+    for name in &["__lumen_heap_top", "__lumen_heap_limit"] {
+        let heap_ptr_init = builder.build_constant_null(i8ptr_type);
+        let heap_ptr_global = builder.build_global(i8ptr_type, name, Some(heap_ptr_init));
+        builder.set_thread_local_mode(heap_ptr_global, ThreadLocalMode::LocalExec);
+        builder.set_linkage(heap_ptr_global, Linkage::External);
+        builder.set_alignment(heap_ptr_global, 8);
+    }
+
     // We have to build a shim for the Rust libstd `lang_start_internal`
     // function to start the Rust runtime. Since that symbol is internal,
     // we locate the mangled symbol name at build time and build a shim
@@ -14,7 +14,9 @@ function(lumen_glob_lit_tests)
     get_filename_component(_TEST_NAME ${_TEST_FILE} NAME_WE)
     set(_NAME "${_PACKAGE_NAME}_${_TEST_NAME}")
 
-    add_test(NAME ${_NAME} COMMAND ${CMAKE_SOURCE_DIR}/tools/run_lit.sh ${_TEST_FILE} ${CMAKE_SOURCE_DIR}/tools/LumenFileCheck.sh WORKING_DIRECTORY ${CMAKE_BINARY_DIR}/tools)
+    # The runner puts the executables found under the working directory on the
+    # PATH, which is where the FileCheck symlinks of test/ are created
+    add_test(NAME ${_NAME} COMMAND ${PROJECT_SOURCE_DIR}/test/run_lit.sh ${_TEST_FILE} WORKING_DIRECTORY ${PROJECT_BINARY_DIR}/test)
     set_tests_properties(${_NAME} PROPERTIES DEPENDS _TOOL_DEPS)
   endforeach()
 endfunction()
@@ -44,6 +44,12 @@ struct InsertTraceConstructorsPass
             Value trace = landingPad.trace();
             forAllTraceUses(builder, landingPad.getLoc(), trace, Value(), 0);
         });
+        // A throw to a handler in the same function branches to it directly,
+        // so the trace reaches the handler without passing a landing pad
+        op.walk([&](TraceCaptureOp capture) {
+            Value trace = capture.capture();
+            forAllTraceUses(builder, capture.getLoc(), trace, Value(), 0);
+        });
 
         return;
     }
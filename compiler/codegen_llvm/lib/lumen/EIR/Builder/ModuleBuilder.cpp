@@ -51,6 +51,8 @@ using llvm_null = ValueBuilder<LLVM::NullOp>;
 using eir_br = OperationBuilder<::lumen::eir::BranchOp>;
 using eir_call = OperationBuilder<::lumen::eir::CallOp>;
 using eir_invoke = OperationBuilder<::lumen::eir::InvokeOp>;
+using eir_call_indirect = OperationBuilder<::lumen::eir::CallIndirectOp>;
+using eir_invoke_indirect = OperationBuilder<::lumen::eir::InvokeIndirectOp>;
 using eir_cond_br = OperationBuilder<::lumen::eir::CondBranchOp>;
 using eir_landingpad = OperationBuilder<::lumen::eir::LandingPadOp>;
 using eir_return = OperationBuilder<::lumen::eir::ReturnOp>;
@@ -761,66 +763,48 @@ void ModuleBuilder::build_map_update(MapUpdate op) {
 
     ArrayRef<MapAction> actions(op.actionsv, op.actionsv + op.actionsc);
     Value map = unwrap(op.map);
-    // Each insert or update implicitly branches to a continuation block for the
-    // next insert/update; the last continuation block simply branches
-    // unconditionally to the ok block
-    Block *current = builder.getInsertionBlock();
-    Block *ok;
+    Block *ok = unwrap(op.ok);
     Block *err = unwrap(op.err);
 
     // For empty maps, we simply branch to the continuation block
     if (actions.size() == 0) {
-        ok = unwrap(op.ok);
         builder.create<BranchOp>(loc, ok, ValueRange{map});
         return;
     }
 
-    auto mapType = builder.getType<BoxType>(builder.getType<MapType>());
-
-    unsigned numActions = actions.size();
-    unsigned lastAction = numActions - 1;
-    for (unsigned i = 0; i < numActions; i++) {
-        MapAction action = actions[i];
-        Value key = unwrap(action.key);
-        Value val = unwrap(action.value);
-        // Create the continuation block, which expects the updated map as arg;
-        // as well as the error block. Use the ok/error blocks provided as part
-        // of the op if this is the last action being generated
-        if (i == lastAction) {
-            ok = unwrap(op.ok);
-            // Make sure the successor block argument has the right type
-            BlockArgument succArg = ok->getArgument(0);
-            succArg.setType(mapType);
-        } else {
-            ok = builder.createBlock(err, {mapType});
-        }
-        builder.setInsertionPointToEnd(current);
+    // All of the inserts and updates are applied by a single op, which
+    // allocates the resulting map once, rather than once per action
+    SmallVector<Value, 8> args;
+    SmallVector<bool, 4> updates;
+    args.reserve(actions.size() * 2);
+    updates.reserve(actions.size());
+    for (MapAction action : actions) {
         switch (action.action) {
-        case MapActionType::Insert: {
-            auto op = builder.create<MapInsertOp>(loc, map, key, val);
-            Value newMap = op.newMap();
-            Value isOk = op.successFlag();
-            builder.create<CondBranchOp>(loc, isOk, ok, ValueRange{newMap}, err,
-                                         ValueRange{key});
+        case MapActionType::Insert:
+            updates.push_back(false);
             break;
-        }
-        case MapActionType::Update: {
-            auto op = builder.create<MapUpdateOp>(loc, map, key, val);
-            Value newMap = op.newMap();
-            Value isOk = op.successFlag();
-            builder.create<CondBranchOp>(loc, isOk, ok, ValueRange{newMap}, err,
-                                         ValueRange{key});
+        case MapActionType::Update:
+            updates.push_back(true);
             break;
-        }
         default:
             llvm::report_fatal_error(
                 "tried to construct map update op with invalid type");
         }
-        current = ok;
-        // We need to update the `map` pointer, since we're implicitly in a new
-        // block on the next iteration
-        map = current->getArgument(0);
+        args.push_back(unwrap(action.key));
+        args.push_back(unwrap(action.value));
     }
+
+    // Make sure the successor block argument has the right type
+    auto mapType = builder.getType<BoxType>(builder.getType<MapType>());
+    BlockArgument succArg = ok->getArgument(0);
+    succArg.setType(mapType);
+
+    auto updateOp = builder.create<MapUpdateManyOp>(loc, map, args, updates);
+    Value newMap = updateOp.newMap();
+    Value isOk = updateOp.successFlag();
+    Value badKey = updateOp.badKey();
+    builder.create<CondBranchOp>(loc, isOk, ok, ValueRange{newMap}, err,
+                                 ValueRange{badKey});
 }
 
 //===----------------------------------------------------------------------===//
@@ -1278,7 +1262,8 @@ extern "C" void MLIRBuildStaticCall(MLIRModuleBuilderRef b,
 
 bool ModuleBuilder::maybe_build_intrinsic(Location loc, StringRef target,
                                           ArrayRef<Value> args, bool isTail,
-                                          Block *ok, ArrayRef<Value> okArgs) {
+                                          Block *ok, ArrayRef<Value> okArgs,
+                                          Block *err) {
     // If this is a call to an intrinsic, lower accordingly
     auto buildIntrinsicFnOpt = getIntrinsicBuilder(target);
 
@@ -1294,7 +1279,34 @@ bool ModuleBuilder::maybe_build_intrinsic(Location loc, StringRef target,
                        .Case("erlang:raise/3", true)
                        .Default(false);
 
-    if (isThrow) return true;
+    if (isThrow) {
+        // If the handler is in this function, as it is for a throw in the body
+        // of a try, there is no frame to unwind, so rather than raising the
+        // exception, branch to the handler directly with the values that its
+        // landing pad would have extracted
+        if (err) {
+            Block *current = builder.getInsertionBlock();
+            auto throwOp = cast<ThrowOp>(&current->back());
+            builder.setInsertionPoint(throwOp);
+
+            Type traceTy = TraceRefType::get(builder.getContext());
+            err->getArgument(2).setType(traceTy);
+
+            SmallVector<Value, 3> handlerArgs;
+            Value values[] = {throwOp.kind(), throwOp.reason(),
+                              throwOp.trace()};
+            for (auto it : llvm::enumerate(values)) {
+                Value value = it.value();
+                Type expectedType = err->getArgument(it.index()).getType();
+                if (value.getType() != expectedType)
+                    value = eir_cast(value, expectedType);
+                handlerArgs.push_back(value);
+            }
+            eir_br(err, handlerArgs);
+            throwOp.erase();
+        }
+        return true;
+    }
 
     auto termTy = builder.getType<TermType>();
     // Tail calls directly return to caller
@@ -1334,7 +1346,8 @@ void ModuleBuilder::build_static_invoke(Location loc, StringRef target,
                                         Block *err, ArrayRef<Value> errArgs) {
     ScopedContext scope(builder, loc);
 
-    if (maybe_build_intrinsic(loc, target, args, isTail, ok, okArgs)) return;
+    if (maybe_build_intrinsic(loc, target, args, isTail, ok, okArgs, err))
+        return;
 
     auto termType = builder.getType<TermType>();
 
@@ -1418,17 +1431,8 @@ void ModuleBuilder::build_static_call(Location loc, StringRef target,
 
     // Handle tail calls
     if (isTail) {
-        // Determine if this call is a candidate for musttail, which
-        // currently means that on x86_64, the parameter counts match.
-        // For wasm32, all tail calls can be musttail. For other platforms,
-        // we'll restrict like x86_64 for now
-        bool canMustTail = archType == llvm::Triple::ArchType::wasm32;
-        if (!canMustTail) {
-            auto currentFun = cast<FuncOp>(builder.getBlock()->getParentOp());
-            canMustTail = callArgs.size() == currentFun.getNumArguments();
-        }
         Operation *call;
-        if (canMustTail) {
+        if (canMustTail(callArgs.size())) {
             auto mustTail =
                 builder.getNamedAttr("musttail", builder.getUnitAttr());
             call = eir_call(callee, fnResults, callArgs,
@@ -1483,6 +1487,82 @@ void ModuleBuilder::build_static_call(Location loc, StringRef target,
     eir_br(cont, contArgsFinal);
 }
 
+void ModuleBuilder::build_indirect_call(Location loc, Value callee,
+                                        ArrayRef<Value> args, bool isTail,
+                                        Block *ok, ArrayRef<Value> okArgs,
+                                        Block *err, ArrayRef<Value> errArgs) {
+    ScopedContext scope(builder, loc);
+
+    auto termType = builder.getType<TermType>();
+
+    // Nothing is known about the callee, so all arguments are passed as terms
+    SmallVector<Value, 2> callArgs;
+    for (auto arg : args) {
+        if (arg.getType() != termType) {
+            callArgs.push_back(eir_cast(arg, termType));
+        } else {
+            callArgs.push_back(arg);
+        }
+    }
+
+    bool isInvoke = !isTail && err != nullptr;
+    if (isInvoke) {
+        Block *unwind = build_landing_pad(loc, err);
+        if (!ok) {
+            Block *normal = createBlock({termType});
+            eir_invoke_indirect(callee, callArgs, normal, okArgs, unwind,
+                                errArgs);
+            appendToBlock(normal, [&](ValueRange results) {
+                eir_return(ValueRange(results));
+            });
+        } else {
+            eir_invoke_indirect(callee, callArgs, ok, okArgs, unwind, errArgs);
+        }
+        return;
+    }
+
+    if (isTail) {
+        StringRef tailKind = canMustTail(callArgs.size()) ? "musttail" : "tail";
+        auto tail = builder.getNamedAttr(tailKind, builder.getUnitAttr());
+        Operation *call = eir_call_indirect(callee, ArrayRef<Type>{termType},
+                                            callArgs,
+                                            ArrayRef<NamedAttribute>{tail});
+        eir_return(call->getResults());
+        return;
+    }
+
+    auto tail = builder.getNamedAttr("tail", builder.getUnitAttr());
+    Operation *call = eir_call_indirect(callee, ArrayRef<Type>{termType},
+                                        callArgs,
+                                        ArrayRef<NamedAttribute>{tail});
+
+    // The result is an opaque term, so it only needs a cast if the
+    // continuation block expects something more specific
+    SmallVector<Value, 1> contArgs;
+    Value callResult = call->getResult(0);
+    Type contArgTy = ok->getArgument(0).getType();
+    if (contArgTy.isa<TermType>()) {
+        contArgs.push_back(callResult);
+    } else {
+        contArgs.push_back(eir_cast(callResult, contArgTy));
+    }
+    for (auto arg : okArgs) {
+        contArgs.push_back(arg);
+    }
+    eir_br(ok, contArgs);
+}
+
+bool ModuleBuilder::canMustTail(unsigned numArgs) {
+    // Determine if a tail call is a candidate for musttail, which
+    // currently means that on x86_64, the parameter counts match.
+    // For wasm32, all tail calls can be musttail. For other platforms,
+    // we'll restrict like x86_64 for now
+    if (archType == llvm::Triple::ArchType::wasm32) return true;
+
+    auto currentFun = cast<FuncOp>(builder.getBlock()->getParentOp());
+    return numArgs == currentFun.getNumArguments();
+}
+
 extern "C" void MLIRBuildClosureCall(MLIRModuleBuilderRef b,
                                      MLIRLocationRef locref, MLIRValueRef cls,
                                      MLIRValueRef *argv, unsigned argc,
@@ -1536,11 +1616,8 @@ extern "C" void MLIRBuildGlobalDynamicCall(
     Block *ok = unwrap(okBlock);
     Block *err = unwrap(errBlock);
 
-    // We need to add an extra nil value to the arg list
-    // to ensure the list is proper when constructed by eir_list
     SmallVector<Value, 2> args;
     unwrapValues(argv, argc, args);
-    args.push_back(builder->build_constant_nil(loc));
 
     SmallVector<Value, 1> okArgs;
     unwrapValues(okArgv, okArgc, okArgs);
@@ -1559,10 +1636,50 @@ void ModuleBuilder::build_apply_2(Location loc, Value cls, ValueRange args,
 
     auto termTy = builder.getType<TermType>();
 
-    // We need to call apply/2 with the closure, and a list of arguments
+    // If the closure has the arity of this call, we can call its code
+    // directly, with the arguments passed in registers
+    auto resolveOp = builder.create<ResolveClosureOp>(loc, cls, args.size());
+
+    Block *current = builder.getBlock();
+    Block *applyBlock = builder.createBlock(
+        current->getParent(), std::next(Region::iterator(current)));
+    Block *noEnvBlock = builder.createBlock(applyBlock);
+    Block *envBlock = builder.createBlock(noEnvBlock);
+    Block *directBlock = builder.createBlock(envBlock);
+
+    builder.setInsertionPointToEnd(current);
+    eir_cond_br(resolveOp.found(), directBlock, ArrayRef<Value>{}, applyBlock,
+                ArrayRef<Value>{});
+
+    // Closures with an environment receive the closure itself as their
+    // first argument, from which they unpack the captured values
+    builder.setInsertionPointToEnd(directBlock);
+    eir_cond_br(resolveOp.hasEnv(), envBlock, ArrayRef<Value>{}, noEnvBlock,
+                ArrayRef<Value>{});
+
+    builder.setInsertionPointToEnd(envBlock);
+    SmallVector<Value, 3> envArgs;
+    envArgs.push_back(cls);
+    envArgs.append(args.begin(), args.end());
+    build_indirect_call(loc, resolveOp.callee(), envArgs, isTail, ok, okArgs,
+                        err, errArgs);
+
+    builder.setInsertionPointToEnd(noEnvBlock);
+    SmallVector<Value, 2> callArgs(args.begin(), args.end());
+    build_indirect_call(loc, resolveOp.callee(), callArgs, isTail, ok, okArgs,
+                        err, errArgs);
+
+    // Otherwise we need to call apply/2 with the closure, and a list of
+    // arguments, which raises the appropriate error. We need to add an extra
+    // nil value to the arg list to ensure the list is proper when constructed
+    // by eir_list
+    builder.setInsertionPointToEnd(applyBlock);
+    SmallVector<Value, 3> listElements(args.begin(), args.end());
+    listElements.push_back(build_constant_nil(loc));
+
     SmallVector<Value, 2> applyArgs;
     applyArgs.push_back(cls);
-    applyArgs.push_back(eir_list(args));
+    applyArgs.push_back(eir_list(listElements));
 
     // Then, based on whether this was an invoke or not, call apply/2
     // appropriately
@@ -1584,13 +1701,42 @@ void ModuleBuilder::build_apply_3(Location loc, Value mod, Value fun,
 
     auto termTy = builder.getType<TermType>();
 
-    // We need to call apply/3, with module/function and a list of arguments
+    // Each call site gets its own cache, which resolves the module and
+    // function to a pointer to the function implementing them, so that in
+    // the common case we can call it directly, with the arguments passed in
+    // registers
+    std::string cacheName =
+        std::string("__lumen_apply_cache.") + std::to_string(numApplyCaches++);
+    auto cacheOp =
+        builder.create<ApplyCacheOp>(loc, mod, fun, args.size(), cacheName);
+
+    Block *current = builder.getBlock();
+    Block *applyBlock = builder.createBlock(
+        current->getParent(), std::next(Region::iterator(current)));
+    Block *directBlock = builder.createBlock(applyBlock);
+
+    builder.setInsertionPointToEnd(current);
+    eir_cond_br(cacheOp.found(), directBlock, ArrayRef<Value>{}, applyBlock,
+                ArrayRef<Value>{});
+
+    builder.setInsertionPointToEnd(directBlock);
+    build_indirect_call(loc, cacheOp.callee(), args, isTail, ok, okArgs, err,
+                        errArgs);
+
+    // If there is no such function, we call apply/3, with module/function and
+    // a list of arguments, which raises the appropriate error. We need to add
+    // an extra nil value to the arg list to ensure the list is proper when
+    // constructed by eir_list
+    builder.setInsertionPointToEnd(applyBlock);
+    SmallVector<Value, 3> listElements(args.begin(), args.end());
+    listElements.push_back(build_constant_nil(loc));
+
     SmallVector<Value, 3> applyArgs;
     applyArgs.push_back(mod);
     applyArgs.push_back(fun);
-    applyArgs.push_back(eir_list(args));
+    applyArgs.push_back(eir_list(listElements));
 
-    // Then, based on whether this was an invoke or not, call apply/2
+    // Then, based on whether this was an invoke or not, call apply/3
     // appropriately
     bool isInvoke = !isTail && err != nullptr;
     if (isInvoke) {
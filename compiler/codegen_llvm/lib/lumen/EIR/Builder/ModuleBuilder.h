@@ -69,7 +69,7 @@ class ModuleBuilder {
 
     bool maybe_build_intrinsic(Location loc, StringRef target,
                                ArrayRef<Value> args, bool isTail, Block *ok,
-                               ArrayRef<Value> okArgs);
+                               ArrayRef<Value> okArgs, Block *err = nullptr);
     void build_static_invoke(Location loc, StringRef target,
                              ArrayRef<Value> args, bool isTail, Block *ok,
                              ArrayRef<Value> okArgs, Block *err,
@@ -78,6 +78,10 @@ class ModuleBuilder {
     void build_static_call(Location loc, StringRef target, ArrayRef<Value> args,
                            bool isTail, Block *ok, ArrayRef<Value> okArgs);
 
+    void build_indirect_call(Location loc, Value callee, ArrayRef<Value> args,
+                             bool isTail, Block *ok, ArrayRef<Value> okArgs,
+                             Block *err, ArrayRef<Value> errArgs);
+
     void build_apply_2(Location loc, Value closure, ValueRange args,
                        bool isTail, Block *ok, ArrayRef<Value> okArgs,
                        Block *err, ArrayRef<Value> errArgs);
@@ -166,6 +170,8 @@ class ModuleBuilder {
 
     bool isLikeMsvc();
 
+    bool canMustTail(unsigned numArgs);
+
    public:
     unsigned immediateBitWidth;
     llvm::Triple::ArchType archType;
@@ -180,6 +186,10 @@ class ModuleBuilder {
     /// it is very similar to the LLVM builder
     mlir::OpBuilder builder;
 
+    /// The number of call site caches created for dynamic calls so far, used
+    /// to give each of them a unique name
+    unsigned numApplyCaches = 0;
+
     Location loc(Span span);
 };
 
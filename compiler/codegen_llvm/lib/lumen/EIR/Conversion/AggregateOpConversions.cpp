@@ -29,7 +29,12 @@ struct ConsOpConversion : public EIROpConversion<ConsOp> {
         // cells by providing an optional pointer and index at which to
         // allocate this cell, by offsetting the pointer by `index *
         // sizeof(cell)` and then storing directly into that memory
-        Value cellPtr = ctx.buildMalloc(consTy, TypeKind::Cons, arity);
+        Value cellPtr;
+        if (op.isReserved())
+            cellPtr = ctx.buildReservedMalloc(consTy, /*words=*/2);
+        else
+            cellPtr = ctx.buildInlineMalloc(consTy, TypeKind::Cons, arity,
+                                            /*words=*/2);
         ArrayRef<Value> headIndices{zero, zero};
         Value headPtr = llvm_gep(termPtrTy, cellPtr, headIndices);
         llvm_store(head, headPtr);
@@ -54,6 +59,7 @@ struct ListOpConversion : public EIROpConversion<ListOp> {
 
         auto elements = adaptor.elements();
         auto numElements = elements.size();
+        bool reserved = op.isReserved();
 
         if (numElements == 0) {
             Value nil = eir_nil();
@@ -64,7 +70,7 @@ struct ListOpConversion : public EIROpConversion<ListOp> {
         // Lower to single cons cell if it fits
         if (numElements < 2) {
             Value head = elements.front();
-            Value list = eir_cons(head, eir_nil());
+            Value list = eir_cons(head, eir_nil(), /*alloca=*/false, reserved);
             rewriter.replaceOp(op, list);
             return success();
         }
@@ -77,10 +83,10 @@ struct ListOpConversion : public EIROpConversion<ListOp> {
             if (!list) {
                 Value tail = elements[--currentIndex];
                 Value head = elements[--currentIndex];
-                list = eir_cons(head, tail);
+                list = eir_cons(head, tail, /*alloca=*/false, reserved);
             } else {
                 Value head = elements[--currentIndex];
-                list = eir_cons(head, list);
+                list = eir_cons(head, list, /*alloca=*/false, reserved);
             }
         }
 
@@ -107,7 +113,12 @@ struct TupleOpConversion : public EIROpConversion<TupleOp> {
 
         // Allocate header on heap, write values to header, then box
         Value arity = llvm_constant(termTy, ctx.getIntegerAttr(numElements));
-        Value ptr = ctx.buildMalloc(tupleTy, TypeKind::Tuple, arity);
+        Value ptr;
+        if (op.isReserved())
+            ptr = ctx.buildReservedMalloc(tupleTy, /*words=*/numElements + 1);
+        else
+            ptr = ctx.buildInlineMalloc(tupleTy, TypeKind::Tuple, arity,
+                                        /*words=*/numElements + 1);
 
         Value zero = llvm_constant(i32Ty, ctx.getI32Attr(0));
         auto headerRaw =
@@ -133,12 +144,36 @@ struct TupleOpConversion : public EIROpConversion<TupleOp> {
     }
 };
 
+struct TupleArityOpConversion : public EIROpConversion<TupleArityOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        TupleArityOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        auto ctx = getRewriteContext(op, rewriter);
+        TupleArityOpAdaptor adaptor(operands);
+
+        auto termTy = ctx.getUsizeType();
+        auto termPtrTy = termTy.getPointerTo();
+        auto i32Ty = ctx.getI32Type();
+
+        // The header is the first word of the tuple
+        Value headerPtr = llvm_bitcast(termPtrTy, adaptor.tuple());
+        Value arity = ctx.decodeHeaderValue(llvm_load(headerPtr));
+        if (ctx.targetInfo.pointerSizeInBits > 32)
+            arity = llvm_trunc(i32Ty, arity);
+
+        rewriter.replaceOp(op, arity);
+        return success();
+    }
+};
+
 void populateAggregateOpConversionPatterns(OwningRewritePatternList &patterns,
                                            MLIRContext *context,
                                            EirTypeConverter &converter,
                                            TargetInfo &targetInfo) {
-    patterns.insert<ConsOpConversion, ListOpConversion, TupleOpConversion>(
-        context, converter, targetInfo);
+    patterns.insert<ConsOpConversion, ListOpConversion, TupleOpConversion,
+                    TupleArityOpConversion>(context, converter, targetInfo);
 }
 
 }  // namespace eir
@@ -3,6 +3,62 @@
 namespace lumen {
 namespace eir {
 
+// Returns the size of a segment in bits, if the size is a constant
+static Optional<uint64_t> getStaticSegmentBits(Value size,
+                                               IntegerAttr unitAttr) {
+    if (!size) return llvm::None;
+    auto intOp = dyn_cast_or_null<ConstantIntOp>(size.getDefiningOp());
+    if (!intOp) return llvm::None;
+    auto value = intOp.getValue().cast<APIntAttr>().getValue();
+    if (value.isNegative() || !value.isIntN(16)) return llvm::None;
+    uint64_t unit = unitAttr ? unitAttr.getValue().getLimitedValue() : 1;
+    return value.getLimitedValue() * unit;
+}
+
+// The layouts of `HeapBin` and `ProcBin` in liblumen_alloc, in words:
+//
+//   HeapBin: header, flags, data
+//   ProcBin: header, inner, link (2 words)
+//
+// where `inner` points to a `ProcBinInner`: refc, flags, data. Binaries of
+// more than HEAP_BIN_MAX_SIZE bytes are always allocated as a `ProcBin`
+static constexpr unsigned HEAP_BIN_DATA = 2;
+static constexpr unsigned PROC_BIN_INNER = 1;
+static constexpr unsigned PROC_BIN_INNER_DATA = 2;
+static constexpr uint64_t HEAP_BIN_MAX_SIZE = 64;
+
+// Returns the size in bytes of the binary constructed by `op`, if it is
+// allocated up front, see `PresizeBinaries.cpp`
+static Optional<uint64_t> getPresizedBinarySize(Operation *op) {
+    auto sizeAttr = op->getAttrOfType<IntegerAttr>("binary_size");
+    if (!sizeAttr) return llvm::None;
+    return sizeAttr.getValue().getLimitedValue();
+}
+
+// Returns a pointer to the data of `bin`, a binary of `size` bytes allocated
+// by `__lumen_builtin_binary_alloc`
+template <typename Op>
+static Value buildBinaryData(RewritePatternContext<Op> &ctx, Value bin,
+                             uint64_t size) {
+    auto termTy = ctx.getUsizeType();
+    auto termPtrTy = termTy.getPointerTo();
+    auto i8PtrTy = ctx.getI8Type().getPointerTo();
+
+    Value ptr = ctx.decodeBoxedTerm(bin);
+    unsigned dataIndex = HEAP_BIN_DATA;
+    if (size > HEAP_BIN_MAX_SIZE) {
+        Value innerIndex =
+            llvm_constant(termTy, ctx.getIntegerAttr(PROC_BIN_INNER));
+        Value inner =
+            llvm_load(llvm_gep(termPtrTy, ptr, ArrayRef<Value>{innerIndex}));
+        ptr = llvm_inttoptr(termPtrTy, inner);
+        dataIndex = PROC_BIN_INNER_DATA;
+    }
+    Value index = llvm_constant(termTy, ctx.getIntegerAttr(dataIndex));
+    return llvm_bitcast(i8PtrTy,
+                        llvm_gep(termPtrTy, ptr, ArrayRef<Value>{index}));
+}
+
 struct BinaryStartOpConversion : public EIROpConversion<BinaryStartOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -12,6 +68,22 @@ struct BinaryStartOpConversion : public EIROpConversion<BinaryStartOp> {
         auto ctx = getRewriteContext(op, rewriter);
 
         auto termTy = ctx.getUsizeType();
+
+        // The finished binary is allocated right away, and the segments
+        // written into it in place
+        if (auto size = getPresizedBinarySize(op)) {
+            StringRef symbolName("__lumen_builtin_binary_alloc");
+            auto callee =
+                ctx.getOrInsertFunction(symbolName, termTy, {termTy});
+            auto calleeSymbol =
+                FlatSymbolRefAttr::get(symbolName, callee->getContext());
+            Value sizeVal =
+                llvm_constant(termTy, ctx.getIntegerAttr(size.getValue()));
+            rewriter.replaceOpWithNewOp<mlir::CallOp>(
+                op, calleeSymbol, termTy, ArrayRef<Value>{sizeVal});
+            return success();
+        }
+
         StringRef symbolName("__lumen_builtin_binary_start");
         auto callee = ctx.getOrInsertFunction(symbolName, termTy, {});
 
@@ -31,6 +103,12 @@ struct BinaryFinishOpConversion : public EIROpConversion<BinaryFinishOp> {
         ConversionPatternRewriter &rewriter) const override {
         auto ctx = getRewriteContext(op, rewriter);
 
+        // A presized binary is already the finished binary
+        if (getPresizedBinarySize(op)) {
+            rewriter.replaceOp(op, operands[0]);
+            return success();
+        }
+
         auto termTy = ctx.getUsizeType();
         StringRef symbolName("__lumen_builtin_binary_finish");
         auto callee = ctx.getOrInsertFunction(symbolName, termTy, {termTy});
@@ -69,6 +147,13 @@ struct BinaryPushOpConversion : public EIROpConversion<BinaryPushOp> {
         auto pushType = static_cast<uint32_t>(
             op.getAttrOfType<IntegerAttr>("type").getValue().getLimitedValue());
 
+        if (auto binarySize = getPresizedBinarySize(op)) {
+            Value successFlag = buildPresizedPush(op, ctx, bin, value, pushType,
+                                                  binarySize.getValue());
+            rewriter.replaceOp(op, {bin, successFlag});
+            return success();
+        }
+
         unsigned unit = 1;
         auto endianness = Endianness::Big;
         bool isSigned = false;
@@ -268,8 +353,146 @@ struct BinaryPushOpConversion : public EIROpConversion<BinaryPushOp> {
         rewriter.replaceOp(op, {newBin, successFlag});
         return success();
     }
+
+   private:
+    // Writes the segment pushed by `op` in place, into a binary which was
+    // allocated with the size of every segment already known, producing the
+    // success flag. Integers which fit in a fixnum are written inline,
+    // everything else by the runtime, which returns false if the value
+    // doesn't fit the segment.
+    Value buildPresizedPush(BinaryPushOp op,
+                            RewritePatternContext<BinaryPushOp> &ctx,
+                            Value bin, Value value, uint32_t pushType,
+                            uint64_t binarySize) const {
+        auto &rewriter = ctx.rewriter;
+        auto termTy = ctx.getUsizeType();
+        auto i1Ty = ctx.getI1Type();
+        auto i8Ty = ctx.getI8Type();
+        auto i32Ty = ctx.getI32Type();
+        auto i8PtrTy = i8Ty.getPointerTo();
+
+        auto unitAttr = op.getAttrOfType<IntegerAttr>("unit");
+        uint64_t bits = getStaticSegmentBits(op.size(), unitAttr).getValue();
+        uint64_t offset = op.getAttrOfType<IntegerAttr>("binary_offset")
+                              .getValue()
+                              .getLimitedValue();
+
+        Value data = buildBinaryData(ctx, bin, binarySize);
+        Value offsetVal = llvm_constant(termTy, ctx.getIntegerAttr(offset));
+        Value segmentPtr = llvm_gep(i8PtrTy, data, ArrayRef<Value>{offsetVal});
+        Value bitsVal = llvm_constant(termTy, ctx.getIntegerAttr(bits));
+
+        auto buildWrite = [&](StringRef symbolName,
+                              ArrayRef<Value> args) -> Value {
+            SmallVector<LLVMType, 5> argTypes;
+            for (Value arg : args)
+                argTypes.push_back(arg.getType().cast<LLVMType>());
+            auto callee = ctx.getOrInsertFunction(symbolName, i1Ty, argTypes);
+            auto calleeSymbol =
+                FlatSymbolRefAttr::get(symbolName, callee->getContext());
+            Operation *callOp =
+                std_call(calleeSymbol, ArrayRef<Type>{i1Ty}, args);
+            return callOp->getResult(0);
+        };
+
+        if (pushType == BinarySpecifierType::Bytes) {
+            Value len = llvm_constant(termTy, ctx.getIntegerAttr(bits / 8));
+            return buildWrite("__lumen_builtin_binary_write_bytes",
+                              {segmentPtr, value, len});
+        }
+
+        auto endianness = static_cast<Endianness::Type>(
+            op.getAttrOfType<IntegerAttr>("endianness")
+                .getValue()
+                .getLimitedValue());
+        Value endiannessVal = llvm_constant(i32Ty, ctx.getI32Attr(endianness));
+        if (pushType == BinarySpecifierType::Float) {
+            return buildWrite("__lumen_builtin_binary_write_float",
+                              {segmentPtr, value, bitsVal, endiannessVal});
+        }
+        assert(pushType == BinarySpecifierType::Integer &&
+               "unexpected segment type in presized binary");
+
+        bool isSigned = op.getAttrOfType<BoolAttr>("is_signed").getValue();
+        Value signedVal = llvm_constant(i1Ty, ctx.getI1Attr(isSigned));
+        auto buildIntegerWrite = [&]() -> Value {
+            return buildWrite(
+                "__lumen_builtin_binary_write_integer",
+                {segmentPtr, value, bitsVal, signedVal, endiannessVal});
+        };
+
+        // The low bits of a decoded fixnum are only known to be those of its
+        // value within the width of the payload
+        if (endianness == Endianness::Native ||
+            bits > ctx.targetInfo.immediateBits())
+            return buildIntegerWrite();
+
+        Block *current = rewriter.getInsertionBlock();
+        Block *cont =
+            rewriter.splitBlock(current, rewriter.getInsertionPoint());
+        cont->addArgument(i1Ty);
+        Block *fastBlock = new Block();
+        Block *slowBlock = new Block();
+        auto contIt = Region::iterator(cont);
+        auto &blocks = current->getParent()->getBlocks();
+        blocks.insert(contIt, fastBlock);
+        blocks.insert(contIt, slowBlock);
+
+        rewriter.setInsertionPointToEnd(current);
+        Value isFixnum = ctx.isImmediateOfKind(value, TypeKind::Fixnum);
+        llvm_condbr(isFixnum, fastBlock, ValueRange(), slowBlock,
+                    ValueRange());
+
+        // Store the integer one byte at a time, most significant first for
+        // big-endian segments. LLVM combines these into a single unaligned
+        // store, plus a byte swap when the segment's byte order differs from
+        // the target's.
+        rewriter.setInsertionPointToEnd(fastBlock);
+        Value raw = ctx.decodeImmediate(value);
+        unsigned numBytes = bits / 8;
+        bool isBigEndian = endianness == Endianness::Big;
+        for (unsigned i = 0; i < numBytes; ++i) {
+            unsigned shiftBytes = isBigEndian ? numBytes - 1 - i : i;
+            Value byte = raw;
+            if (shiftBytes > 0) {
+                Value shift =
+                    llvm_constant(termTy, ctx.getIntegerAttr(shiftBytes * 8));
+                byte = llvm_shr(raw, shift);
+            }
+            Value index = llvm_constant(termTy, ctx.getIntegerAttr(i));
+            llvm_store(llvm_trunc(i8Ty, byte),
+                       llvm_gep(i8PtrTy, segmentPtr, ArrayRef<Value>{index}));
+        }
+        Value isSuccess = llvm_constant(i1Ty, ctx.getI1Attr(true));
+        llvm_br(ValueRange(isSuccess), cont);
+
+        rewriter.setInsertionPointToEnd(slowBlock);
+        llvm_br(ValueRange(buildIntegerWrite()), cont);
+
+        rewriter.setInsertionPointToStart(cont);
+        return cont->getArgument(0);
+    }
 };
 
+// Describes a byte-aligned, statically sized integer segment which can be
+// matched inline, without calling into the runtime
+struct InlineIntegerSegment {
+    unsigned bits;
+    bool isSigned;
+    bool isBigEndian;
+};
+
+// The layout of `MatchContext` in liblumen_alloc, in words:
+//
+//   header, original, base, bit_offset, bit_len, save_offset (2 words)
+//
+// `base` points to the start of the underlying binary data, and `bit_offset`
+// and `bit_len` are both relative to it
+static constexpr unsigned MATCH_CTX_BASE = 2;
+static constexpr unsigned MATCH_CTX_BIT_OFFSET = 3;
+static constexpr unsigned MATCH_CTX_BIT_LEN = 4;
+static constexpr unsigned MATCH_CTX_WORDS = 7;
+
 template <typename Op, typename OperandAdaptor>
 class BinaryMatchOpConversion : public EIROpConversion<Op> {
    public:
@@ -285,13 +508,194 @@ class BinaryMatchOpConversion : public EIROpConversion<Op> {
     LogicalResult matchAndRewrite(
         Op op, ArrayRef<Value> operands,
         ConversionPatternRewriter &rewriter) const override {
-        OperandAdaptor adaptor(operands);
         auto ctx = getRewriteContext(op, rewriter);
 
+        InlineIntegerSegment segment;
+        if (!getInlineSegment(op, ctx, segment)) {
+            SmallVector<Value, 3> results;
+            buildMatchCall(op, ctx, operands, results);
+            rewriter.replaceOp(op, results);
+            return success();
+        }
+
+        OperandAdaptor adaptor(operands);
         auto termTy = ctx.getUsizeType();
-        auto matchResultTy = ctx.targetInfo.getMatchResultType();
+        auto termPtrTy = termTy.getPointerTo();
         auto i1Ty = ctx.getI1Type();
         auto i8Ty = ctx.getI8Type();
+        auto i8PtrTy = i8Ty.getPointerTo();
+        Value bin = adaptor.bin();
+
+        // The segment is matched inline when the input is a match context
+        // positioned on a byte boundary, with enough bits remaining; anything
+        // else is left to the runtime. Other binaries are first wrapped in a
+        // match context by the runtime, so that only the first segment of a
+        // pattern pays for a call. Each check gets its own block, so that we
+        // never read past the header of a term which isn't a match context.
+        Block *current = rewriter.getInsertionBlock();
+        Block *cont =
+            rewriter.splitBlock(current, rewriter.getInsertionPoint());
+        cont->addArgument(termTy);
+        cont->addArgument(termTy);
+        cont->addArgument(i1Ty);
+
+        Block *headerBlock = new Block();
+        Block *startBlock = new Block();
+        Block *boundsBlock = new Block();
+        boundsBlock->addArgument(termPtrTy);
+        Block *fastBlock = new Block();
+        Block *slowBlock = new Block();
+        auto contIt = Region::iterator(cont);
+        auto &blocks = current->getParent()->getBlocks();
+        blocks.insert(contIt, headerBlock);
+        blocks.insert(contIt, startBlock);
+        blocks.insert(contIt, boundsBlock);
+        blocks.insert(contIt, fastBlock);
+        blocks.insert(contIt, slowBlock);
+
+        rewriter.setInsertionPointToEnd(current);
+        Value isBoxed = ctx.isBoxedTerm(bin);
+        llvm_condbr(isBoxed, headerBlock, ValueRange(), slowBlock,
+                    ValueRange());
+
+        rewriter.setInsertionPointToEnd(headerBlock);
+        Value ctxPtr = ctx.decodeBoxedTerm(bin);
+        Value header = llvm_load(ctxPtr);
+        auto matchCtxTag = ctx.targetInfo.matchContextTag();
+        Value isMatchCtx = ctx.isHeaderWithTag(header, matchCtxTag);
+        llvm_condbr(isMatchCtx, boundsBlock, ValueRange(ctxPtr), startBlock,
+                    ValueRange());
+
+        // The runtime returns none if the input isn't a binary
+        rewriter.setInsertionPointToEnd(startBlock);
+        StringRef startSymbol("__lumen_builtin_binary_match.start");
+        auto startCallee =
+            ctx.getOrInsertFunction(startSymbol, termTy, {termTy});
+        auto startCalleeSymbol =
+            FlatSymbolRefAttr::get(startSymbol, startCallee->getContext());
+        Operation *startCall = std_call(
+            startCalleeSymbol, ArrayRef<Type>{termTy}, ArrayRef<Value>{bin});
+        Value newCtx = startCall->getResult(0);
+        Value none = llvm_constant(
+            termTy, ctx.getIntegerAttr(ctx.targetInfo.getNoneValue()));
+        Value isStarted = llvm_icmp(LLVM::ICmpPredicate::ne, newCtx, none);
+        Value startedPtr = ctx.decodeBoxedTerm(newCtx);
+        llvm_condbr(isStarted, boundsBlock, ValueRange(startedPtr), slowBlock,
+                    ValueRange());
+
+        rewriter.setInsertionPointToEnd(boundsBlock);
+        ctxPtr = boundsBlock->getArgument(0);
+        Value offset = loadWord(ctx, ctxPtr, MATCH_CTX_BIT_OFFSET);
+        Value len = loadWord(ctx, ctxPtr, MATCH_CTX_BIT_LEN);
+        Value zero = llvm_constant(termTy, ctx.getIntegerAttr(0));
+        Value seven = llvm_constant(termTy, ctx.getIntegerAttr(7));
+        Value bits = llvm_constant(termTy, ctx.getIntegerAttr(segment.bits));
+        Value isAligned =
+            llvm_icmp(LLVM::ICmpPredicate::eq, llvm_and(offset, seven), zero);
+        Value end = llvm_add(offset, bits);
+        Value inBounds = llvm_icmp(LLVM::ICmpPredicate::ule, end, len);
+        Value canMatch = llvm_and(isAligned, inBounds);
+        llvm_condbr(canMatch, fastBlock, ValueRange(), slowBlock,
+                    ValueRange());
+
+        // Assemble the integer from individual bytes, most significant first
+        // for big-endian segments. LLVM combines these into a single
+        // unaligned load, plus a byte swap when the segment's byte order
+        // differs from the target's.
+        rewriter.setInsertionPointToEnd(fastBlock);
+        Value base =
+            llvm_inttoptr(i8PtrTy, loadWord(ctx, ctxPtr, MATCH_CTX_BASE));
+        Value three = llvm_constant(termTy, ctx.getIntegerAttr(3));
+        Value bytePtr =
+            llvm_gep(i8PtrTy, base, ArrayRef<Value>{llvm_shr(offset, three)});
+        unsigned numBytes = segment.bits / 8;
+        Value value;
+        for (unsigned i = 0; i < numBytes; ++i) {
+            Value index = llvm_constant(termTy, ctx.getIntegerAttr(i));
+            Value bytePtrI = llvm_gep(i8PtrTy, bytePtr, ArrayRef<Value>{index});
+            Value byte = llvm_zext(termTy, llvm_load(bytePtrI));
+            unsigned shiftBytes = segment.isBigEndian ? numBytes - 1 - i : i;
+            if (shiftBytes > 0) {
+                Value shift =
+                    llvm_constant(termTy, ctx.getIntegerAttr(shiftBytes * 8));
+                byte = llvm_shl(byte, shift);
+            }
+            value = value ? llvm_or(value, byte) : byte;
+        }
+        unsigned extraBits = ctx.targetInfo.pointerSizeInBits - segment.bits;
+        if (segment.isSigned && extraBits > 0) {
+            Value shift = llvm_constant(termTy, ctx.getIntegerAttr(extraBits));
+            value = llvm_ashr(llvm_shl(value, shift), shift);
+        }
+        Value matched =
+            ctx.encodeImmediate(rewriter.getType<FixnumType>(), value);
+
+        // The tail is a copy of the input context, advanced past the segment;
+        // the input is left untouched, as later clauses may match against it
+        Value arity = llvm_constant(termTy, ctx.getIntegerAttr(0));
+        Value newCtxPtr = ctx.buildInlineMalloc(
+            termTy, TypeKind::Binary, arity, MATCH_CTX_WORDS);
+        for (unsigned i = 0; i < MATCH_CTX_WORDS; ++i) {
+            Value word =
+                i == MATCH_CTX_BIT_OFFSET ? end : loadWord(ctx, ctxPtr, i);
+            Value index = llvm_constant(termTy, ctx.getIntegerAttr(i));
+            llvm_store(word,
+                       llvm_gep(termPtrTy, newCtxPtr, ArrayRef<Value>{index}));
+        }
+        Value rest = ctx.encodeBox(newCtxPtr);
+        Value isSuccess = llvm_constant(i1Ty, ctx.getI1Attr(true));
+        llvm_br(ValueRange{matched, rest, isSuccess}, cont);
+
+        rewriter.setInsertionPointToEnd(slowBlock);
+        SmallVector<Value, 3> results;
+        buildMatchCall(op, ctx, operands, results);
+        llvm_br(results, cont);
+
+        rewriter.setInsertionPointToStart(cont);
+        rewriter.replaceOp(op, {cont->getArgument(0), cont->getArgument(1),
+                                cont->getArgument(2)});
+        return success();
+    }
+
+   protected:
+    virtual void addExtraArgTypes(RewritePatternContext<Op> &ctx,
+                                  SmallVectorImpl<LLVMType> &types) const {
+        return;
+    };
+    virtual void addExtraArgValues(Op &op, RewritePatternContext<Op> &ctx,
+                                   SmallVectorImpl<Value> &args) const {
+        return;
+    };
+    // Returns true if the segment can be matched inline, in which case
+    // `segment` describes it; by default all segments are matched by the
+    // runtime
+    virtual bool getInlineSegment(Op &op, RewritePatternContext<Op> &ctx,
+                                  InlineIntegerSegment &segment) const {
+        return false;
+    }
+
+   private:
+    using EIROpConversion<Op>::getRewriteContext;
+
+    Value loadWord(RewritePatternContext<Op> &ctx, Value ptr,
+                   unsigned index) const {
+        auto termTy = ctx.getUsizeType();
+        Value i = llvm_constant(termTy, ctx.getIntegerAttr(index));
+        return llvm_load(
+            llvm_gep(termTy.getPointerTo(), ptr, ArrayRef<Value>{i}));
+    }
+
+    // Calls the runtime to perform the match, placing the matched value, the
+    // tail and the success flag in `results`
+    void buildMatchCall(Op &op, RewritePatternContext<Op> &ctx,
+                        ArrayRef<Value> operands,
+                        SmallVectorImpl<Value> &results) const {
+        OperandAdaptor adaptor(operands);
+        auto &rewriter = ctx.rewriter;
+
+        auto termTy = ctx.getUsizeType();
+        auto matchResultTy = ctx.targetInfo.getMatchResultType();
+        auto i1Ty = ctx.getI1Type();
 
         // Define match function to be called
         // __lumen_builtin_binary_match.<type>(bin, ..args.., size) ->
@@ -310,7 +714,7 @@ class BinaryMatchOpConversion : public EIROpConversion<Op> {
 
         // Get operands to work with
         auto bin = adaptor.bin();
-        auto opArgs = operands;
+        auto opArgs = operands.drop_front();
         auto numOpArgs = opArgs.size();
 
         // Handle optional size parameter, using a none val to represent no size
@@ -339,29 +743,14 @@ class BinaryMatchOpConversion : public EIROpConversion<Op> {
         // Obtain the result values from the match result structure and map them
         // to the op outputs
         Value result = matchOp.getResult(0);
-        Value matched =
-            llvm_extractvalue(termTy, result, ctx.getI64ArrayAttr(0));
-        Value tail = llvm_extractvalue(termTy, result, ctx.getI64ArrayAttr(1));
-        Value successFlag =
-            llvm_extractvalue(i1Ty, result, ctx.getI64ArrayAttr(2));
-
-        rewriter.replaceOp(op, {matched, tail, successFlag});
-        return success();
+        results.push_back(
+            llvm_extractvalue(termTy, result, ctx.getI64ArrayAttr(0)));
+        results.push_back(
+            llvm_extractvalue(termTy, result, ctx.getI64ArrayAttr(1)));
+        results.push_back(
+            llvm_extractvalue(i1Ty, result, ctx.getI64ArrayAttr(2)));
     }
 
-   protected:
-    virtual void addExtraArgTypes(RewritePatternContext<Op> &ctx,
-                                  SmallVectorImpl<LLVMType> &types) const {
-        return;
-    };
-    virtual void addExtraArgValues(Op &op, RewritePatternContext<Op> &ctx,
-                                   SmallVectorImpl<Value> &args) const {
-        return;
-    };
-
-   private:
-    using EIROpConversion<Op>::getRewriteContext;
-
     Type _termTy;
 };
 
@@ -416,6 +805,29 @@ struct BinaryMatchIntegerOpConversion
         args.push_back(endianness);
         args.push_back(unit);
     }
+
+    bool getInlineSegment(BinaryMatchIntegerOp &op,
+                          RewritePatternContext<BinaryMatchIntegerOp> &ctx,
+                          InlineIntegerSegment &segment) const override {
+        auto endianness = op.endiannessAttr().getValue().getLimitedValue();
+        if (endianness == Endianness::Native) return false;
+
+        auto bitsOpt = getStaticSegmentBits(op.size(), op.unitAttr());
+        if (!bitsOpt.hasValue()) return false;
+        uint64_t bits = bitsOpt.getValue();
+        if (bits == 0 || bits % 8 != 0) return false;
+
+        // The matched value must always fit in a fixnum
+        bool isSigned = op.isSignedAttr().getValue();
+        unsigned fixnumBits = ctx.targetInfo.immediateBits();
+        if (ctx.targetInfo.immediateMask().requiresShift()) fixnumBits -= 1;
+        if (isSigned ? bits > fixnumBits : bits >= fixnumBits) return false;
+
+        segment.bits = bits;
+        segment.isSigned = isSigned;
+        segment.isBigEndian = endianness == Endianness::Big;
+        return true;
+    }
 };
 
 struct BinaryMatchFloatOpConversion
@@ -19,14 +19,110 @@ struct IncrementReductionsOpConversion
             "CURRENT_REDUCTION_COUNT", i32Ty, nullptr, LLVM::Linkage::External,
             LLVM::ThreadLocalMode::LocalExec);
 
+        // The counter is thread-local, and is only touched by the scheduler
+        // when the process is swapped out, so no atomic is needed here
         Value increment = llvm_constant(i32Ty, ctx.getI32Attr(op.increment()));
-        llvm_atomicrmw(i32Ty, LLVM::AtomicBinOp::add, reductionCount, increment,
-                       LLVM::AtomicOrdering::monotonic);
+        Value count = llvm_load(reductionCount);
+        llvm_store(llvm_add(count, increment), reductionCount);
         rewriter.eraseOp(op);
         return success();
     }
 };
 
+// Builds an inline check that `input` is a boxed term whose header is of the
+// given kind, returning the result as an argument of the block in which
+// lowering continues.
+//
+// Since the header can only be loaded once the input is known to be a box,
+// the check is split across blocks. If `refine` is given, it is called in a
+// block which is only reached when the header kind matched, with a pointer
+// to the term and its header, to perform any further checks (e.g. arity).
+template <typename Op>
+static Value buildBoxedTypeCheck(
+    RewritePatternContext<Op> &ctx, Value input, uint32_t kind,
+    llvm::function_ref<Value(Value, Value)> refine = nullptr) {
+    auto &rewriter = ctx.rewriter;
+    auto int1Ty = ctx.getI1Type();
+    Value falseConst = llvm_constant(int1Ty, ctx.getI1Attr(0));
+
+    Block *current = rewriter.getInsertionBlock();
+    Block *cont = rewriter.splitBlock(current, rewriter.getInsertionPoint());
+    cont->addArgument(int1Ty);
+    Block *checkHeader = new Block();
+    current->getParent()->getBlocks().insert(Region::iterator(cont),
+                                             checkHeader);
+
+    rewriter.setInsertionPointToEnd(current);
+    Value isBox = ctx.isBoxedTerm(input);
+    llvm_condbr(isBox, checkHeader, ValueRange(), cont,
+                ValueRange(falseConst));
+
+    rewriter.setInsertionPointToEnd(checkHeader);
+    Value termPtr = ctx.decodeBoxedTerm(input);
+    Value header = llvm_load(termPtr);
+    Value isKind = ctx.isHeaderOfKind(header, kind);
+    if (!refine) {
+        llvm_br(ValueRange(isKind), cont);
+    } else {
+        Block *refineBlock = new Block();
+        current->getParent()->getBlocks().insert(Region::iterator(cont),
+                                                 refineBlock);
+        llvm_condbr(isKind, refineBlock, ValueRange(), cont,
+                    ValueRange(falseConst));
+        rewriter.setInsertionPointToEnd(refineBlock);
+        Value refined = refine(termPtr, header);
+        llvm_br(ValueRange(refined), cont);
+    }
+
+    rewriter.setInsertionPointToStart(cont);
+    return cont->getArgument(0);
+}
+
+// Builds an inline check of the list pointer tag. With nanboxing, floats are
+// not boxed, and any float can have the same bits set as the list tag, so all
+// of the bits above the pointer are compared, which floats never leave clear
+template <typename Op>
+static Value buildConsTagCheck(RewritePatternContext<Op> &ctx, Value input) {
+    auto termTy = ctx.getUsizeType();
+    uint64_t tagMask = ctx.targetInfo.listMask();
+    if (!ctx.targetInfo.requiresPackedFloats())
+        tagMask = ~ctx.targetInfo.immediateMask().mask;
+    Value listTag =
+        llvm_constant(termTy, ctx.getIntegerAttr(ctx.targetInfo.listTag()));
+    Value mask = llvm_constant(termTy, ctx.getIntegerAttr(tagMask));
+    return llvm_icmp(LLVM::ICmpPredicate::eq, listTag, llvm_and(input, mask));
+}
+
+// Builds an inline check for the immediate types which can be identified by
+// their tag alone, returning a null value for all other types
+template <typename Op>
+static Value buildImmediateTypeCheck(RewritePatternContext<Op> &ctx,
+                                     OpaqueTermType matchType, Value input) {
+    auto termTy = ctx.getUsizeType();
+    auto isNil = [&]() -> Value {
+        APInt &nilValue = ctx.getNilValue();
+        Value nil = llvm_constant(termTy, ctx.getIntegerAttr(nilValue));
+        return llvm_icmp(LLVM::ICmpPredicate::eq, input, nil);
+    };
+    if (matchType.isa<AtomType>())
+        return ctx.isImmediateOfKind(input, TypeKind::Atom);
+    if (matchType.isa<FixnumType>())
+        return ctx.isImmediateOfKind(input, TypeKind::Fixnum);
+    if (matchType.isa<NilType>()) return isNil();
+    if (matchType.isa<BooleanType>()) {
+        auto falseAtom = ctx.targetInfo.encodeImmediate(TypeKind::Atom, 0);
+        auto trueAtom = ctx.targetInfo.encodeImmediate(TypeKind::Atom, 1);
+        Value falseConst = llvm_constant(termTy, ctx.getIntegerAttr(falseAtom));
+        Value trueConst = llvm_constant(termTy, ctx.getIntegerAttr(trueAtom));
+        Value isFalse = llvm_icmp(LLVM::ICmpPredicate::eq, input, falseConst);
+        Value isTrue = llvm_icmp(LLVM::ICmpPredicate::eq, input, trueConst);
+        return llvm_or(isFalse, isTrue);
+    }
+    if (matchType.isa<ListType>())
+        return llvm_or(isNil(), buildConsTagCheck(ctx, input));
+    return nullptr;
+}
+
 struct IsTypeOpConversion : public EIROpConversion<IsTypeOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -41,6 +137,14 @@ struct IsTypeOpConversion : public EIROpConversion<IsTypeOp> {
         auto int32Ty = ctx.getI32Type();
 
         auto matchType = op.getMatchType().cast<OpaqueTermType>();
+
+        // Immediates and lists can be identified by their tag alone
+        if (Value isType =
+                buildImmediateTypeCheck(ctx, matchType, adaptor.value())) {
+            rewriter.replaceOp(op, isType);
+            return success();
+        }
+
         // Boxed types and immediate types are dispatched differently
         if (matchType.isBox() ||
             matchType.isBoxable(ctx.targetInfo.immediateBits())) {
@@ -54,13 +158,8 @@ struct IsTypeOpConversion : public EIROpConversion<IsTypeOp> {
             // Lists have a unique pointer tag, so we can avoid the function
             // call
             if (boxedType.isa<ConsType>()) {
-                Value listTag = llvm_constant(
-                    termTy, ctx.getIntegerAttr(ctx.targetInfo.listTag()));
-                Value listMask = llvm_constant(
-                    termTy, ctx.getIntegerAttr(ctx.targetInfo.listMask()));
-                Value masked = llvm_and(adaptor.value(), listMask);
-                rewriter.replaceOpWithNewOp<LLVM::ICmpOp>(
-                    op, LLVM::ICmpPredicate::eq, listTag, masked);
+                rewriter.replaceOp(op,
+                                   buildConsTagCheck(ctx, adaptor.value()));
                 return success();
             }
 
@@ -86,6 +185,19 @@ struct IsTypeOpConversion : public EIROpConversion<IsTypeOp> {
                 return success();
             }
 
+            // Types with a single header tag can be checked by loading the
+            // header and comparing its tag
+            bool isPackedFloat = boxedType.isa<FloatType>() &&
+                                 ctx.targetInfo.requiresPackedFloats();
+            if (isPackedFloat || boxedType.isa<MapType>() ||
+                boxedType.isa<BigIntType>()) {
+                auto matchKind = boxedType.getTypeKind().getValue();
+                Value isType =
+                    buildBoxedTypeCheck(ctx, adaptor.value(), matchKind);
+                rewriter.replaceOp(op, isType);
+                return success();
+            }
+
             StringRef symbolName("__lumen_builtin_is_boxed_type");
             // If we're matching floats but the target doesn't use boxed floats,
             // use the correct type check function
@@ -108,11 +220,7 @@ struct IsTypeOpConversion : public EIROpConversion<IsTypeOp> {
             return success();
         }
 
-        // For immediates, the check is performed via builtin
-        //
-        // TODO: With some additional foundation-laying, we could lower
-        // these checks to precise bit masking/shift operations, rather
-        // than a function call
+        // For all other immediates, the check is performed via builtin
         auto matchKind = matchType.getTypeKind().getValue();
         Value matchConst = llvm_constant(int32Ty, ctx.getI32Attr(matchKind));
         StringRef symbolName("__lumen_builtin_is_type");
@@ -138,34 +246,20 @@ struct IsTupleOpConversion : public EIROpConversion<IsTupleOp> {
 
         Value input = adaptor.value();
         Value arity = adaptor.arity();
-        auto termTy = ctx.getUsizeType();
-        auto int1Ty = ctx.getI1Type();
-        auto int32Ty = ctx.getI32Type();
 
-        // When an arity is given, we use a special builtin
+        // Check the header tag, and when an arity is given, the arity
+        // stored in the header
+        Value isType;
         if (arity) {
-            ArrayRef<LLVMType> argTypes({termTy, termTy});
-            StringRef symbolName("__lumen_builtin_is_tuple");
-            auto callee = ctx.getOrInsertFunction(symbolName, int1Ty, argTypes);
-            auto calleeSymbol =
-                FlatSymbolRefAttr::get(symbolName, callee->getContext());
-            Operation *isType =
-                std_call(calleeSymbol, int1Ty, ValueRange{arity, input});
-            rewriter.replaceOp(op, isType->getResults());
-            return success();
+            isType = buildBoxedTypeCheck(
+                ctx, input, TypeKind::Tuple, [&](Value, Value header) -> Value {
+                    Value actual = ctx.decodeHeaderValue(header);
+                    return llvm_icmp(LLVM::ICmpPredicate::eq, actual, arity);
+                });
+        } else {
+            isType = buildBoxedTypeCheck(ctx, input, TypeKind::Tuple);
         }
-
-        // Otherwise we fall back to the generic boxed type builtin
-        Value matchConst =
-            llvm_constant(int32Ty, ctx.getI32Attr(TypeKind::Tuple));
-        StringRef symbolName("__lumen_builtin_is_boxed_type");
-        auto callee =
-            ctx.getOrInsertFunction(symbolName, int1Ty, {int32Ty, termTy});
-        auto calleeSymbol =
-            FlatSymbolRefAttr::get(symbolName, callee->getContext());
-        Operation *isType =
-            std_call(calleeSymbol, int1Ty, ValueRange{matchConst, input});
-        rewriter.replaceOp(op, isType->getResults());
+        rewriter.replaceOp(op, isType);
         return success();
     }
 };
@@ -181,34 +275,34 @@ struct IsFunctionOpConversion : public EIROpConversion<IsFunctionOp> {
 
         Value input = adaptor.value();
         Value arity = adaptor.arity();
-        auto termTy = ctx.getUsizeType();
-        auto int1Ty = ctx.getI1Type();
         auto int32Ty = ctx.getI32Type();
 
-        // When an arity is given, we use a special builtin
+        // Check the header tag, and when an arity is given, the arity of the
+        // closure, which precedes the environment, so the layout of a closure
+        // without one can be used for any closure
+        Value isType;
         if (arity) {
-            ArrayRef<LLVMType> argTypes({termTy, termTy});
-            StringRef symbolName("__lumen_builtin_is_function");
-            auto callee = ctx.getOrInsertFunction(symbolName, int1Ty, argTypes);
-            auto calleeSymbol =
-                FlatSymbolRefAttr::get(symbolName, callee->getContext());
-            Operation *isType =
-                std_call(calleeSymbol, int1Ty, ValueRange{arity, input});
-            rewriter.replaceOp(op, isType->getResults());
-            return success();
+            auto checkArity = [&](Value termPtr, Value) -> Value {
+                LLVMType closurePtrTy =
+                    ctx.targetInfo.makeClosureType(0).getPointerTo();
+                Value closurePtr = llvm_bitcast(closurePtrTy, termPtr);
+                Value zero = llvm_constant(int32Ty, ctx.getI32Attr(0));
+                Value arityIdx =
+                    llvm_constant(int32Ty, ctx.getI32Attr(CLOSURE_ARITY_INDEX));
+                Value arityPtr = llvm_gep(int32Ty.getPointerTo(), closurePtr,
+                                          ValueRange{zero, arityIdx});
+                Value actual = llvm_load(arityPtr);
+                Value expected = arity;
+                if (ctx.targetInfo.pointerSizeInBits > 32)
+                    expected = llvm_trunc(int32Ty, arity);
+                return llvm_icmp(LLVM::ICmpPredicate::eq, actual, expected);
+            };
+            isType = buildBoxedTypeCheck(ctx, input, TypeKind::Closure,
+                                         checkArity);
+        } else {
+            isType = buildBoxedTypeCheck(ctx, input, TypeKind::Closure);
         }
-
-        // Otherwise we fall back to the generic boxed type builtin
-        Value matchConst =
-            llvm_constant(int32Ty, ctx.getI32Attr(TypeKind::Closure));
-        StringRef symbolName("__lumen_builtin_is_boxed_type");
-        auto callee =
-            ctx.getOrInsertFunction(symbolName, int1Ty, {int32Ty, termTy});
-        auto calleeSymbol =
-            FlatSymbolRefAttr::get(symbolName, callee->getContext());
-        Operation *isType =
-            std_call(calleeSymbol, int1Ty, ValueRange{matchConst, input});
-        rewriter.replaceOp(op, isType->getResults());
+        rewriter.replaceOp(op, isType);
         return success();
     }
 };
@@ -0,0 +1,166 @@
+#include "lumen/EIR/Conversion/CoalesceAllocations.h"
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Target/TargetMachine.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+
+#include "lumen/EIR/Conversion/TargetInfo.h"
+#include "lumen/EIR/IR/EIRDialect.h"
+#include "lumen/EIR/IR/EIROps.h"
+
+using ::llvm::dyn_cast;
+using ::llvm::isa;
+using ::llvm::Optional;
+using ::llvm::SmallVector;
+using ::llvm::TargetMachine;
+using ::mlir::Block;
+using ::mlir::DialectRegistry;
+using ::mlir::OpBuilder;
+using ::mlir::Operation;
+using ::mlir::OperationPass;
+using ::mlir::PassWrapper;
+
+namespace {
+
+using namespace ::lumen::eir;
+
+// The largest reservation we will make for a single group, larger groups are
+// split so that we never ask the runtime for an unreasonably large buffer
+const unsigned MAX_RESERVATION_WORDS = 1024;
+
+// The heap space needed by a constructor: the number of words, and the number
+// of separate allocations it would make for them without a reservation
+struct AllocationSize {
+    unsigned words;
+    unsigned allocations;
+};
+
+// This pass groups the heap allocating constructors in each block which are
+// not separated by anything that might allocate, yield, or otherwise touch the
+// process heap, and reserves space for the whole group up front with a single
+// `eir.heap.reserve`. The constructors in the group are marked `reserved`, so
+// that they are lowered to a plain bump of the allocation buffer, rather than
+// each performing their own limit check and potential runtime call. A single
+// constructor which makes several allocations, such as a list, is reserved for
+// on its own.
+struct CoalesceAllocationsPass
+    : public PassWrapper<CoalesceAllocationsPass, OperationPass<FuncOp>> {
+    CoalesceAllocationsPass(TargetMachine *targetMachine_)
+        : targetMachine(targetMachine_),
+          PassWrapper<CoalesceAllocationsPass, OperationPass<FuncOp>>() {}
+
+    CoalesceAllocationsPass(const CoalesceAllocationsPass &other)
+        : targetMachine(other.targetMachine),
+          PassWrapper<CoalesceAllocationsPass, OperationPass<FuncOp>>() {}
+
+    void getDependentDialects(DialectRegistry &registry) const override {
+        registry.insert<mlir::StandardOpsDialect, mlir::LLVM::LLVMDialect,
+                        lumen::eir::eirDialect>();
+    }
+
+    void runOnOperation() override {
+        FuncOp op = getOperation();
+        if (op.isExternal()) return;
+
+        TargetInfo targetInfo(targetMachine, &getContext());
+        for (Block &block : op.getBody()) coalesceBlock(block, targetInfo);
+    }
+
+   private:
+    void coalesceBlock(Block &block, TargetInfo &targetInfo) {
+        SmallVector<Operation *, 4> group;
+        unsigned words = 0;
+        unsigned allocations = 0;
+
+        auto flush = [&]() {
+            // A single allocation gains nothing from a separate reservation
+            if (allocations > 1) {
+                OpBuilder builder(group.front());
+                builder.create<HeapReserveOp>(group.front()->getLoc(),
+                                              builder.getI64IntegerAttr(words));
+                for (Operation *alloc : group)
+                    alloc->setAttr("reserved", builder.getUnitAttr());
+            }
+            group.clear();
+            words = 0;
+            allocations = 0;
+        };
+
+        for (Operation &op : block) {
+            if (auto size = getAllocationSize(&op, targetInfo)) {
+                if (size->words == 0) continue;
+                if (words + size->words > MAX_RESERVATION_WORDS) flush();
+                // Too large to reserve for at all, so it allocates as usual
+                if (size->words > MAX_RESERVATION_WORDS) continue;
+                group.push_back(&op);
+                words += size->words;
+                allocations += size->allocations;
+                continue;
+            }
+            if (isTransparent(&op)) continue;
+            flush();
+        }
+        flush();
+    }
+
+    // Returns the space allocated on the process heap by the given operation,
+    // if it is a constructor we know how to coalesce
+    static Optional<AllocationSize> getAllocationSize(Operation *op,
+                                                      TargetInfo &targetInfo) {
+        if (auto consOp = dyn_cast<ConsOp>(op)) {
+            if (consOp.useAlloca() || consOp.isReserved()) return llvm::None;
+            return AllocationSize{2, 1};
+        }
+        if (auto tupleOp = dyn_cast<TupleOp>(op)) {
+            if (tupleOp.useAlloca() || tupleOp.isReserved()) return llvm::None;
+            unsigned numElements = tupleOp.elements().size();
+            return AllocationSize{numElements + 1, 1};
+        }
+        if (auto listOp = dyn_cast<ListOp>(op)) {
+            if (listOp.useAlloca() || listOp.isReserved()) return llvm::None;
+            // Lists are lowered to a chain of cons cells, where the last
+            // element is the tail of the final cell, unless there is only one
+            // element, in which case the tail is nil
+            unsigned numElements = listOp.elements().size();
+            if (numElements == 0) return AllocationSize{0, 0};
+            if (numElements == 1) return AllocationSize{2, 1};
+            unsigned cells = numElements - 1;
+            return AllocationSize{2 * cells, cells};
+        }
+        if (auto closureOp = dyn_cast<ClosureOp>(op)) {
+            if (closureOp.isReserved()) return llvm::None;
+            unsigned arity = targetInfo.closureHeaderArity(closureOp.envLen());
+            return AllocationSize{arity + 1, 1};
+        }
+        return llvm::None;
+    }
+
+    // Returns true if the given operation can appear between two allocations
+    // in a group; i.e. it is guaranteed to neither allocate on the process
+    // heap nor yield. Big integer constants are included, as they are
+    // literals, which the runtime materializes outside of any process heap.
+    // Aggregate constants are not, as those which can't be emitted as
+    // literals are constructed on the process heap.
+    static bool isTransparent(Operation *op) {
+        if (isa<ConstantListOp>(op) || isa<ConstantTupleOp>(op) ||
+            isa<ConstantMapOp>(op))
+            return false;
+        return op->hasTrait<mlir::OpTrait::ConstantLike>();
+    }
+
+    TargetMachine *targetMachine;
+};
+
+}  // namespace
+
+namespace lumen {
+namespace eir {
+std::unique_ptr<mlir::Pass> createCoalesceAllocationsPass(
+    TargetMachine *targetMachine) {
+    return std::make_unique<CoalesceAllocationsPass>(targetMachine);
+}
+}  // namespace eir
+}  // namespace lumen
@@ -0,0 +1,19 @@
+#ifndef LUMEN_COMPILER_DIALECT_EIR_CONVERSION_COALESCEALLOCATIONS_H_
+#define LUMEN_COMPILER_DIALECT_EIR_CONVERSION_COALESCEALLOCATIONS_H_
+
+#include "mlir/Pass/Pass.h"
+
+#include <memory>
+
+namespace llvm {
+class TargetMachine;
+}  // namespace llvm
+
+namespace lumen {
+namespace eir {
+std::unique_ptr<mlir::Pass> createCoalesceAllocationsPass(
+    llvm::TargetMachine *targetMachine);
+}  // namespace eir
+}  // namespace lumen
+
+#endif
@@ -3,7 +3,30 @@
 namespace lumen {
 namespace eir {
 
-template <typename Op, typename OperandAdaptor>
+// Returns true if a term of the given type may be a fixnum at runtime
+static bool mayBeFixnum(Type type) {
+    auto termType = type.dyn_cast_or_null<OpaqueTermType>();
+    if (!termType) return false;
+    if (termType.isOpaque()) return true;
+    return termType.isNumber() && !termType.isFloat();
+}
+
+// Compares two terms known to be fixnums, by decoding them and comparing the
+// signed integer values at the width of a fixnum on the target
+template <typename Op>
+static Value buildFixnumComparison(RewritePatternContext<Op> &ctx,
+                                   LLVM::ICmpPredicate predicate, Value lhs,
+                                   Value rhs) {
+    unsigned fixnumBits = ctx.targetInfo.immediateBits();
+    if (ctx.targetInfo.immediateMask().requiresShift()) fixnumBits -= 1;
+    auto iFixTy = LLVMType::getIntNTy(ctx.rewriter.getContext(), fixnumBits);
+    Value lhsRaw = llvm_trunc(iFixTy, ctx.decodeImmediate(lhs));
+    Value rhsRaw = llvm_trunc(iFixTy, ctx.decodeImmediate(rhs));
+    return llvm_icmp(predicate, lhsRaw, rhsRaw);
+}
+
+template <typename Op, typename OperandAdaptor,
+          LLVM::ICmpPredicate IntPredicate, LLVM::FCmpPredicate FloatPredicate>
 class ComparisonOpConversion : public EIROpConversion<Op> {
    public:
     explicit ComparisonOpConversion(MLIRContext *context,
@@ -24,19 +47,80 @@ class ComparisonOpConversion : public EIROpConversion<Op> {
         auto termTy = ctx.getUsizeType();
         auto int1ty = ctx.getI1Type();
 
-        auto callee =
-            ctx.getOrInsertFunction(builtinSymbol, int1ty, {termTy, termTy});
-
         Value lhs = adaptor.lhs();
         Value rhs = adaptor.rhs();
+        Type lhsType = op.lhs().getType();
+        Type rhsType = op.rhs().getType();
 
-        ArrayRef<Value> args({lhs, rhs});
+        // Use specialized lowerings if types are known
+        if (lhsType.isa<FloatType>() && rhsType.isa<FloatType>()) {
+            auto fpTy = ctx.getDoubleType();
+            Value l = eir_cast(lhs, fpTy);
+            Value r = eir_cast(rhs, fpTy);
+            rewriter.replaceOpWithNewOp<LLVM::FCmpOp>(op, FloatPredicate, l, r);
+            return success();
+        }
+
+        bool lhsIsFixnum = lhsType.isa<FixnumType>();
+        bool rhsIsFixnum = rhsType.isa<FixnumType>();
+        if (lhsIsFixnum && rhsIsFixnum) {
+            Value result = buildFixnumComparison(ctx, IntPredicate, lhs, rhs);
+            rewriter.replaceOp(op, {result});
+            return success();
+        }
+
+        auto callee =
+            ctx.getOrInsertFunction(builtinSymbol, int1ty, {termTy, termTy});
         auto calleeSymbol =
             FlatSymbolRefAttr::get(builtinSymbol, callee->getContext());
-        Operation *callOp =
-            std_call(calleeSymbol, ArrayRef<Type>{int1ty}, args);
 
-        rewriter.replaceOp(op, callOp->getResult(0));
+        // If either operand may be something other than a fixnum, but both
+        // could be fixnums, guard an inline fixnum comparison with a tag
+        // check, and only call into the runtime for other terms
+        bool canGuard = lhs.getType() == termTy && rhs.getType() == termTy &&
+                        mayBeFixnum(lhsType) && mayBeFixnum(rhsType);
+        if (!canGuard) {
+            ArrayRef<Value> args({lhs, rhs});
+            Operation *callOp =
+                std_call(calleeSymbol, ArrayRef<Type>{int1ty}, args);
+            rewriter.replaceOp(op, callOp->getResult(0));
+            return success();
+        }
+
+        Value isFixnum;
+        if (!lhsIsFixnum)
+            isFixnum = ctx.isImmediateOfKind(lhs, TypeKind::Fixnum);
+        if (!rhsIsFixnum) {
+            Value rhsCond = ctx.isImmediateOfKind(rhs, TypeKind::Fixnum);
+            isFixnum = isFixnum ? llvm_and(isFixnum, rhsCond) : rhsCond;
+        }
+
+        Block *current = rewriter.getInsertionBlock();
+        Block *cont =
+            rewriter.splitBlock(current, rewriter.getInsertionPoint());
+        cont->addArgument(int1ty);
+        Block *fast = new Block();
+        Block *slow = new Block();
+        auto nextIt = std::next(Region::iterator(current));
+        current->getParent()->getBlocks().insert(nextIt, fast);
+        current->getParent()->getBlocks().insert(nextIt, slow);
+
+        rewriter.setInsertionPointToEnd(current);
+        llvm_condbr(isFixnum, fast, ValueRange(), slow, ValueRange());
+
+        // Both operands are fixnums, compare them inline
+        rewriter.setInsertionPointToEnd(fast);
+        Value result = buildFixnumComparison(ctx, IntPredicate, lhs, rhs);
+        llvm_br(ValueRange(result), cont);
+
+        // Otherwise, fall back to the runtime
+        rewriter.setInsertionPointToEnd(slow);
+        Operation *callOp = std_call(calleeSymbol, ArrayRef<Type>{int1ty},
+                                     ValueRange{lhs, rhs});
+        llvm_br(callOp->getResults(), cont);
+
+        rewriter.setInsertionPointToStart(cont);
+        rewriter.replaceOp(op, cont->getArgument(0));
         return success();
     }
 
@@ -45,22 +129,51 @@ class ComparisonOpConversion : public EIROpConversion<Op> {
 };
 
 struct CmpLtOpConversion
-    : public ComparisonOpConversion<CmpLtOp, CmpLtOpAdaptor> {
+    : public ComparisonOpConversion<CmpLtOp, CmpLtOpAdaptor,
+                                    LLVM::ICmpPredicate::slt,
+                                    LLVM::FCmpPredicate::olt> {
     using ComparisonOpConversion::ComparisonOpConversion;
 };
 struct CmpLteOpConversion
-    : public ComparisonOpConversion<CmpLteOp, CmpLteOpAdaptor> {
+    : public ComparisonOpConversion<CmpLteOp, CmpLteOpAdaptor,
+                                    LLVM::ICmpPredicate::sle,
+                                    LLVM::FCmpPredicate::ole> {
     using ComparisonOpConversion::ComparisonOpConversion;
 };
 struct CmpGtOpConversion
-    : public ComparisonOpConversion<CmpGtOp, CmpGtOpAdaptor> {
+    : public ComparisonOpConversion<CmpGtOp, CmpGtOpAdaptor,
+                                    LLVM::ICmpPredicate::sgt,
+                                    LLVM::FCmpPredicate::ogt> {
     using ComparisonOpConversion::ComparisonOpConversion;
 };
 struct CmpGteOpConversion
-    : public ComparisonOpConversion<CmpGteOp, CmpGteOpAdaptor> {
+    : public ComparisonOpConversion<CmpGteOp, CmpGteOpAdaptor,
+                                    LLVM::ICmpPredicate::sge,
+                                    LLVM::FCmpPredicate::oge> {
     using ComparisonOpConversion::ComparisonOpConversion;
 };
 
+// Returns true if `value` is a constant which is always encoded as an
+// immediate term, in which case a term is equal to it exactly when their raw
+// term words are equal. Since numbers compare equal to floats in non-strict
+// comparisons, `isNumber` is set when the constant is a fixnum.
+static bool isImmediateConstant(Value value, TargetInfo &targetInfo,
+                                bool &isNumber) {
+    isNumber = false;
+    Operation *definition = value.getDefiningOp();
+    if (!definition) return false;
+    if (auto atomOp = dyn_cast_or_null<ConstantAtomOp>(definition))
+        return !atomOp.getType().isa<BooleanType>();
+    if (isa<ConstantNilOp>(definition)) return true;
+    if (auto intOp = dyn_cast_or_null<ConstantIntOp>(definition)) {
+        auto attr = intOp.getValue().cast<APIntAttr>();
+        auto intValue = attr.getValue();
+        isNumber = true;
+        return targetInfo.isValidImmediateValue(intValue);
+    }
+    return false;
+}
+
 struct CmpEqOpConversion : public EIROpConversion<CmpEqOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -118,6 +231,23 @@ struct CmpEqOpConversion : public EIROpConversion<CmpEqOp> {
             return success();
         }
 
+        // If either side is an immediate constant, and both sides are
+        // represented as raw terms, equality is just equality of the term
+        // words, e.g. when matching a term against an atom
+        if (lhs.getType() == termTy && rhs.getType() == termTy) {
+            bool lhsIsNumber, rhsIsNumber;
+            bool lhsIsImmediate =
+                isImmediateConstant(op.lhs(), ctx.targetInfo, lhsIsNumber);
+            bool rhsIsImmediate =
+                isImmediateConstant(op.rhs(), ctx.targetInfo, rhsIsNumber);
+            if ((lhsIsImmediate && (strict || !lhsIsNumber)) ||
+                (rhsIsImmediate && (strict || !rhsIsNumber))) {
+                rewriter.replaceOpWithNewOp<LLVM::ICmpOp>(
+                    op, LLVM::ICmpPredicate::eq, lhs, rhs);
+                return success();
+            }
+        }
+
         // If we reach here, fall back to the slow path
         StringRef builtinSymbol;
         if (strict)
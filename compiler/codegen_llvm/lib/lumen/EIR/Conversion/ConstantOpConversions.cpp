@@ -7,6 +7,413 @@ template <typename Op>
 static Value lowerElementValue(RewritePatternContext<Op> &ctx,
                                Attribute elementAttr);
 
+// This magic constant here matches the same value in the term encoding in Rust
+const uint64_t MIN_DOUBLE = ~((uint64_t)(INT64_MIN >> 12));
+
+//===----------------------------------------------------------------------===//
+// Literals
+//
+// Constant binaries, floats, tuples and lists are emitted as constant globals,
+// and referenced by literal terms, rather than being constructed on the
+// process heap each time they are evaluated. Each global is named after the
+// hash of its contents, so every distinct constant is emitted once per module.
+//===----------------------------------------------------------------------===//
+
+template <typename Op>
+static LLVM::GlobalOp getOrInsertBinaryLiteral(RewritePatternContext<Op> &ctx,
+                                               BinaryAttr binAttr) {
+    auto &rewriter = ctx.rewriter;
+    auto bytes = binAttr.getValue();
+    auto ty = ctx.targetInfo.getBinaryType();
+    auto termTy = ctx.getUsizeType();
+
+    // We use the SHA-1 hash of the value as the name of the global,
+    // this provides a nice way to de-duplicate constant strings while
+    // not requiring any global state
+    auto name = binAttr.getHash();
+    auto bytesGlobal = ctx.getOrInsertConstantString(name, bytes);
+    auto headerName = std::string("binary_") + name;
+    ModuleOp mod = ctx.getModule();
+    LLVM::GlobalOp headerConst = mod.lookupSymbol<LLVM::GlobalOp>(headerName);
+    if (headerConst) return headerConst;
+
+    auto i64Ty = ctx.getI64Type();
+    auto i8Ty = ctx.getI8Type();
+    auto i8PtrTy = i8Ty.getPointerTo();
+
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointAfter(bytesGlobal);
+    headerConst = ctx.getOrInsertGlobalConstantOp(headerName, ty);
+
+    auto &initRegion = headerConst.getInitializerRegion();
+    rewriter.createBlock(&initRegion);
+    auto globalPtr = llvm_addressof(bytesGlobal);
+    Value zero = llvm_constant(i64Ty, ctx.getIntegerAttr(0));
+    Value headerTerm =
+        llvm_constant(termTy, ctx.getIntegerAttr(binAttr.getHeader()));
+    Value flags =
+        llvm_constant(termTy, ctx.getIntegerAttr(binAttr.getFlags()));
+    Value header = llvm_undef(ty);
+    Value address = llvm_gep(i8PtrTy, globalPtr, ArrayRef<Value>{zero, zero});
+    header =
+        llvm_insertvalue(ty, header, headerTerm, rewriter.getI64ArrayAttr(0));
+    header = llvm_insertvalue(ty, header, flags, rewriter.getI64ArrayAttr(1));
+    header =
+        llvm_insertvalue(ty, header, address, rewriter.getI64ArrayAttr(2));
+    rewriter.create<LLVM::ReturnOp>(mod.getLoc(), header);
+    return headerConst;
+}
+
+// Only used on targets which require packed floats, i.e. no nanboxing
+template <typename Op>
+static LLVM::GlobalOp getOrInsertFloatLiteral(RewritePatternContext<Op> &ctx,
+                                              APFloat apVal) {
+    auto &rewriter = ctx.rewriter;
+    auto floatTy = ctx.targetInfo.getFloatType();
+    auto headerName = std::string("float_") +
+                      std::to_string(apVal.bitcastToAPInt().getLimitedValue());
+    ModuleOp mod = ctx.getModule();
+    LLVM::GlobalOp headerConst = mod.lookupSymbol<LLVM::GlobalOp>(headerName);
+    if (headerConst) return headerConst;
+
+    auto termTy = ctx.getUsizeType();
+    auto f64Ty = ctx.getDoubleType();
+
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToStart(mod.getBody());
+    headerConst = ctx.getOrInsertGlobalConstantOp(headerName, floatTy);
+
+    auto &initRegion = headerConst.getInitializerRegion();
+    rewriter.createBlock(&initRegion);
+
+    APInt headerTermVal = ctx.targetInfo.encodeHeader(TypeKind::Float, 2);
+    Value headerTerm = llvm_constant(
+        termTy, ctx.getIntegerAttr(headerTermVal.getLimitedValue()));
+    Value floatVal = llvm_constant(
+        f64Ty, rewriter.getF64FloatAttr(apVal.convertToDouble()));
+    Value header = llvm_undef(floatTy);
+    header = llvm_insertvalue(floatTy, header, headerTerm,
+                              rewriter.getI64ArrayAttr(0));
+    header = llvm_insertvalue(floatTy, header, floatVal,
+                              rewriter.getI64ArrayAttr(1));
+    rewriter.create<LLVM::ReturnOp>(mod.getLoc(), header);
+    return headerConst;
+}
+
+// Lowers constants which are represented as immediate terms, returns null
+// for any other kind of constant
+template <typename Op>
+static Value lowerImmediateElement(RewritePatternContext<Op> &ctx,
+                                   Attribute elementAttr) {
+    auto termTy = ctx.getUsizeType();
+
+    // None/Nil
+    if (auto typeAttr = elementAttr.dyn_cast<TypeAttr>()) {
+        auto type = typeAttr.getValue();
+        if (type.isa<NilType>())
+            return llvm_constant(termTy, ctx.getIntegerAttr(ctx.getNilValue()));
+        if (type.isa<NoneType>())
+            return llvm_constant(termTy,
+                                 ctx.getIntegerAttr(ctx.getNoneValue()));
+        return nullptr;
+    }
+    // Booleans
+    if (auto boolAttr = elementAttr.dyn_cast<BoolAttr>()) {
+        auto b = boolAttr.getValue();
+        uint64_t id = b ? 1 : 0;
+        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Atom, id);
+        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
+    }
+    // Atoms
+    if (auto atomAttr = elementAttr.dyn_cast<AtomAttr>()) {
+        auto id = atomAttr.getValue().getLimitedValue();
+        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Atom, id);
+        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
+    }
+    // Integers
+    if (auto intAttr = elementAttr.dyn_cast<APIntAttr>()) {
+        auto i = intAttr.getValue();
+        assert(i.getBitWidth() <= ctx.targetInfo.pointerSizeInBits &&
+               "support for bigint in constant aggregates not yet implemented");
+        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Fixnum,
+                                                     i.getLimitedValue());
+        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
+    }
+    if (auto intAttr = elementAttr.dyn_cast<IntegerAttr>()) {
+        auto i = intAttr.getValue();
+        assert(i.getBitWidth() <= ctx.targetInfo.pointerSizeInBits &&
+               "support for bigint in constant aggregates not yet implemented");
+        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Fixnum,
+                                                     i.getLimitedValue());
+        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
+    }
+    // Floats, when nanboxed
+    if (!ctx.targetInfo.requiresPackedFloats()) {
+        Optional<APFloat> f;
+        if (auto floatAttr = elementAttr.dyn_cast<APFloatAttr>())
+            f = floatAttr.getValue();
+        else if (auto floatAttr = elementAttr.dyn_cast<mlir::FloatAttr>())
+            f = floatAttr.getValue();
+        if (f.hasValue()) {
+            auto bits = f->bitcastToAPInt() + MIN_DOUBLE;
+            return llvm_constant(termTy,
+                                 ctx.getIntegerAttr(bits.getLimitedValue()));
+        }
+    }
+
+    return nullptr;
+}
+
+// Returns true if a pointer to a cons cell can be tagged as a literal.
+//
+// Only the nanboxed encoding has a distinct tag for literal lists, in the
+// others the list and literal tags combine into the tag of a literal box, so
+// constant lists are constructed on the process heap instead
+template <typename Op>
+static bool supportsLiteralLists(RewritePatternContext<Op> &ctx) {
+    return !ctx.targetInfo.requiresPackedFloats();
+}
+
+// Returns true if `attr` can be emitted as a literal, or as part of one, i.e.
+// it doesn't contain anything which must be constructed at runtime
+template <typename Op>
+static bool isLiteralConstant(RewritePatternContext<Op> &ctx, Attribute attr) {
+    if (auto seqAttr = attr.dyn_cast<SeqAttr>()) {
+        // Maps are always constructed by the runtime
+        auto type = seqAttr.getType();
+        if (!type.isa<TupleType>() && !type.isa<ConsType>()) return false;
+        // The empty list is nil, which is an immediate
+        if (type.isa<ConsType>() && seqAttr.size() > 0 &&
+            !supportsLiteralLists(ctx))
+            return false;
+        return llvm::all_of(seqAttr, [&](Attribute element) {
+            return isLiteralConstant(ctx, element);
+        });
+    }
+    // Only integers which fit in an immediate, bigints are allocated
+    if (auto intAttr = attr.dyn_cast<APIntAttr>()) {
+        APInt value = intAttr.getValue();
+        return ctx.targetInfo.isValidImmediateValue(value);
+    }
+    if (auto intAttr = attr.dyn_cast<IntegerAttr>()) {
+        APInt value = intAttr.getValue();
+        return ctx.targetInfo.isValidImmediateValue(value);
+    }
+    // Only references to other literals in the same module
+    if (auto symAttr = attr.dyn_cast<FlatSymbolRefAttr>()) {
+        auto symName = symAttr.getValue();
+        ModuleOp mod = ctx.getModule();
+        if (!mod.lookupSymbol<LLVM::GlobalOp>(symName)) return false;
+        if (symName.startswith("list_")) return supportsLiteralLists(ctx);
+        return symName.startswith("binary_") || symName.startswith("float_") ||
+               symName.startswith("closure_");
+    }
+    if (auto typeAttr = attr.dyn_cast<TypeAttr>()) {
+        auto type = typeAttr.getValue();
+        return type.isa<NilType>() || type.isa<NoneType>();
+    }
+    return attr.isa<AtomAttr>() || attr.isa<BoolAttr>() ||
+           attr.isa<APFloatAttr>() || attr.isa<mlir::FloatAttr>() ||
+           attr.isa<BinaryAttr>();
+}
+
+template <typename Op>
+static LLVM::GlobalOp getOrInsertLiteral(RewritePatternContext<Op> &ctx,
+                                         SeqAttr attr);
+
+// Returns the global which the literal value of `attr` refers to, if any,
+// creating it if it doesn't exist yet
+template <typename Op>
+static LLVM::GlobalOp getOrInsertLiteralDependency(
+    RewritePatternContext<Op> &ctx, Attribute attr) {
+    if (auto seqAttr = attr.dyn_cast<SeqAttr>()) {
+        // The empty list is nil
+        if (seqAttr.size() == 0 && seqAttr.getType().isa<ConsType>())
+            return nullptr;
+        return getOrInsertLiteral(ctx, seqAttr);
+    }
+    if (auto symAttr = attr.dyn_cast<FlatSymbolRefAttr>()) {
+        ModuleOp mod = ctx.getModule();
+        return mod.lookupSymbol<LLVM::GlobalOp>(symAttr.getValue());
+    }
+    if (auto binAttr = attr.dyn_cast<BinaryAttr>())
+        return getOrInsertBinaryLiteral(ctx, binAttr);
+    if (ctx.targetInfo.requiresPackedFloats()) {
+        if (auto floatAttr = attr.dyn_cast<APFloatAttr>())
+            return getOrInsertFloatLiteral(ctx, floatAttr.getValue());
+        if (auto floatAttr = attr.dyn_cast<mlir::FloatAttr>())
+            return getOrInsertFloatLiteral(ctx, floatAttr.getValue());
+    }
+    return nullptr;
+}
+
+// Returns the literal term for `attr`, which must satisfy isLiteralConstant
+template <typename Op>
+static Value lowerLiteralElement(RewritePatternContext<Op> &ctx,
+                                 Attribute attr) {
+    if (Value immediate = lowerImmediateElement(ctx, attr)) return immediate;
+
+    LLVM::GlobalOp global = getOrInsertLiteralDependency(ctx, attr);
+    if (!global) {
+        // The empty list
+        auto termTy = ctx.getUsizeType();
+        return llvm_constant(termTy, ctx.getIntegerAttr(ctx.getNilValue()));
+    }
+
+    Value ptr = llvm_addressof(global);
+    if (global.sym_name().startswith("list_")) {
+        assert(supportsLiteralLists(ctx) &&
+               "literal lists are not supported by this encoding");
+        return ctx.encodeList(ptr, /*isLiteral=*/true);
+    }
+    return ctx.encodeLiteral(ptr);
+}
+
+// Creates a constant global named `name`, of struct or array type `ty`, which
+// is initialized with the given header (if present), followed by the literal
+// values of `fields`
+template <typename Op>
+static LLVM::GlobalOp getOrInsertLiteralGlobal(RewritePatternContext<Op> &ctx,
+                                               StringRef name, LLVMType ty,
+                                               Optional<APInt> header,
+                                               ArrayRef<Attribute> fields) {
+    auto &rewriter = ctx.rewriter;
+    ModuleOp mod = ctx.getModule();
+    if (auto global = mod.lookupSymbol<LLVM::GlobalOp>(name)) return global;
+
+    // Any globals referenced by the initializer must precede this one
+    Operation *insertAfter = nullptr;
+    for (auto field : fields) {
+        LLVM::GlobalOp dependency = getOrInsertLiteralDependency(ctx, field);
+        if (!dependency) continue;
+        Operation *dependencyOp = dependency.getOperation();
+        if (!insertAfter || insertAfter->isBeforeInBlock(dependencyOp))
+            insertAfter = dependencyOp;
+    }
+
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    if (insertAfter)
+        rewriter.setInsertionPointAfter(insertAfter);
+    else
+        rewriter.setInsertionPointToStart(mod.getBody());
+    auto global = ctx.getOrInsertGlobalConstantOp(name, ty);
+
+    auto &initRegion = global.getInitializerRegion();
+    rewriter.createBlock(&initRegion);
+    auto termTy = ctx.getUsizeType();
+    Value literal = llvm_undef(ty);
+    unsigned index = 0;
+    if (header.hasValue()) {
+        Value headerTerm = llvm_constant(termTy, ctx.getIntegerAttr(*header));
+        literal = llvm_insertvalue(ty, literal, headerTerm,
+                                   ctx.getI64ArrayAttr(index++));
+    }
+    for (auto field : fields) {
+        Value fieldTerm = lowerLiteralElement(ctx, field);
+        literal = llvm_insertvalue(ty, literal, fieldTerm,
+                                   ctx.getI64ArrayAttr(index++));
+    }
+    rewriter.create<LLVM::ReturnOp>(mod.getLoc(), literal);
+    return global;
+}
+
+// Returns the global for a constant tuple, or for the first cell of a constant
+// list, which must satisfy isLiteralConstant
+template <typename Op>
+static LLVM::GlobalOp getOrInsertLiteral(RewritePatternContext<Op> &ctx,
+                                         SeqAttr attr) {
+    auto elements = attr.getValue();
+    auto numElements = elements.size();
+
+    if (attr.getType().isa<TupleType>()) {
+        auto name = std::string("tuple_") + attr.getHash();
+        auto tupleTy = ctx.getTupleType(numElements);
+        APInt header =
+            ctx.targetInfo.encodeHeader(TypeKind::Tuple, numElements);
+        return getOrInsertLiteralGlobal(ctx, name, tupleTy, header, elements);
+    }
+
+    assert(attr.getType().isa<ConsType>() && numElements > 0 &&
+           "expected non-empty constant list");
+
+    // The last element of a constant list is its tail, unless it only has a
+    // single element, in which case the tail is nil.
+    //
+    // Cells are emitted from last to first, each one refers to the next by
+    // name, and is itself named after the hash of its head and that name, so
+    // lists with a common suffix share the cells for it
+    auto *context = ctx.rewriter.getContext();
+    auto listTy = attr.getType();
+    auto consTy = ctx.targetInfo.getConsType();
+    Attribute tail = elements[numElements - 1];
+    unsigned numCells = numElements - 1;
+    if (numElements == 1) {
+        tail = TypeAttr::get(ctx.rewriter.template getType<NilType>());
+        numCells = 1;
+    }
+    LLVM::GlobalOp cell;
+    for (unsigned i = numCells; i > 0; --i) {
+        Attribute fields[] = {elements[i - 1], tail};
+        auto cellAttr = SeqAttr::get(listTy, fields);
+        auto name = std::string("list_") + cellAttr.getHash();
+        cell = getOrInsertLiteralGlobal(ctx, name, consTy, llvm::None, fields);
+        tail = FlatSymbolRefAttr::get(name, context);
+    }
+    return cell;
+}
+
+// Returns a term for the literal value of `attr`, which must satisfy
+// isLiteralConstant, for use outside of a global initializer
+template <typename Op>
+static Value lowerLiteral(RewritePatternContext<Op> &ctx, SeqAttr attr) {
+    if (attr.size() == 0 && attr.getType().isa<ConsType>())
+        return llvm_constant(ctx.getUsizeType(),
+                             ctx.getIntegerAttr(ctx.getNilValue()));
+    return lowerLiteralElement(ctx, attr);
+}
+
+// Emits code which produces a literal term that must be constructed at
+// runtime. Each scheduler thread materializes the literal at most once, using
+// `materialize`, the resulting term is cached in the thread-local slot named
+// `cacheName`, which holds the none value until then.
+//
+// The rewriter is left positioned after the code which produces the literal
+template <typename Op>
+static Value getOrMaterializeLiteral(RewritePatternContext<Op> &ctx,
+                                     StringRef cacheName,
+                                     llvm::function_ref<Value()> materialize) {
+    auto &rewriter = ctx.rewriter;
+    auto termTy = ctx.getUsizeType();
+
+    auto noneAttr = ctx.getIntegerAttr(ctx.getNoneValue());
+    Value cachePtr =
+        ctx.getOrInsertGlobal(cacheName, termTy, noneAttr,
+                              LLVM::Linkage::Internal,
+                              LLVM::ThreadLocalMode::LocalExec);
+    Value cached = llvm_load(cachePtr);
+    Value none = llvm_constant(termTy, noneAttr);
+    Value isCached = llvm_icmp(LLVM::ICmpPredicate::ne, cached, none);
+
+    Block *current = rewriter.getInsertionBlock();
+    Block *cont = rewriter.splitBlock(current, rewriter.getInsertionPoint());
+    cont->addArgument(termTy);
+    Block *materializeBlock = new Block();
+    current->getParent()->getBlocks().insert(Region::iterator(cont),
+                                             materializeBlock);
+
+    rewriter.setInsertionPointToEnd(current);
+    llvm_condbr(isCached, cont, ValueRange(cached), materializeBlock,
+                ValueRange());
+
+    rewriter.setInsertionPointToEnd(materializeBlock);
+    Value literal = materialize();
+    llvm_store(literal, cachePtr);
+    llvm_br(ValueRange(literal), cont);
+
+    rewriter.setInsertionPointToStart(cont);
+    return cont->getArgument(0);
+}
+
 struct NullOpConversion : public EIROpConversion<NullOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -110,21 +517,26 @@ struct ConstantBigIntOpConversion : public EIROpConversion<ConstantBigIntOp> {
         auto name = bigIntAttr.getHash();
         auto bytesGlobal = ctx.getOrInsertConstantString(name, bigIntStr);
 
-        // Invoke the runtime function that will reify a BigInt term from the
-        // constant string
-        auto globalPtr = llvm_bitcast(i8PtrTy, llvm_addressof(bytesGlobal));
-        Value size =
-            llvm_constant(termTy, ctx.getIntegerAttr(bigIntStr.size()));
-
-        StringRef symbolName("__lumen_builtin_bigint_from_cstr");
-        auto callee =
-            ctx.getOrInsertFunction(symbolName, termTy, {i8PtrTy, termTy});
-
-        auto calleeSymbol =
-            FlatSymbolRefAttr::get(symbolName, callee->getContext());
-        rewriter.replaceOpWithNewOp<mlir::CallOp>(
-            op, calleeSymbol, termTy, ArrayRef<Value>{globalPtr, size});
-
+        // Invoke the runtime function that will reify a BigInt literal from
+        // the constant string, which lives for the rest of the program
+        auto cacheName = std::string("__lumen_bigint_literal_") + name;
+        Value literal = getOrMaterializeLiteral(ctx, cacheName, [&]() {
+            auto globalPtr = llvm_bitcast(i8PtrTy, llvm_addressof(bytesGlobal));
+            Value size =
+                llvm_constant(termTy, ctx.getIntegerAttr(bigIntStr.size()));
+
+            StringRef symbolName("__lumen_builtin_bigint_literal_from_cstr");
+            auto callee =
+                ctx.getOrInsertFunction(symbolName, termTy, {i8PtrTy, termTy});
+
+            auto calleeSymbol =
+                FlatSymbolRefAttr::get(symbolName, callee->getContext());
+            Operation *callOp = std_call(calleeSymbol, ArrayRef<Type>{termTy},
+                                         ArrayRef<Value>{globalPtr, size});
+            return callOp->getResult(0);
+        });
+
+        rewriter.replaceOp(op, literal);
         return success();
     }
 };
@@ -138,48 +550,7 @@ struct ConstantBinaryOpConversion : public EIROpConversion<ConstantBinaryOp> {
         auto ctx = getRewriteContext(op, rewriter);
 
         auto binAttr = op.getValue().cast<BinaryAttr>();
-        auto bytes = binAttr.getValue();
-        auto byteSize = bytes.size();
-        auto ty = ctx.targetInfo.getBinaryType();
-        auto termTy = ctx.getUsizeType();
-
-        // We use the SHA-1 hash of the value as the name of the global,
-        // this provides a nice way to de-duplicate constant strings while
-        // not requiring any global state
-        auto name = binAttr.getHash();
-        auto bytesGlobal = ctx.getOrInsertConstantString(name, bytes);
-        auto headerName = std::string("binary_") + name;
-        ModuleOp mod = ctx.getModule();
-        LLVM::GlobalOp headerConst =
-            mod.lookupSymbol<LLVM::GlobalOp>(headerName);
-        if (!headerConst) {
-            auto i64Ty = ctx.getI64Type();
-            auto i8Ty = ctx.getI8Type();
-            auto i8PtrTy = i8Ty.getPointerTo();
-
-            PatternRewriter::InsertionGuard insertGuard(rewriter);
-            rewriter.setInsertionPointAfter(bytesGlobal);
-            headerConst = ctx.getOrInsertGlobalConstantOp(headerName, ty);
-
-            auto &initRegion = headerConst.getInitializerRegion();
-            auto *initBlock = rewriter.createBlock(&initRegion);
-            auto globalPtr = llvm_addressof(bytesGlobal);
-            Value zero = llvm_constant(i64Ty, ctx.getIntegerAttr(0));
-            Value headerTerm =
-                llvm_constant(termTy, ctx.getIntegerAttr(binAttr.getHeader()));
-            Value flags =
-                llvm_constant(termTy, ctx.getIntegerAttr(binAttr.getFlags()));
-            Value header = llvm_undef(ty);
-            Value address =
-                llvm_gep(i8PtrTy, globalPtr, ArrayRef<Value>{zero, zero});
-            header = llvm_insertvalue(ty, header, headerTerm,
-                                      rewriter.getI64ArrayAttr(0));
-            header = llvm_insertvalue(ty, header, flags,
-                                      rewriter.getI64ArrayAttr(1));
-            header = llvm_insertvalue(ty, header, address,
-                                      rewriter.getI64ArrayAttr(2));
-            rewriter.create<LLVM::ReturnOp>(op.getLoc(), header);
-        }
+        LLVM::GlobalOp headerConst = getOrInsertBinaryLiteral(ctx, binAttr);
 
         // Box the constant address
         auto headerPtr = llvm_addressof(headerConst);
@@ -190,9 +561,6 @@ struct ConstantBinaryOpConversion : public EIROpConversion<ConstantBinaryOp> {
     }
 };
 
-// This magic constant here matches the same value in the term encoding in Rust
-const uint64_t MIN_DOUBLE = ~((uint64_t)(INT64_MIN >> 12));
-
 struct ConstantFloatOpConversion : public EIROpConversion<ConstantFloatOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -221,42 +589,7 @@ struct ConstantFloatOpConversion : public EIROpConversion<ConstantFloatOp> {
         // which can then either be placed on the heap and boxed, or
         // passed by value on the stack and accessed directly
 
-        auto floatTy = ctx.targetInfo.getFloatType();
-        auto val = llvm_constant(
-            floatTy, rewriter.getF64FloatAttr(apVal.convertToDouble()));
-        auto headerName =
-            std::string("float_") +
-            std::to_string(apVal.bitcastToAPInt().getLimitedValue());
-        ModuleOp mod = ctx.getModule();
-        LLVM::GlobalOp headerConst =
-            mod.lookupSymbol<LLVM::GlobalOp>(headerName);
-        if (!headerConst) {
-            auto i64Ty = ctx.getI64Type();
-            auto f64Ty = ctx.getDoubleType();
-            auto i8Ty = ctx.getI8Type();
-            auto i8PtrTy = i8Ty.getPointerTo();
-
-            PatternRewriter::InsertionGuard insertGuard(rewriter);
-            rewriter.setInsertionPointToStart(mod.getBody());
-            headerConst = ctx.getOrInsertGlobalConstantOp(headerName, floatTy);
-
-            auto &initRegion = headerConst.getInitializerRegion();
-            auto *initBlock = rewriter.createBlock(&initRegion);
-            Value zero = llvm_constant(i64Ty, ctx.getIntegerAttr(0));
-
-            APInt headerTermVal =
-                ctx.targetInfo.encodeHeader(TypeKind::Float, 2);
-            Value headerTerm = llvm_constant(
-                termTy, ctx.getIntegerAttr(headerTermVal.getLimitedValue()));
-            Value floatVal = llvm_constant(
-                f64Ty, rewriter.getF64FloatAttr(apVal.convertToDouble()));
-            Value header = llvm_undef(floatTy);
-            header = llvm_insertvalue(floatTy, header, headerTerm,
-                                      rewriter.getI64ArrayAttr(0));
-            header = llvm_insertvalue(floatTy, header, floatVal,
-                                      rewriter.getI64ArrayAttr(1));
-            rewriter.create<LLVM::ReturnOp>(op.getLoc(), header);
-        }
+        LLVM::GlobalOp headerConst = getOrInsertFloatLiteral(ctx, apVal);
 
         // Box the constant address
         auto headerPtr = llvm_addressof(headerConst);
@@ -343,6 +676,11 @@ struct ConstantListOpConversion : public EIROpConversion<ConstantListOp> {
             return success();
         }
 
+        if (isLiteralConstant(ctx, attr)) {
+            rewriter.replaceOp(op, lowerLiteral(ctx, attr));
+            return success();
+        }
+
         SmallVector<Value, 4> elementValues;
         for (auto element : elements) {
             Value elementVal = lowerElementValue(ctx, element);
@@ -367,9 +705,98 @@ struct ConstantMapOpConversion : public EIROpConversion<ConstantMapOp> {
         auto attr = op.getValue().cast<SeqAttr>();
         auto elementAttrs = attr.getValue();
 
+        // Maps can't be emitted statically, so when all of the keys and
+        // values are literals, they are emitted as constants, from which the
+        // map is materialized as a literal once per scheduler thread
+        bool isLiteral = llvm::all_of(elementAttrs, [&](Attribute element) {
+            return isLiteralConstant(ctx, element);
+        });
+        if (isLiteral) {
+            auto name = attr.getHash();
+            auto numElements = elementAttrs.size();
+            auto cacheName = std::string("__lumen_map_literal_") + name;
+
+            // When the keys are all atoms, the map is flat, its values are
+            // emitted as a literal tuple, in the order of its shape
+            SmallVector<Attribute, 4> keys;
+            for (unsigned i = 0; i < numElements; i += 2)
+                keys.push_back(elementAttrs[i]);
+            if (auto shape = getMapShape(keys)) {
+                SmallVector<Attribute, 4> values;
+                for (unsigned i : shape->order)
+                    values.push_back(elementAttrs[i * 2 + 1]);
+                auto valuesTy = TupleType::get(rewriter.getContext(),
+                                               values.size());
+                auto valuesAttr = SeqAttr::get(valuesTy, values);
+
+                Value literal = getOrMaterializeLiteral(ctx, cacheName, [&]() {
+                    Value keysTerm = ctx.encodeLiteral(
+                        llvm_addressof(ctx.getOrInsertMapShape(*shape)));
+                    Value valuesTerm = lowerLiteral(ctx, valuesAttr);
+
+                    StringRef symbolName(
+                        "__lumen_builtin_map_literal_from_shape");
+                    auto callee = ctx.getOrInsertFunction(symbolName, termTy,
+                                                          {termTy, termTy});
+
+                    auto calleeSymbol = FlatSymbolRefAttr::get(
+                        symbolName, callee->getContext());
+                    Operation *callOp =
+                        std_call(calleeSymbol, ArrayRef<Type>{termTy},
+                                 ArrayRef<Value>{keysTerm, valuesTerm});
+                    return callOp->getResult(0);
+                });
+
+                rewriter.replaceOp(op, literal);
+                return success();
+            }
+
+            auto elementsTy = LLVMType::getArrayTy(termTy, numElements);
+            auto elementsGlobal = getOrInsertLiteralGlobal(
+                ctx, std::string("map_") + name, elementsTy, llvm::None,
+                elementAttrs);
+
+            Value literal = getOrMaterializeLiteral(ctx, cacheName, [&]() {
+                auto termPtrTy = termTy.getPointerTo();
+                Value elementsPtr =
+                    llvm_bitcast(termPtrTy, llvm_addressof(elementsGlobal));
+                Value len =
+                    llvm_constant(termTy, ctx.getIntegerAttr(numElements / 2));
+
+                StringRef symbolName("__lumen_builtin_map_literal_from_slice");
+                auto callee = ctx.getOrInsertFunction(symbolName, termTy,
+                                                      {termPtrTy, termTy});
+
+                auto calleeSymbol =
+                    FlatSymbolRefAttr::get(symbolName, callee->getContext());
+                Operation *callOp =
+                    std_call(calleeSymbol, ArrayRef<Type>{termTy},
+                             ArrayRef<Value>{elementsPtr, len});
+                return callOp->getResult(0);
+            });
+
+            rewriter.replaceOp(op, literal);
+            return success();
+        }
+
+        // Atom keys are left as constant ops, so that the map is recognized
+        // as flat when it is lowered
         SmallVector<Value, 2> elements;
-        for (auto elementAttr : elementAttrs) {
-            auto element = lowerElementValue(ctx, elementAttr);
+        for (auto it : llvm::enumerate(elementAttrs)) {
+            auto elementAttr = it.value();
+            bool isKey = it.index() % 2 == 0;
+            auto atomAttr = elementAttr.dyn_cast<AtomAttr>();
+            auto boolAttr = elementAttr.dyn_cast<BoolAttr>();
+            Value element;
+            if (isKey && atomAttr)
+                element = rewriter.create<ConstantAtomOp>(
+                    op.getLoc(), atomAttr.getValue(),
+                    atomAttr.getStringValue());
+            else if (isKey && boolAttr)
+                element = rewriter.create<ConstantBoolOp>(
+                    op.getLoc(), boolAttr.getValue());
+            else
+                element = lowerElementValue(ctx, elementAttr);
             assert(element && "unsupported element type in map");
             elements.push_back(element);
         }
@@ -393,6 +820,11 @@ struct ConstantTupleOpConversion : public EIROpConversion<ConstantTupleOp> {
         auto attr = op.getValue().cast<SeqAttr>();
         auto elementAttrs = attr.getValue();
 
+        if (isLiteralConstant(ctx, attr)) {
+            rewriter.replaceOp(op, lowerLiteral(ctx, attr));
+            return success();
+        }
+
         SmallVector<Value, 2> elements;
         for (auto elementAttr : elementAttrs) {
             auto element = lowerElementValue(ctx, elementAttr);
@@ -411,9 +843,11 @@ struct ConstantTupleOpConversion : public EIROpConversion<ConstantTupleOp> {
 template <typename Op>
 static Value lowerElementValue(RewritePatternContext<Op> &ctx,
                                Attribute elementAttr) {
-    auto termTy = ctx.getUsizeType();
     auto eirTermType = ctx.rewriter.template getType<TermType>();
 
+    // Immediates, i.e. atoms, booleans, integers, nil/none, and nanboxed floats
+    if (Value immediate = lowerImmediateElement(ctx, elementAttr))
+        return immediate;
     // Symbols
     if (auto symAttr = elementAttr.dyn_cast_or_null<FlatSymbolRefAttr>()) {
         ModuleOp mod = ctx.getModule();
@@ -440,73 +874,24 @@ static Value lowerElementValue(RewritePatternContext<Op> &ctx,
         }
         return nullptr;
     }
-    // None/Nil
-    if (auto typeAttr = elementAttr.dyn_cast_or_null<TypeAttr>()) {
-        auto type = typeAttr.getValue();
-        if (type.isa<NilType>()) {
-            return eir_cast(eir_nil(), eirTermType);
-        }
-        if (type.isa<NoneType>()) {
-            return eir_cast(eir_none(), eirTermType);
-        }
-        return nullptr;
-    }
-    // Booleans
-    if (auto boolAttr = elementAttr.dyn_cast_or_null<BoolAttr>()) {
-        auto b = boolAttr.getValue();
-        uint64_t id = b ? 1 : 0;
-        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Atom, id);
-        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
-    }
-    // Atoms
-    if (auto atomAttr = elementAttr.dyn_cast_or_null<AtomAttr>()) {
-        auto id = atomAttr.getValue().getLimitedValue();
-        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Atom, id);
-        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
-    }
-    // Integers
-    if (auto intAttr = elementAttr.dyn_cast_or_null<APIntAttr>()) {
-        auto i = intAttr.getValue();
-        assert(i.getBitWidth() <= ctx.targetInfo.pointerSizeInBits &&
-               "support for bigint in constant aggregates not yet implemented");
-        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Fixnum,
-                                                     i.getLimitedValue());
-        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
-    }
-    if (auto intAttr = elementAttr.dyn_cast_or_null<IntegerAttr>()) {
-        auto i = intAttr.getValue();
-        assert(i.getBitWidth() <= ctx.targetInfo.pointerSizeInBits &&
-               "support for bigint in constant aggregates not yet implemented");
-        auto tagged = ctx.targetInfo.encodeImmediate(TypeKind::Fixnum,
-                                                     i.getLimitedValue());
-        return llvm_constant(termTy, ctx.getIntegerAttr(tagged));
-    }
-    // Floats
+    // Packed floats
     if (auto floatAttr = elementAttr.dyn_cast_or_null<APFloatAttr>()) {
-        if (!ctx.targetInfo.requiresPackedFloats()) {
-            auto f = floatAttr.getValue().bitcastToAPInt() + MIN_DOUBLE;
-            return llvm_constant(termTy,
-                                 ctx.getIntegerAttr(f.getLimitedValue()));
-        }
-        // Packed float
-        return eir_cast(eir_constant_float(floatAttr.getValue()), eirTermType);
+        return ctx.encodeLiteral(
+            llvm_addressof(getOrInsertFloatLiteral(ctx, floatAttr.getValue())));
     }
     if (auto floatAttr = elementAttr.dyn_cast_or_null<mlir::FloatAttr>()) {
-        if (!ctx.targetInfo.requiresPackedFloats()) {
-            auto f = floatAttr.getValue().bitcastToAPInt() + MIN_DOUBLE;
-            return llvm_constant(termTy,
-                                 ctx.getIntegerAttr(f.getLimitedValue()));
-        }
-        // Packed float
-        return eir_cast(eir_constant_float(floatAttr.getValue()), eirTermType);
+        return ctx.encodeLiteral(
+            llvm_addressof(getOrInsertFloatLiteral(ctx, floatAttr.getValue())));
     }
     // Binaries
     if (auto binAttr = elementAttr.dyn_cast_or_null<BinaryAttr>()) {
-        auto type = ctx.rewriter.template getType<BinaryType>();
-        return eir_cast(eir_constant_binary(type, binAttr), eirTermType);
+        return ctx.encodeLiteral(
+            llvm_addressof(getOrInsertBinaryLiteral(ctx, binAttr)));
     }
     //  Nested aggregates
     if (auto aggAttr = elementAttr.dyn_cast_or_null<SeqAttr>()) {
+        if (isLiteralConstant(ctx, aggAttr)) return lowerLiteral(ctx, aggAttr);
+
         auto elementAttrs = aggAttr.getValue();
         // Tuples
         if (auto tupleTy = aggAttr.getType().dyn_cast_or_null<TupleType>()) {
@@ -55,9 +55,6 @@ struct CallOpConversion : public EIROpConversion<CallOp> {
         auto ctx = getRewriteContext(op, rewriter);
         auto termTy = ctx.getUsizeType();
 
-        // Always increment reduction count when performing a call
-        rewriter.create<IncrementReductionsOp>(op.getLoc());
-
         // Results need to be converted, or use void if no result is returned
         SmallVector<Type, 1> resultTypes;
         if (op.getNumResults() > 0) {
@@ -101,9 +98,6 @@ struct InvokeOpConversion : public EIROpConversion<InvokeOp> {
         auto ctx = getRewriteContext(op, rewriter);
         auto termTy = ctx.getUsizeType();
 
-        // Always increment reduction count when performing a call
-        rewriter.create<IncrementReductionsOp>(op.getLoc());
-
         // The result types are based on the block arguments of the normal block
         auto ok = op.okDest();
         ValueRange okArgs = op.okDestOperands();
@@ -122,6 +116,175 @@ struct InvokeOpConversion : public EIROpConversion<InvokeOp> {
     }
 };
 
+// Casts the opaque function pointer given as the callee of an indirect call
+// to a pointer to a function of the type required by the call
+static Value castIndirectCallee(Value callee, LLVMType resultType,
+                                ValueRange args) {
+    SmallVector<LLVMType, 2> argTypes;
+    for (auto arg : args) argTypes.push_back(arg.getType().cast<LLVMType>());
+    auto fnTy = LLVMType::getFunctionTy(resultType, argTypes,
+                                        /*isVarArg=*/false);
+    return llvm_bitcast(fnTy.getPointerTo(), callee);
+}
+
+struct CallIndirectOpConversion : public EIROpConversion<CallIndirectOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        CallIndirectOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        CallIndirectOpAdaptor adaptor(operands);
+        auto ctx = getRewriteContext(op, rewriter);
+
+        SmallVector<Type, 1> resultTypes;
+        for (auto ty : op.getResultTypes()) {
+            Type resultType = ctx.typeConverter.convertType(ty);
+            if (!resultType)
+                return op.emitOpError("unable to convert type ")
+                       << ty << " to llvm type";
+            resultTypes.push_back(resultType);
+        }
+
+        // The callee is the first operand of an indirect llvm.call
+        LLVMType resultType = ctx.getUsizeType();
+        if (!resultTypes.empty())
+            resultType = resultTypes.front().cast<LLVMType>();
+        SmallVector<Value, 4> callArgs;
+        callArgs.push_back(castIndirectCallee(adaptor.callee(), resultType,
+                                              adaptor.operands()));
+        for (auto arg : adaptor.operands()) callArgs.push_back(arg);
+
+        Operation *callOp =
+            llvm_call(resultTypes, FlatSymbolRefAttr(), callArgs);
+        for (auto attr : op.getAttrs()) {
+            callOp->setAttr(std::get<Identifier>(attr),
+                            std::get<Attribute>(attr));
+        }
+
+        if (op.getNumResults() > 0) {
+            rewriter.replaceOp(op, callOp->getResults());
+        } else {
+            rewriter.eraseOp(op);
+        }
+        return success();
+    }
+};
+
+struct InvokeIndirectOpConversion
+    : public EIROpConversion<InvokeIndirectOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        InvokeIndirectOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        auto ctx = getRewriteContext(op, rewriter);
+
+        auto ok = op.okDest();
+        ValueRange okArgs = op.okDestOperands();
+        auto err = op.errDest();
+        ValueRange errArgs = op.errDestOperands();
+
+        // The callee and its arguments come first in the converted operands,
+        // followed by the successor operands
+        Value callee = operands.front();
+        auto args = operands.slice(1, op.getNumArgOperands());
+
+        SmallVector<Value, 4> callArgs;
+        callArgs.push_back(
+            castIndirectCallee(callee, ctx.getUsizeType(), args));
+        for (auto arg : args) callArgs.push_back(arg);
+
+        Operation *callOp =
+            llvm_invoke(ArrayRef<Type>{}, FlatSymbolRefAttr(), callArgs, ok,
+                        okArgs, err, errArgs);
+        for (auto attr : op.getAttrs()) {
+            callOp->setAttr(std::get<Identifier>(attr),
+                            std::get<Attribute>(attr));
+        }
+
+        rewriter.eraseOp(op);
+        return success();
+    }
+};
+
+struct ApplyCacheOpConversion : public EIROpConversion<ApplyCacheOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        ApplyCacheOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        ApplyCacheOpAdaptor adaptor(operands);
+        auto ctx = getRewriteContext(op, rewriter);
+
+        auto termTy = ctx.getUsizeType();
+        auto i8PtrTy = ctx.targetInfo.getI8Type().getPointerTo();
+
+        Value mod = adaptor.mod();
+        Value fun = adaptor.fun();
+
+        // The cache is keyed on the raw module and function terms, the none
+        // value is never a valid key, so that is what the cache starts with.
+        // Since the slots are thread-local, they are never seen half-updated
+        auto cacheName = op.cache().str();
+        auto noneAttr = ctx.getIntegerAttr(ctx.getNoneValue());
+        Value modPtr = ctx.getOrInsertGlobal(
+            cacheName + ".module", termTy, noneAttr, LLVM::Linkage::Internal,
+            LLVM::ThreadLocalMode::LocalExec);
+        Value funPtr = ctx.getOrInsertGlobal(
+            cacheName + ".function", termTy, noneAttr,
+            LLVM::Linkage::Internal, LLVM::ThreadLocalMode::LocalExec);
+        Value calleePtr = ctx.getOrInsertGlobal(
+            cacheName + ".callee", termTy, ctx.getIntegerAttr(0),
+            LLVM::Linkage::Internal, LLVM::ThreadLocalMode::LocalExec);
+
+        Value cachedMod = llvm_load(modPtr);
+        Value cachedFun = llvm_load(funPtr);
+        Value cachedCallee = llvm_load(calleePtr);
+        Value isModHit = llvm_icmp(LLVM::ICmpPredicate::eq, cachedMod, mod);
+        Value isFunHit = llvm_icmp(LLVM::ICmpPredicate::eq, cachedFun, fun);
+        Value isHit = llvm_and(isModHit, isFunHit);
+
+        Block *current = rewriter.getInsertionBlock();
+        Block *cont =
+            rewriter.splitBlock(current, rewriter.getInsertionPoint());
+        cont->addArgument(termTy);
+        Block *miss = new Block();
+        current->getParent()->getBlocks().insert(Region::iterator(cont),
+                                                 miss);
+
+        rewriter.setInsertionPointToEnd(current);
+        llvm_condbr(isHit, cont, ValueRange(cachedCallee), miss,
+                    ValueRange());
+
+        // On a miss, resolve the callee through the dispatch table and cache
+        // the result. Functions are never added to the dispatch table once
+        // the program is running, so a failed lookup can be cached as well
+        rewriter.setInsertionPointToEnd(miss);
+        Value arity = llvm_constant(termTy, ctx.getIntegerAttr(op.arity()));
+        StringRef symbolName("__lumen_builtin_apply_cache_lookup");
+        auto callee = ctx.getOrInsertFunction(symbolName, termTy,
+                                              {termTy, termTy, termTy});
+        auto calleeSymbol =
+            FlatSymbolRefAttr::get(symbolName, callee->getContext());
+        Operation *lookupOp = std_call(calleeSymbol, ArrayRef<Type>{termTy},
+                                       ArrayRef<Value>{mod, fun, arity});
+        Value resolved = lookupOp->getResult(0);
+        llvm_store(mod, modPtr);
+        llvm_store(fun, funPtr);
+        llvm_store(resolved, calleePtr);
+        llvm_br(ValueRange(resolved), cont);
+
+        rewriter.setInsertionPointToStart(cont);
+        Value address = cont->getArgument(0);
+        Value zero = llvm_constant(termTy, ctx.getIntegerAttr(0));
+        Value found = llvm_icmp(LLVM::ICmpPredicate::ne, address, zero);
+        Value fnPtr = llvm_inttoptr(i8PtrTy, address);
+
+        rewriter.replaceOp(op, {fnPtr, found});
+        return success();
+    }
+};
+
 struct LandingPadOpConversion : public EIROpConversion<LandingPadOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -318,8 +481,12 @@ struct YieldCheckOpConversion : public EIROpConversion<YieldCheckOp> {
             "CURRENT_REDUCTION_COUNT", i32Ty, nullptr, LLVM::Linkage::External,
             LLVM::ThreadLocalMode::LocalExec);
 
-        // Load the current reduction count
-        Value reductionCount = llvm_load(reductionCountGlobal);
+        // Charge a reduction for entering this function. This is the only
+        // place reductions are counted for calls, so the update is a single
+        // load/add/store of the counter, which we then reuse for the check
+        Value one = llvm_constant(i32Ty, ctx.getI32Attr(1));
+        Value reductionCount = llvm_add(llvm_load(reductionCountGlobal), one);
+        llvm_store(reductionCount, reductionCountGlobal);
         // If greater than or equal to the max reduction count, yield
         Value maxReductions = op.getMaxReductions();
         Value shouldYield =
@@ -433,7 +600,9 @@ void populateControlFlowOpConversionPatterns(OwningRewritePatternList &patterns,
                                              TargetInfo &targetInfo) {
     patterns
         .insert<BranchOpConversion, CondBranchOpConversion, CallOpConversion,
-                InvokeOpConversion, LandingPadOpConversion, ReturnOpConversion,
+                InvokeOpConversion, CallIndirectOpConversion,
+                InvokeIndirectOpConversion, ApplyCacheOpConversion,
+                LandingPadOpConversion, ReturnOpConversion,
                 ThrowOpConversion, UnreachableOpConversion, YieldOpConversion,
                 YieldCheckOpConversion, ReceiveStartOpConversion,
                 ReceiveWaitOpConversion, ReceiveMessageOpConversion,
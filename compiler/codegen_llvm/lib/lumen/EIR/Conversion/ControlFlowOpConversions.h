@@ -9,6 +9,9 @@ class BranchOpConversion;
 class CondBranchOpConversion;
 class CallOpConversion;
 class InvokeOpConversion;
+class CallIndirectOpConversion;
+class InvokeIndirectOpConversion;
+class ApplyCacheOpConversion;
 class LandingPadOp;
 class ReturnOpConversion;
 class ThrowOpConversion;
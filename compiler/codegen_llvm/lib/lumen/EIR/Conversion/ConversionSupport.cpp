@@ -324,6 +324,173 @@ Value OpConversionContext::buildMalloc(ModuleOp mod, LLVMType ty,
     return llvm_bitcast(ptrTy, call->getResult(0));
 }
 
+// Allocates `words` words on the current process heap by bumping the top of
+// the allocation buffer the scheduler reserves for generated code. The buffer
+// is described by a pair of thread-locals, `__lumen_heap_top` and
+// `__lumen_heap_limit`, which are null when no buffer is available.
+//
+// When the allocation doesn't fit, we take the slow path through
+// `__lumen_builtin_malloc`, which performs the allocation and then refills the
+// buffer for subsequent allocations.
+Value OpConversionContext::buildInlineMalloc(ModuleOp mod, LLVMType ty,
+                                             unsigned allocTy, Value arity,
+                                             unsigned words) const {
+    auto i8PtrTy = targetInfo.getI8Type().getPointerTo();
+    auto ptrTy = ty.getPointerTo();
+    auto usizeTy = getUsizeType();
+
+    Value heapTopPtr = getOrInsertGlobal(
+        mod, "__lumen_heap_top", i8PtrTy, nullptr, LLVM::Linkage::External,
+        LLVM::ThreadLocalMode::LocalExec);
+    Value heapLimitPtr = getOrInsertGlobal(
+        mod, "__lumen_heap_limit", i8PtrTy, nullptr, LLVM::Linkage::External,
+        LLVM::ThreadLocalMode::LocalExec);
+
+    // Calculate the new top of the buffer, and check it against the limit
+    Value top = llvm_load(heapTopPtr);
+    Value limit = llvm_load(heapLimitPtr);
+    unsigned sizeInBytes = words * (targetInfo.pointerSizeInBits / 8);
+    Value size = llvm_constant(usizeTy, getIntegerAttr(sizeInBytes));
+    Value newTop = llvm_gep(i8PtrTy, top, ArrayRef<Value>{size});
+    Value newTopInt = llvm_ptrtoint(usizeTy, newTop);
+    Value limitInt = llvm_ptrtoint(usizeTy, limit);
+    Value fits = llvm_icmp(LLVM::ICmpPredicate::ule, newTopInt, limitInt);
+
+    // Split the current block at the insertion point, the continuation
+    // receives the pointer to the allocated memory as its sole argument
+    Block *current = rewriter.getInsertionBlock();
+    Block *cont = rewriter.splitBlock(current, rewriter.getInsertionPoint());
+    cont->addArgument(ptrTy);
+
+    Block *fast = new Block();
+    Block *slow = new Block();
+    auto nextIt = std::next(Region::iterator(current));
+    current->getParent()->getBlocks().insert(nextIt, fast);
+    current->getParent()->getBlocks().insert(nextIt, slow);
+
+    rewriter.setInsertionPointToEnd(current);
+    llvm_condbr(fits, fast, ValueRange(), slow, ValueRange());
+
+    // The allocation fits, so bump the top of the buffer
+    rewriter.setInsertionPointToEnd(fast);
+    llvm_store(newTop, heapTopPtr);
+    Value allocPtr = llvm_bitcast(ptrTy, top);
+    llvm_br(ValueRange(allocPtr), cont);
+
+    // The buffer is exhausted, allocate via the runtime
+    rewriter.setInsertionPointToEnd(slow);
+    Value slowPtr = buildMalloc(mod, ty, allocTy, arity);
+    llvm_br(ValueRange(slowPtr), cont);
+
+    // Resume lowering in the continuation
+    rewriter.setInsertionPointToStart(cont);
+    return cont->getArgument(0);
+}
+
+// Allocates `words` words from the allocation buffer without checking the
+// limit; this is only valid for allocations covered by a preceding
+// `eir.heap.reserve`
+Value OpConversionContext::buildReservedMalloc(ModuleOp mod, LLVMType ty,
+                                               unsigned words) const {
+    auto i8PtrTy = targetInfo.getI8Type().getPointerTo();
+    auto usizeTy = getUsizeType();
+
+    Value heapTopPtr = getOrInsertGlobal(
+        mod, "__lumen_heap_top", i8PtrTy, nullptr, LLVM::Linkage::External,
+        LLVM::ThreadLocalMode::LocalExec);
+
+    Value top = llvm_load(heapTopPtr);
+    unsigned sizeInBytes = words * (targetInfo.pointerSizeInBits / 8);
+    Value size = llvm_constant(usizeTy, getIntegerAttr(sizeInBytes));
+    Value newTop = llvm_gep(i8PtrTy, top, ArrayRef<Value>{size});
+    llvm_store(newTop, heapTopPtr);
+    return llvm_bitcast(ty.getPointerTo(), top);
+}
+
+// Allocates a value of type `ty` on the stack of the function containing `op`.
+//
+// The allocation is placed in the entry block of the function, so that it
+// happens once per call, no matter where `op` is, rather than growing the
+// stack each time `op` executes in a loop.
+Value OpConversionContext::buildStackAlloc(Operation *op, LLVMType ty) const {
+    Region *body = op->getParentRegion();
+    while (!body->getParentOp()->hasTrait<mlir::OpTrait::FunctionLike>())
+        body = body->getParentOp()->getParentRegion();
+
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToStart(&body->front());
+    Value one = llvm_constant(getI32Type(), getI32Attr(1));
+    return llvm_alloca(ty.getPointerTo(), one, /*alignment=*/0);
+}
+
+// Returns the name of `attr` if it is an atom, atoms are ordered by name
+static Optional<StringRef> getAtomName(Attribute attr) {
+    if (!attr) return llvm::None;
+    if (auto atomAttr = attr.dyn_cast<AtomAttr>())
+        return atomAttr.getStringValue();
+    if (auto boolAttr = attr.dyn_cast<BoolAttr>())
+        return StringRef(boolAttr.getValue() ? "true" : "false");
+    return llvm::None;
+}
+
+Optional<MapShape> getMapShape(ArrayRef<Attribute> keys) {
+    if (keys.size() > MAX_FLAT_MAP_SIZE) return llvm::None;
+
+    SmallVector<std::pair<StringRef, unsigned>, 4> names;
+    for (auto it : llvm::enumerate(keys)) {
+        auto name = getAtomName(it.value());
+        if (!name) return llvm::None;
+        names.push_back(std::make_pair(*name, (unsigned)it.index()));
+    }
+    llvm::sort(names);
+
+    MapShape shape;
+    for (unsigned i = 0; i < names.size(); ++i) {
+        if (i > 0 && names[i].first == names[i - 1].first) return llvm::None;
+        shape.keys.push_back(keys[names[i].second]);
+        shape.order.push_back(names[i].second);
+    }
+    return shape;
+}
+
+// Shapes are emitted as literal tuples, which the linker merges across
+// modules, so that maps with the same keys always have the same shape,
+// regardless of where they were constructed
+LLVM::GlobalOp OpConversionContext::getOrInsertMapShape(
+    ModuleOp mod, const MapShape &shape) const {
+    auto numKeys = shape.keys.size();
+    auto keysAttr = SeqAttr::get(TupleType::get(context, numKeys), shape.keys);
+    auto name = std::string("map_shape_") + keysAttr.getHash();
+    if (auto global = mod.lookupSymbol<LLVM::GlobalOp>(name)) return global;
+
+    PatternRewriter::InsertionGuard insertGuard(rewriter);
+    rewriter.setInsertionPointToStart(mod.getBody());
+    auto termTy = getUsizeType();
+    auto tupleTy = getTupleType(numKeys);
+    auto global = getOrInsertGlobalConstantOp(mod, name, tupleTy, Attribute(),
+                                              LLVM::Linkage::LinkonceODR);
+
+    auto &initRegion = global.getInitializerRegion();
+    rewriter.createBlock(&initRegion);
+    APInt header = targetInfo.encodeHeader(TypeKind::Tuple, numKeys);
+    Value headerTerm = llvm_constant(termTy, getIntegerAttr(header));
+    Value tuple = llvm_insertvalue(tupleTy, llvm_undef(tupleTy), headerTerm,
+                                   getI64ArrayAttr(0));
+    for (unsigned i = 0; i < numKeys; ++i) {
+        uint64_t id;
+        if (auto boolAttr = shape.keys[i].dyn_cast<BoolAttr>())
+            id = boolAttr.getValue() ? 1 : 0;
+        else
+            id = shape.keys[i].cast<AtomAttr>().getValue().getLimitedValue();
+        APInt key = targetInfo.encodeImmediate(TypeKind::Atom, id);
+        Value keyTerm = llvm_constant(termTy, getIntegerAttr(key));
+        tuple =
+            llvm_insertvalue(tupleTy, tuple, keyTerm, getI64ArrayAttr(i + 1));
+    }
+    rewriter.create<LLVM::ReturnOp>(mod.getLoc(), tuple);
+    return global;
+}
+
 Value OpConversionContext::encodeList(Value cons, bool isLiteral) const {
     auto termTy = getUsizeType();
     Value ptrInt = llvm_ptrtoint(termTy, cons);
@@ -361,19 +528,32 @@ Value OpConversionContext::encodeLiteral(Value val) const {
     return llvm_or(ptrInt, tag);
 }
 
+// Encodes a raw immediate value (e.g. fixnum, atom id) as a term inline.
+//
+// With shifted encodings (64-bit and wasm32), the payload is shifted up past
+// the primary tag; with nanboxing, the tag lives in the high bits, so the
+// payload is masked to the available bits. In both cases the tag for `ty` is
+// what we get from encoding zero with that type.
 Value OpConversionContext::encodeImmediate(ModuleOp mod, Location loc,
                                            OpaqueTermType ty, Value val) const {
     auto termTy = getUsizeType();
-    auto i32Ty = getI32Type();
-    StringRef symbolName("__lumen_builtin_encode_immediate");
-    auto callee = getOrInsertFunction(mod, symbolName, termTy, {i32Ty, termTy});
-    auto calleeSymbol =
-        FlatSymbolRefAttr::get(symbolName, callee->getContext());
+    auto maskInfo = targetInfo.immediateMask();
 
-    Value kind = llvm_constant(i32Ty, getI32Attr(ty.getTypeKind().getValue()));
-    ArrayRef<Value> args{kind, val};
-    Operation *call = std_call(calleeSymbol, ArrayRef<Type>{termTy}, args);
-    return call->getResult(0);
+    // Floats are immediates only when nanboxed, and are stored as-is
+    if (ty.isFloat()) return val;
+
+    APInt rawTag =
+        targetInfo.encodeImmediate(ty.getTypeKind().getValue(), /*value=*/0);
+    Value tag = llvm_constant(termTy, getIntegerAttr(rawTag));
+    Value payload;
+    if (maskInfo.requiresShift()) {
+        Value shift = llvm_constant(termTy, getIntegerAttr(maskInfo.shift));
+        payload = llvm_shl(val, shift);
+    } else {
+        Value mask = llvm_constant(termTy, getIntegerAttr(maskInfo.mask));
+        payload = llvm_and(val, mask);
+    }
+    return llvm_or(payload, tag);
 }
 
 Value OpConversionContext::decodeBox(LLVMType innerTy, Value box) const {
@@ -404,14 +584,110 @@ Value OpConversionContext::decodeImmediate(Value val) const {
     auto termTy = getUsizeType();
     auto maskInfo = targetInfo.immediateMask();
 
+    // When the payload is shifted, the mask describes the tag bits, which are
+    // discarded by shifting them back out; this also preserves the sign
+    if (maskInfo.requiresShift()) {
+        Value shift = llvm_constant(termTy, getIntegerAttr(maskInfo.shift));
+        return llvm_ashr(val, shift);
+    }
+
     Value mask = llvm_constant(termTy, getIntegerAttr(maskInfo.mask));
+    return llvm_and(val, mask);
+}
+
+Value OpConversionContext::isImmediateOfKind(Value val, uint32_t kind) const {
+    auto termTy = getUsizeType();
+    auto maskInfo = targetInfo.immediateMask();
+    auto tag = targetInfo.encodeImmediate(kind, 0);
+
+    // When the payload is shifted, the tag occupies the bits covered by the
+    // mask, otherwise it occupies all of the bits above the payload
+    uint64_t tagMask =
+        maskInfo.requiresShift() ? maskInfo.mask : ~maskInfo.mask;
+    Value mask = llvm_constant(termTy, getIntegerAttr(tagMask));
+    Value expected = llvm_constant(termTy, getIntegerAttr(tag));
     Value masked = llvm_and(val, mask);
+    return llvm_icmp(LLVM::ICmpPredicate::eq, masked, expected);
+}
+
+Value OpConversionContext::isBoxedTerm(Value val) const {
+    auto termTy = getUsizeType();
+    auto maskInfo = targetInfo.immediateMask();
+    Value zero = llvm_constant(termTy, getIntegerAttr(0));
+
+    // With shifted encodings, boxes and literals each have a primary tag, and
+    // the pointer must be non-null
+    if (maskInfo.requiresShift()) {
+        Value mask = llvm_constant(termTy, getIntegerAttr(maskInfo.mask));
+        Value boxTag =
+            llvm_constant(termTy, getIntegerAttr(targetInfo.boxTag()));
+        Value literalTag =
+            llvm_constant(termTy, getIntegerAttr(targetInfo.literalTag()));
+        Value tag = llvm_and(val, mask);
+        Value isBox = llvm_icmp(LLVM::ICmpPredicate::eq, tag, boxTag);
+        Value isLiteral = llvm_icmp(LLVM::ICmpPredicate::eq, tag, literalTag);
+        Value ptrMask =
+            llvm_constant(termTy, getIntegerAttr(~maskInfo.mask));
+        Value ptr = llvm_and(val, ptrMask);
+        Value nonNull = llvm_icmp(LLVM::ICmpPredicate::ne, ptr, zero);
+        return llvm_and(llvm_or(isBox, isLiteral), nonNull);
+    }
+
+    // Otherwise, boxes are untagged pointers, possibly with the literal bit
+    // set, but neither null nor a null literal
+    Value maxAddr = llvm_constant(termTy, getIntegerAttr(maskInfo.mask));
+    Value literalTag =
+        llvm_constant(termTy, getIntegerAttr(targetInfo.literalTag()));
+    Value inRange = llvm_icmp(LLVM::ICmpPredicate::ule, val, maxAddr);
+    Value nonNull = llvm_icmp(LLVM::ICmpPredicate::ugt, val, literalTag);
+    return llvm_and(inRange, nonNull);
+}
+
+Value OpConversionContext::decodeBoxedTerm(Value val) const {
+    auto termTy = getUsizeType();
+    auto maskInfo = targetInfo.immediateMask();
+    // Clears the box or literal tag, leaving the pointer to the term header
+    uint64_t tagMask = maskInfo.requiresShift() ? maskInfo.mask
+                                                : targetInfo.literalTag();
+    Value mask = llvm_constant(termTy, getIntegerAttr(~tagMask));
+    Value untagged = llvm_and(val, mask);
+    return llvm_inttoptr(termTy.getPointerTo(), untagged);
+}
+
+Value OpConversionContext::isHeaderOfKind(Value header, uint32_t kind) const {
+    auto tag = targetInfo.encodeHeader(kind, 0);
+    return isHeaderWithTag(header, tag.getLimitedValue());
+}
+
+Value OpConversionContext::isHeaderWithTag(Value header, uint64_t tag) const {
+    auto termTy = getUsizeType();
+    auto maskInfo = targetInfo.headerMask();
+
+    // When the header value is shifted, the tag occupies the bits below it,
+    // otherwise it occupies all of the bits above the value
+    uint64_t tagMask = maskInfo.requiresShift()
+                           ? (uint64_t(1) << maskInfo.shift) - 1
+                           : ~maskInfo.mask;
+    Value mask = llvm_constant(termTy, getIntegerAttr(tagMask));
+    Value expected = llvm_constant(termTy, getIntegerAttr(tag));
+    Value masked = llvm_and(header, mask);
+    return llvm_icmp(LLVM::ICmpPredicate::eq, masked, expected);
+}
+
+Value OpConversionContext::decodeHeaderValue(Value header) const {
+    auto termTy = getUsizeType();
+    auto maskInfo = targetInfo.headerMask();
+
+    Value value = header;
+    if (maskInfo.mask != 0) {
+        Value mask = llvm_constant(termTy, getIntegerAttr(maskInfo.mask));
+        value = llvm_and(value, mask);
+    }
     if (maskInfo.requiresShift()) {
         Value shift = llvm_constant(termTy, getIntegerAttr(maskInfo.shift));
-        return llvm_shr(masked, shift);
-    } else {
-        return masked;
+        value = llvm_shr(value, shift);
     }
+    return value;
 }
 }  // namespace eir
 }  // namespace lumen
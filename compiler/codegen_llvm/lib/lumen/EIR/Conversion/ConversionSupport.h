@@ -56,6 +56,7 @@ using llvm_or = ValueBuilder<LLVM::OrOp>;
 using llvm_xor = ValueBuilder<LLVM::XOrOp>;
 using llvm_shl = ValueBuilder<LLVM::ShlOp>;
 using llvm_shr = ValueBuilder<LLVM::LShrOp>;
+using llvm_ashr = ValueBuilder<LLVM::AShrOp>;
 using llvm_bitcast = ValueBuilder<LLVM::BitcastOp>;
 using llvm_zext = ValueBuilder<LLVM::ZExtOp>;
 using llvm_sext = ValueBuilder<LLVM::SExtOp>;
@@ -146,6 +147,28 @@ struct EirTypeConverter : public mlir::TypeConverter {
 Optional<Type> convertType(Type type, EirTypeConverter &converter,
                            TargetInfo &targetInfo);
 
+// The indices of the fields of a closure, see TargetInfo::makeClosureType
+static constexpr unsigned CLOSURE_ARITY_INDEX = 2;
+static constexpr unsigned CLOSURE_CODE_INDEX = 4;
+static constexpr unsigned CLOSURE_ENV_INDEX = 5;
+
+// The largest number of entries a flat map may have, this must match
+// MAX_FLAT_MAP_SIZE in liblumen_alloc
+static constexpr unsigned MAX_FLAT_MAP_SIZE = 32;
+
+// The shape of a flat map (see `Map` in liblumen_alloc), i.e. its keys in
+// ascending order, and for each of them, the position of the corresponding
+// entry in the map as it was written
+struct MapShape {
+    SmallVector<Attribute, 4> keys;
+    SmallVector<unsigned, 4> order;
+};
+
+// Returns the shape of a map with the given constant keys, if it can be flat,
+// which is the case when the keys are distinct atoms, and there are at most
+// MAX_FLAT_MAP_SIZE of them
+Optional<MapShape> getMapShape(ArrayRef<Attribute> keys);
+
 class ConversionContext {
    public:
     explicit ConversionContext(MLIRContext *ctx, EirTypeConverter &tc,
@@ -330,9 +353,16 @@ class OpConversionContext : public ConversionContext {
     }
     LLVM::GlobalOp getOrInsertGlobalString(ModuleOp mod, StringRef name,
                                            StringRef value) const;
+    LLVM::GlobalOp getOrInsertMapShape(ModuleOp mod,
+                                       const MapShape &shape) const;
 
     Value buildMalloc(ModuleOp mod, LLVMType ty, unsigned allocTy,
                       Value arity) const;
+    Value buildInlineMalloc(ModuleOp mod, LLVMType ty, unsigned allocTy,
+                            Value arity, unsigned words) const;
+    Value buildReservedMalloc(ModuleOp mod, LLVMType ty,
+                              unsigned words) const;
+    Value buildStackAlloc(Operation *op, LLVMType ty) const;
 
     Value encodeList(Value cons, bool isLiteral = false) const;
     Value encodeBox(Value val) const;
@@ -342,6 +372,12 @@ class OpConversionContext : public ConversionContext {
     Value decodeBox(LLVMType innerTy, Value box) const;
     Value decodeList(Value box) const;
     Value decodeImmediate(Value val) const;
+    Value isImmediateOfKind(Value val, uint32_t kind) const;
+    Value isBoxedTerm(Value val) const;
+    Value decodeBoxedTerm(Value val) const;
+    Value isHeaderOfKind(Value header, uint32_t kind) const;
+    Value isHeaderWithTag(Value header, uint64_t tag) const;
+    Value decodeHeaderValue(Value header) const;
 };
 
 template <typename Op>
@@ -360,6 +396,8 @@ class RewritePatternContext : public OpConversionContext {
 
     using OpConversionContext::context;
     using OpConversionContext::decodeBox;
+    using OpConversionContext::decodeBoxedTerm;
+    using OpConversionContext::decodeHeaderValue;
     using OpConversionContext::decodeImmediate;
     using OpConversionContext::decodeList;
     using OpConversionContext::encodeBox;
@@ -382,6 +420,10 @@ class RewritePatternContext : public OpConversionContext {
     using OpConversionContext::getStringAttr;
     using OpConversionContext::getTupleType;
     using OpConversionContext::getUsizeType;
+    using OpConversionContext::isBoxedTerm;
+    using OpConversionContext::isHeaderOfKind;
+    using OpConversionContext::isHeaderWithTag;
+    using OpConversionContext::isImmediateOfKind;
     using OpConversionContext::rewriter;
     using OpConversionContext::targetInfo;
     using OpConversionContext::typeConverter;
@@ -459,10 +501,27 @@ class RewritePatternContext : public OpConversionContext {
         ModuleOp mod = getModule();
         return OpConversionContext::getOrInsertGlobalString(mod, name, value);
     }
+    LLVM::GlobalOp getOrInsertMapShape(const MapShape &shape) const {
+        ModuleOp mod = getModule();
+        return OpConversionContext::getOrInsertMapShape(mod, shape);
+    }
     Value buildMalloc(LLVMType ty, unsigned allocTy, Value arity) const {
         ModuleOp mod = getModule();
         return OpConversionContext::buildMalloc(mod, ty, allocTy, arity);
     }
+    Value buildInlineMalloc(LLVMType ty, unsigned allocTy, Value arity,
+                            unsigned words) const {
+        ModuleOp mod = getModule();
+        return OpConversionContext::buildInlineMalloc(mod, ty, allocTy, arity,
+                                                      words);
+    }
+    Value buildReservedMalloc(LLVMType ty, unsigned words) const {
+        ModuleOp mod = getModule();
+        return OpConversionContext::buildReservedMalloc(mod, ty, words);
+    }
+    Value buildStackAlloc(LLVMType ty) const {
+        return OpConversionContext::buildStackAlloc(op.getOperation(), ty);
+    }
     Value encodeImmediate(OpaqueTermType ty, Value val) const {
         ModuleOp mod = getModule();
         return OpConversionContext::encodeImmediate(mod, val.getLoc(), ty, val);
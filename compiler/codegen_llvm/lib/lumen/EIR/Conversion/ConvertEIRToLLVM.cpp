@@ -20,13 +20,16 @@ class ConvertEIRToLLVMPass
     : public mlir::PassWrapper<ConvertEIRToLLVMPass,
                                mlir::OperationPass<ModuleOp>> {
    public:
-    ConvertEIRToLLVMPass(TargetMachine *targetMachine_)
+    ConvertEIRToLLVMPass(TargetMachine *targetMachine_,
+                         uint32_t maxReductions_)
         : targetMachine(targetMachine_),
+          maxReductions(maxReductions_),
           mlir::PassWrapper<ConvertEIRToLLVMPass,
                             mlir::OperationPass<ModuleOp>>() {}
 
     ConvertEIRToLLVMPass(const ConvertEIRToLLVMPass &other)
         : targetMachine(other.targetMachine),
+          maxReductions(other.maxReductions),
           mlir::PassWrapper<ConvertEIRToLLVMPass,
                             mlir::OperationPass<ModuleOp>>() {}
 
@@ -77,7 +80,7 @@ class ConvertEIRToLLVMPass
         populateControlFlowOpConversionPatterns(patterns, &context, converter,
                                                 targetInfo);
         populateFuncLikeOpConversionPatterns(patterns, &context, converter,
-                                             targetInfo);
+                                             targetInfo, maxReductions);
         populateMapOpConversionPatterns(patterns, &context, converter,
                                         targetInfo);
         populateMathOpConversionPatterns(patterns, &context, converter,
@@ -98,11 +101,164 @@ class ConvertEIRToLLVMPass
 
    private:
     TargetMachine *targetMachine;
+    uint32_t maxReductions;
 };
 
 std::unique_ptr<mlir::Pass> createConvertEIRToLLVMPass(
-    TargetMachine *targetMachine) {
-    return std::make_unique<ConvertEIRToLLVMPass>(targetMachine);
+    TargetMachine *targetMachine, uint32_t maxReductions) {
+    return std::make_unique<ConvertEIRToLLVMPass>(targetMachine,
+                                                  maxReductions);
+}
+
+// Appends the names of the symbols referenced by `attr` to `names`, including
+// those referenced by the elements of constant aggregates
+static void collectSymbolRefs(Attribute attr,
+                              SmallVectorImpl<StringRef> &names) {
+    if (auto symAttr = attr.dyn_cast<SymbolRefAttr>()) {
+        names.push_back(symAttr.getRootReference());
+    } else if (auto arrayAttr = attr.dyn_cast<ArrayAttr>()) {
+        for (Attribute element : arrayAttr) collectSymbolRefs(element, names);
+    } else if (auto dictAttr = attr.dyn_cast<DictionaryAttr>()) {
+        for (auto namedAttr : dictAttr)
+            collectSymbolRefs(std::get<Attribute>(namedAttr), names);
+    } else if (auto seqAttr = attr.dyn_cast<SeqAttr>()) {
+        for (Attribute element : seqAttr.getValue())
+            collectSymbolRefs(element, names);
+    }
+}
+
+// Moves each function definition in the module into a nested module of its
+// own, leaving a declaration of the function in its place.
+//
+// Conversion patterns insert declarations and globals into the module
+// containing the op being converted, so with each function in its own module,
+// functions can be converted in parallel, by nesting the conversion pass on
+// these modules. Conversion only looks up symbols in the nested module, so
+// every symbol of the parent that the function refers to is copied into it:
+// declarations of functions, so that calls see their real type, and globals
+// along with anything their initializers refer to. The copies are discarded
+// in favor of the originals when the modules are merged again.
+class IsolateFunctionsPass
+    : public mlir::PassWrapper<IsolateFunctionsPass,
+                               mlir::OperationPass<ModuleOp>> {
+   public:
+    void runOnOperation() final {
+        ModuleOp mod = getOperation();
+
+        SmallVector<FuncOp, 16> definitions;
+        for (auto func : mod.getOps<FuncOp>())
+            if (!func.isExternal()) definitions.push_back(func);
+
+        OpBuilder builder(mod.getBodyRegion());
+        SmallVector<ModuleOp, 16> isolated;
+        for (FuncOp func : definitions) {
+            builder.setInsertionPoint(func);
+            builder.insert(func.getOperation()->cloneWithoutRegions());
+            auto nested = builder.create<ModuleOp>(func.getLoc());
+            Operation *terminator = nested.getBody()->getTerminator();
+            func.getOperation()->moveBefore(terminator);
+            isolated.push_back(nested);
+        }
+
+        // Every definition has been replaced by a declaration by now, so
+        // references between functions resolve to those
+        SymbolTable symbolTable(mod);
+        for (ModuleOp nested : isolated) importSymbols(symbolTable, nested);
+    }
+
+   private:
+    static void importSymbols(SymbolTable &symbolTable, ModuleOp nested) {
+        SymbolTable nestedSymbolTable(nested);
+        Block *body = nested.getBody();
+
+        SmallVector<Operation *, 8> worklist{&body->front()};
+        while (!worklist.empty()) {
+            Operation *root = worklist.pop_back_val();
+
+            SmallVector<StringRef, 8> names;
+            root->walk([&](Operation *op) {
+                for (auto namedAttr : op->getAttrs())
+                    collectSymbolRefs(std::get<Attribute>(namedAttr), names);
+            });
+
+            for (StringRef name : names) {
+                if (nestedSymbolTable.lookup(name)) continue;
+                Operation *symbol = symbolTable.lookup(name);
+                if (!symbol) continue;
+
+                Operation *copy;
+                if (isa<FuncOp>(symbol) || isa<mlir::FuncOp>(symbol) ||
+                    isa<LLVM::LLVMFuncOp>(symbol)) {
+                    copy = symbol->cloneWithoutRegions();
+                } else {
+                    copy = symbol->clone();
+                    worklist.push_back(copy);
+                }
+                nestedSymbolTable.insert(copy, body->begin());
+            }
+        }
+    }
+};
+
+// The inverse of `IsolateFunctionsPass`, run once the nested modules have been
+// converted. The contents of each nested module are moved back into the
+// parent in order, with converted functions replacing the declarations left
+// in their place. Symbols which more than one function needed will have been
+// inserted into several nested modules, and those copied from the parent are
+// already there; only the first is kept.
+class MergeIsolatedFunctionsPass
+    : public mlir::PassWrapper<MergeIsolatedFunctionsPass,
+                               mlir::OperationPass<ModuleOp>> {
+   public:
+    void runOnOperation() final {
+        ModuleOp mod = getOperation();
+        SymbolTable symbolTable(mod);
+
+        SmallVector<ModuleOp, 16> isolated(mod.getOps<ModuleOp>());
+        for (ModuleOp nested : isolated) {
+            Block *body = nested.getBody();
+            for (Operation &op :
+                 llvm::make_early_inc_range(body->without_terminator())) {
+                auto name = op.getAttrOfType<StringAttr>(
+                    SymbolTable::getSymbolAttrName());
+                if (!name) {
+                    op.moveBefore(nested);
+                    continue;
+                }
+
+                Operation *existing = symbolTable.lookup(name.getValue());
+                if (!existing) {
+                    op.remove();
+                    symbolTable.insert(&op, Block::iterator(nested));
+                } else if (isDeclaration(existing) && !isDeclaration(&op)) {
+                    Block::iterator insertPt(existing->getNextNode());
+                    symbolTable.erase(existing);
+                    op.remove();
+                    symbolTable.insert(&op, insertPt);
+                } else {
+                    op.erase();
+                }
+            }
+            nested.erase();
+        }
+    }
+
+   private:
+    static bool isDeclaration(Operation *op) {
+        if (auto func = dyn_cast<FuncOp>(op)) return func.isExternal();
+        if (auto func = dyn_cast<mlir::FuncOp>(op)) return func.isExternal();
+        if (auto func = dyn_cast<LLVM::LLVMFuncOp>(op))
+            return func.isExternal();
+        return false;
+    }
+};
+
+std::unique_ptr<mlir::Pass> createIsolateFunctionsPass() {
+    return std::make_unique<IsolateFunctionsPass>();
+}
+
+std::unique_ptr<mlir::Pass> createMergeIsolatedFunctionsPass() {
+    return std::make_unique<MergeIsolatedFunctionsPass>();
 }
 
 }  // namespace eir
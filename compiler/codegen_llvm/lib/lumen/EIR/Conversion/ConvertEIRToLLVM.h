@@ -3,6 +3,7 @@
 
 #include "mlir/Pass/Pass.h"
 
+#include <cstdint>
 #include <memory>
 
 namespace llvm {
@@ -12,7 +13,12 @@ class TargetMachine;
 namespace lumen {
 namespace eir {
 std::unique_ptr<mlir::Pass> createConvertEIRToLLVMPass(
-    llvm::TargetMachine *targetMachine);
+    llvm::TargetMachine *targetMachine, uint32_t maxReductions);
+
+// Used to convert functions in parallel, by moving each function into a
+// nested module of its own before conversion, and back out again after
+std::unique_ptr<mlir::Pass> createIsolateFunctionsPass();
+std::unique_ptr<mlir::Pass> createMergeIsolatedFunctionsPass();
 }  // namespace eir
 }  // namespace lumen
 
@@ -3,8 +3,6 @@
 namespace lumen {
 namespace eir {
 
-const unsigned CLOSURE_ENV_INDEX = 5;
-
 // The purpose of this conversion is to build a function that contains
 // all of the prologue setup our Erlang functions need (in cases where
 // this isn't a declaration). Specifically:
@@ -13,7 +11,10 @@ const unsigned CLOSURE_ENV_INDEX = 5;
 // - Check if we should garbage collect
 //   - If either of the above are true, yield
 struct FuncOpConversion : public EIROpConversion<eir::FuncOp> {
-    using EIROpConversion::EIROpConversion;
+    explicit FuncOpConversion(MLIRContext *context, EirTypeConverter &converter,
+                              TargetInfo &targetInfo, uint32_t maxReductions)
+        : EIROpConversion(context, converter, targetInfo),
+          maxReductions(maxReductions) {}
 
     LogicalResult matchAndRewrite(
         eir::FuncOp op, ArrayRef<Value> operands,
@@ -57,12 +58,10 @@ struct FuncOpConversion : public EIROpConversion<eir::FuncOp> {
             // Insert yield check in original entry block
             rewriter.setInsertionPointToEnd(entry);
 
-            const uint32_t MAX_REDUCTIONS =
-                20;  // TODO: Move this up in the compiler
-            Value maxReductions =
-                llvm_constant(i32Ty, ctx.getI32Attr(MAX_REDUCTIONS));
-            rewriter.create<YieldCheckOp>(op.getLoc(), maxReductions, doYield,
-                                          ValueRange{}, dontYield,
+            Value maxReductionsConst =
+                llvm_constant(i32Ty, ctx.getI32Attr(maxReductions));
+            rewriter.create<YieldCheckOp>(op.getLoc(), maxReductionsConst,
+                                          doYield, ValueRange{}, dontYield,
                                           ValueRange{});
             // Then insert the actual yield point in the yield block
             rewriter.setInsertionPointToEnd(doYield);
@@ -75,6 +74,9 @@ struct FuncOpConversion : public EIROpConversion<eir::FuncOp> {
 
         return success();
     }
+
+   private:
+    uint32_t maxReductions;
 };
 
 struct ClosureOpConversion : public EIROpConversion<ClosureOp> {
@@ -149,6 +151,8 @@ struct ClosureOpConversion : public EIROpConversion<ClosureOp> {
             llvm_constant(termTy, ctx.getIntegerAttr(headerArity));
         auto mallocOp =
             rewriter.create<MallocOp>(loc, closurePtrTy, headerArityConst);
+        if (op.isReserved())
+            mallocOp.setAttr("reserved", rewriter.getUnitAttr());
         auto valRef = mallocOp.getResult();
 
         // Calculate pointers to each field in the header and write the
@@ -175,7 +179,8 @@ struct ClosureOpConversion : public EIROpConversion<ClosureOp> {
         // Arity
         // arity: u32,
         Value arityConst = llvm_constant(i32Ty, ctx.getIntegerAttr(arity));
-        Value arityIdx = llvm_constant(i32Ty, ctx.getI32Attr(2));
+        Value arityIdx =
+            llvm_constant(i32Ty, ctx.getI32Attr(CLOSURE_ARITY_INDEX));
         Value arityPtrGep =
             llvm_gep(i32PtrTy, valRef, ValueRange{zero, arityIdx});
         llvm_store(arityConst, arityPtrGep);
@@ -225,7 +230,8 @@ struct ClosureOpConversion : public EIROpConversion<ClosureOp> {
         // code: Option<*const ()>,
         Value codePtr =
             llvm_addressof(targetType.getPointerTo(), callee.getValue());
-        Value codeIdx = llvm_constant(i32Ty, ctx.getI32Attr(4));
+        Value codeIdx =
+            llvm_constant(i32Ty, ctx.getI32Attr(CLOSURE_CODE_INDEX));
         LLVMType opaqueFnPtrTy = opaqueFnTy.getPointerTo();
         Value codePtrGep = llvm_gep(opaqueFnPtrTy.getPointerTo(), valRef,
                                     ValueRange{zero, codeIdx});
@@ -289,13 +295,103 @@ struct UnpackEnvOpConversion : public EIROpConversion<UnpackEnvOp> {
     }
 };
 
+struct ResolveClosureOpConversion
+    : public EIROpConversion<ResolveClosureOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        ResolveClosureOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        ResolveClosureOpAdaptor adaptor(operands);
+        auto ctx = getRewriteContext(op, rewriter);
+
+        LLVMType termTy = ctx.getUsizeType();
+        LLVMType i1Ty = ctx.getI1Type();
+        LLVMType i8PtrTy = ctx.getI8Type().getPointerTo();
+        LLVMType i32Ty = ctx.getI32Type();
+        LLVMType i32PtrTy = i32Ty.getPointerTo();
+        LLVMType opaqueFnPtrTy =
+            ctx.targetInfo.getOpaqueFnType().getPointerTo();
+        // The fields we need precede the environment, so their layout is the
+        // same for all closures
+        LLVMType closurePtrTy =
+            ctx.targetInfo.makeClosureType(0).getPointerTo();
+
+        Value closure = adaptor.closure();
+
+        Block *current = rewriter.getInsertionBlock();
+        Block *cont =
+            rewriter.splitBlock(current, rewriter.getInsertionPoint());
+        cont->addArgument(i8PtrTy);
+        cont->addArgument(i1Ty);
+        cont->addArgument(i1Ty);
+        Block *boxed = new Block();
+        Block *isClosure = new Block();
+        auto &blocks = current->getParent()->getBlocks();
+        blocks.insert(Region::iterator(cont), boxed);
+        blocks.insert(Region::iterator(cont), isClosure);
+
+        rewriter.setInsertionPointToEnd(current);
+        Value nullPtr = llvm_null(i8PtrTy);
+        Value falseConst = llvm_constant(i1Ty, ctx.getI1Attr(0));
+        llvm_condbr(ctx.isBoxedTerm(closure), boxed, ValueRange(), cont,
+                    ValueRange{nullPtr, falseConst, falseConst});
+
+        rewriter.setInsertionPointToEnd(boxed);
+        Value headerPtr = ctx.decodeBoxedTerm(closure);
+        Value header = llvm_load(headerPtr);
+        llvm_condbr(ctx.isHeaderOfKind(header, TypeKind::Closure), isClosure,
+                    ValueRange(), cont,
+                    ValueRange{nullPtr, falseConst, falseConst});
+
+        // The closure can be called directly if the arity matches, and it
+        // has code, which is not the case for closures received over ETF
+        rewriter.setInsertionPointToEnd(isClosure);
+        Value closurePtr = llvm_bitcast(closurePtrTy, headerPtr);
+        Value zero = llvm_constant(i32Ty, ctx.getI32Attr(0));
+        Value arityIdx =
+            llvm_constant(i32Ty, ctx.getI32Attr(CLOSURE_ARITY_INDEX));
+        Value arityPtr =
+            llvm_gep(i32PtrTy, closurePtr, ValueRange{zero, arityIdx});
+        Value arity = llvm_load(arityPtr);
+        Value expectedArity = llvm_constant(i32Ty, ctx.getI32Attr(op.arity()));
+        Value isArity =
+            llvm_icmp(LLVM::ICmpPredicate::eq, arity, expectedArity);
+
+        Value codeIdx =
+            llvm_constant(i32Ty, ctx.getI32Attr(CLOSURE_CODE_INDEX));
+        Value codePtr = llvm_gep(opaqueFnPtrTy.getPointerTo(), closurePtr,
+                                 ValueRange{zero, codeIdx});
+        Value code = llvm_bitcast(i8PtrTy, llvm_load(codePtr));
+        Value hasCode = llvm_icmp(LLVM::ICmpPredicate::ne, code, nullPtr);
+        Value found = llvm_and(isArity, hasCode);
+
+        // The header arity only exceeds that of a closure with an empty
+        // environment if there are captured values
+        Value headerArity = ctx.decodeHeaderValue(header);
+        Value emptyEnvArity = llvm_constant(
+            termTy, ctx.getIntegerAttr(ctx.targetInfo.closureHeaderArity(0)));
+        Value hasEnv =
+            llvm_icmp(LLVM::ICmpPredicate::ugt, headerArity, emptyEnvArity);
+        llvm_br(ValueRange{code, found, hasEnv}, cont);
+
+        rewriter.setInsertionPointToStart(cont);
+        rewriter.replaceOp(op, {cont->getArgument(0), cont->getArgument(1),
+                                cont->getArgument(2)});
+        return success();
+    }
+};
+
 void populateFuncLikeOpConversionPatterns(OwningRewritePatternList &patterns,
                                           MLIRContext *context,
                                           EirTypeConverter &converter,
-                                          TargetInfo &targetInfo) {
-    patterns
-        .insert<FuncOpConversion, ClosureOpConversion, UnpackEnvOpConversion>(
-            context, converter, targetInfo);
+                                          TargetInfo &targetInfo,
+                                          uint32_t maxReductions) {
+    patterns.insert<FuncOpConversion>(context, converter, targetInfo,
+                                      maxReductions);
+    patterns.insert<ClosureOpConversion, UnpackEnvOpConversion,
+                    ResolveClosureOpConversion>(context, converter,
+                                                targetInfo);
 }
 
 }  // namespace eir
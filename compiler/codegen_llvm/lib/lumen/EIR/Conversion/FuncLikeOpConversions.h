@@ -8,11 +8,13 @@ namespace eir {
 class FuncOpConversion;
 class ClosureOpConversion;
 class UnpackEnvOpConversion;
+class ResolveClosureOpConversion;
 
 void populateFuncLikeOpConversionPatterns(OwningRewritePatternList &patterns,
                                           MLIRContext *context,
                                           EirTypeConverter &converter,
-                                          TargetInfo &targetInfo);
+                                          TargetInfo &targetInfo,
+                                          uint32_t maxReductions);
 }  // namespace eir
 }  // namespace lumen
 
@@ -3,6 +3,220 @@
 namespace lumen {
 namespace eir {
 
+// The layout of `Map` in liblumen_alloc, in words:
+//
+//   header, keys, values, value (a hash table)
+//
+// For a flat map, `keys` is its shape, a literal tuple, and `values` a tuple
+// of its values in the same order, otherwise both are none
+static constexpr unsigned MAP_KEYS = 1;
+static constexpr unsigned MAP_VALUES = 2;
+
+// Returns the value of `key` if it is a constant atom, otherwise null
+static Attribute getConstantKey(Value key) {
+    Operation *definingOp = key.getDefiningOp();
+    if (auto atomOp = dyn_cast_or_null<ConstantAtomOp>(definingOp))
+        return atomOp.getValue();
+    if (auto boolOp = dyn_cast_or_null<ConstantBoolOp>(definingOp))
+        return boolOp.getValue();
+    return nullptr;
+}
+
+// Returns the shape of `map` if it is known statically, i.e. it is a flat map
+// constructed in the current function, or derived from one by updating keys
+// it already has, possibly passed along as a block argument
+static Optional<MapShape> getStaticMapShape(Value map, unsigned depth = 0) {
+    if (depth > 8) return llvm::None;
+
+    if (auto blockArg = map.dyn_cast<BlockArgument>()) {
+        Block *block = blockArg.getOwner();
+        Block *pred = block->getSinglePredecessor();
+        if (!pred) return llvm::None;
+        auto branch = dyn_cast<mlir::BranchOpInterface>(pred->getTerminator());
+        if (!branch) return llvm::None;
+        for (auto it : llvm::enumerate(pred->getSuccessors())) {
+            if (it.value() != block) continue;
+            auto succOperands = branch.getSuccessorOperands(it.index());
+            if (!succOperands) return llvm::None;
+            Value incoming = (*succOperands)[blockArg.getArgNumber()];
+            return getStaticMapShape(incoming, depth + 1);
+        }
+        return llvm::None;
+    }
+
+    Operation *definingOp = map.getDefiningOp();
+    if (auto mapOp = dyn_cast_or_null<MapOp>(definingOp)) {
+        SmallVector<Attribute, 4> keys;
+        for (unsigned i = 0; i < mapOp.getNumOperands(); i += 2)
+            keys.push_back(getConstantKey(mapOp.getOperand(i)));
+        return getMapShape(keys);
+    }
+    if (auto constMapOp = dyn_cast_or_null<ConstantMapOp>(definingOp)) {
+        auto elements = constMapOp.getValue().cast<SeqAttr>().getValue();
+        SmallVector<Attribute, 4> keys;
+        for (unsigned i = 0; i < elements.size(); i += 2)
+            keys.push_back(elements[i]);
+        return getMapShape(keys);
+    }
+    // The runtime preserves the shape of a flat map when every key given
+    // to it is already present
+    if (auto updateOp = dyn_cast_or_null<MapUpdateManyOp>(definingOp)) {
+        if (map != updateOp.newMap()) return llvm::None;
+        auto shape = getStaticMapShape(updateOp.map(), depth + 1);
+        if (!shape) return llvm::None;
+        auto args = updateOp.args();
+        for (unsigned i = 0; i < args.size(); i += 2) {
+            Attribute key = getConstantKey(args[i]);
+            if (!key || !llvm::is_contained(shape->keys, key))
+                return llvm::None;
+        }
+        return shape;
+    }
+    return llvm::None;
+}
+
+template <typename Op>
+static Value loadWord(RewritePatternContext<Op> &ctx, Value ptr,
+                      unsigned index) {
+    auto termTy = ctx.getUsizeType();
+    Value i = llvm_constant(termTy, ctx.getIntegerAttr(index));
+    return llvm_load(llvm_gep(termTy.getPointerTo(), ptr, ArrayRef<Value>{i}));
+}
+
+// Returns the shape of the map given to `op`, and the index of its key in it,
+// when the key is a constant, and the shape is known statically
+template <typename Op>
+static Optional<std::pair<MapShape, unsigned>> getStaticKeyIndex(Op op) {
+    Attribute key = getConstantKey(op.key());
+    if (!key) return llvm::None;
+    auto shape = getStaticMapShape(op.map());
+    if (!shape) return llvm::None;
+    auto it = llvm::find(shape->keys, key);
+    if (it == shape->keys.end()) return llvm::None;
+    unsigned index = std::distance(shape->keys.begin(), it);
+    return std::make_pair(*shape, index);
+}
+
+// Returns a name for a new lookup cache in the function containing `op`.
+//
+// Functions are converted in modules of their own, and their globals merged
+// by name afterwards, so the name includes the function name to keep caches
+// from different functions apart
+template <typename Op>
+static std::string getLookupCacheName(RewritePatternContext<Op> &ctx) {
+    Operation *funcOp = ctx.op.getOperation();
+    while (!funcOp->hasTrait<mlir::OpTrait::FunctionLike>())
+        funcOp = funcOp->getParentOp();
+    auto funcName =
+        funcOp->getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName());
+
+    std::string prefix =
+        "__lumen_map_cache." + funcName.getValue().str() + ".";
+    ModuleOp mod = ctx.getModule();
+    unsigned n = 0;
+    while (mod.lookupSymbol(prefix + std::to_string(n) + ".shape")) n++;
+    return prefix + std::to_string(n);
+}
+
+// Emits a lookup of `key` in `map`, producing the value associated with it,
+// or none if it is not present.
+//
+// When the key is a constant, the value is loaded directly from a flat map,
+// if the map has the expected shape, at the expected index. If the shape is
+// known statically, both are constants, otherwise they are held in an inline
+// cache for this call site, which `__lumen_builtin_map.lookup` fills in with
+// the shape of the last flat map the key was found in. Like the literal
+// caches, each scheduler thread has its own, so they never need to be
+// synchronized. The cached shape is nil until then, which never matches the
+// keys of a map, as those are either a tuple or none (which is zero) if the
+// map is hashed.
+template <typename Op>
+static Value buildLookup(RewritePatternContext<Op> &ctx, Value map,
+                         Value key) {
+    auto &rewriter = ctx.rewriter;
+    auto termTy = ctx.getUsizeType();
+    auto termPtrTy = termTy.getPointerTo();
+
+    auto buildCall = [&](StringRef symbolName, ArrayRef<Value> args) -> Value {
+        SmallVector<LLVMType, 4> argTypes;
+        for (Value arg : args)
+            argTypes.push_back(arg.getType().cast<LLVMType>());
+        auto callee = ctx.getOrInsertFunction(symbolName, termTy, argTypes);
+        auto calleeSymbol =
+            FlatSymbolRefAttr::get(symbolName, callee->getContext());
+        Operation *callOp =
+            std_call(calleeSymbol, ArrayRef<Type>{termTy}, args);
+        return callOp->getResult(0);
+    };
+
+    if (!getConstantKey(ctx.op.key()))
+        return buildCall("__lumen_builtin_map.get", {map, key});
+
+    Value expectedShape, index, shapePtr, indexPtr;
+    auto keyIndex = getStaticKeyIndex(ctx.op);
+    if (keyIndex) {
+        expectedShape = ctx.encodeLiteral(
+            llvm_addressof(ctx.getOrInsertMapShape(keyIndex->first)));
+        index = llvm_constant(termTy, ctx.getIntegerAttr(keyIndex->second));
+    } else {
+        std::string cacheName = getLookupCacheName(ctx);
+        auto nilAttr = ctx.getIntegerAttr(ctx.getNilValue());
+        shapePtr = ctx.getOrInsertGlobal(cacheName + ".shape", termTy,
+                                         nilAttr, LLVM::Linkage::Internal,
+                                         LLVM::ThreadLocalMode::LocalExec);
+        indexPtr = ctx.getOrInsertGlobal(cacheName + ".index", termTy,
+                                         ctx.getIntegerAttr(0),
+                                         LLVM::Linkage::Internal,
+                                         LLVM::ThreadLocalMode::LocalExec);
+        expectedShape = llvm_load(shapePtr);
+    }
+
+    Block *current = rewriter.getInsertionBlock();
+    Block *cont = rewriter.splitBlock(current, rewriter.getInsertionPoint());
+    cont->addArgument(termTy);
+    Block *fastBlock = new Block();
+    Block *slowBlock = new Block();
+    auto contIt = Region::iterator(cont);
+    auto &blocks = current->getParent()->getBlocks();
+    blocks.insert(contIt, fastBlock);
+    blocks.insert(contIt, slowBlock);
+
+    rewriter.setInsertionPointToEnd(current);
+    Value mapPtr = ctx.decodeBoxedTerm(map);
+    Value keys = loadWord(ctx, mapPtr, MAP_KEYS);
+    Value isShape = llvm_icmp(LLVM::ICmpPredicate::eq, keys, expectedShape);
+    llvm_condbr(isShape, fastBlock, ValueRange(), slowBlock, ValueRange());
+
+    // The value is loaded from the values tuple, skipping its header
+    rewriter.setInsertionPointToEnd(fastBlock);
+    if (!keyIndex) index = llvm_load(indexPtr);
+    Value one = llvm_constant(termTy, ctx.getIntegerAttr(1));
+    Value valueIndex = llvm_add(index, one);
+    Value valuesPtr = ctx.decodeBoxedTerm(loadWord(ctx, mapPtr, MAP_VALUES));
+    Value value =
+        llvm_load(llvm_gep(termPtrTy, valuesPtr, ArrayRef<Value>{valueIndex}));
+    llvm_br(ValueRange(value), cont);
+
+    rewriter.setInsertionPointToEnd(slowBlock);
+    Value slowValue;
+    if (keyIndex)
+        slowValue = buildCall("__lumen_builtin_map.get", {map, key});
+    else
+        slowValue = buildCall("__lumen_builtin_map.lookup",
+                              {map, key, shapePtr, indexPtr});
+    llvm_br(ValueRange(slowValue), cont);
+
+    rewriter.setInsertionPointToStart(cont);
+    return cont->getArgument(0);
+}
+
+template <typename Op>
+static Value buildIsFound(RewritePatternContext<Op> &ctx, Value value) {
+    auto termTy = ctx.getUsizeType();
+    Value none = llvm_constant(termTy, ctx.getIntegerAttr(ctx.getNoneValue()));
+    return llvm_icmp(LLVM::ICmpPredicate::ne, value, none);
+}
+
 struct MapOpConversion : public EIROpConversion<MapOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -14,41 +228,75 @@ struct MapOpConversion : public EIROpConversion<MapOp> {
         MapOpAdaptor adaptor(operands);
 
         auto termTy = ctx.getUsizeType();
-        StringRef symbolName("__lumen_builtin_map.new");
-        auto callee = ctx.getOrInsertFunction(symbolName, termTy, {});
-
-        auto calleeSymbol =
-            FlatSymbolRefAttr::get(symbolName, callee->getContext());
-        auto newMapOp = rewriter.create<mlir::CallOp>(loc, calleeSymbol, termTy,
-                                                      ArrayRef<Value>{});
-        Value newMap = newMapOp.getResult(0);
-
         auto numElements = operands.size();
 
         if (numElements == 0) {
-            rewriter.replaceOp(op, {newMap});
+            StringRef symbolName("__lumen_builtin_map.new");
+            auto callee = ctx.getOrInsertFunction(symbolName, termTy, {});
+
+            auto calleeSymbol =
+                FlatSymbolRefAttr::get(symbolName, callee->getContext());
+            rewriter.replaceOpWithNewOp<mlir::CallOp>(
+                op, calleeSymbol, termTy, ArrayRef<Value>{});
             return success();
         }
 
         assert(numElements % 2 == 0 && "expected an even number of elements");
 
-        StringRef insertSymbolName("__lumen_builtin_map.insert");
-        auto insertCallee =
-            ctx.getOrInsertFunction(insertSymbolName, termTy, {termTy, termTy});
-        auto insertCalleeSymbol = FlatSymbolRefAttr::get(
-            insertSymbolName, insertCallee->getContext());
-
-        for (unsigned i = 0; i < numElements; i++) {
-            Value key = operands[i];
-            Value val = operands[++i];
-
-            auto insertMapOp = rewriter.create<mlir::CallOp>(
-                loc, insertCalleeSymbol, termTy,
-                ArrayRef<Value>{newMap, key, val});
-            newMap = insertMapOp.getResult(0);
+        // The keys and values are passed to the runtime in a buffer on the
+        // stack, so that the map is constructed with a single allocation,
+        // rather than copied for each entry inserted
+        auto i32Ty = ctx.getI32Type();
+        auto termPtrTy = termTy.getPointerTo();
+        auto buildBuffer = [&](ArrayRef<Value> elements) -> Value {
+            auto bufferTy = LLVMType::getArrayTy(termTy, elements.size());
+            Value buffer = ctx.buildStackAlloc(bufferTy);
+            Value zero = llvm_constant(i32Ty, ctx.getI32Attr(0));
+            for (auto it : llvm::enumerate(elements)) {
+                Value index = llvm_constant(i32Ty, ctx.getI32Attr(it.index()));
+                Value elementPtr =
+                    llvm_gep(termPtrTy, buffer, ArrayRef<Value>{zero, index});
+                llvm_store(it.value(), elementPtr);
+            }
+            return llvm_gep(termPtrTy, buffer, ArrayRef<Value>{zero, zero});
+        };
+
+        // When the keys are all constant atoms, the map is flat, and only its
+        // values are passed, in the order of its shape
+        SmallVector<Attribute, 4> keys;
+        for (unsigned i = 0; i < numElements; i += 2)
+            keys.push_back(getConstantKey(op.getOperand(i)));
+        if (auto shape = getMapShape(keys)) {
+            SmallVector<Value, 4> values;
+            for (unsigned i : shape->order)
+                values.push_back(operands[i * 2 + 1]);
+            Value keysTerm = ctx.encodeLiteral(
+                llvm_addressof(ctx.getOrInsertMapShape(*shape)));
+            Value valuesPtr = buildBuffer(values);
+            Value len =
+                llvm_constant(termTy, ctx.getIntegerAttr(values.size()));
+
+            StringRef symbolName("__lumen_builtin_map.from_shape");
+            auto callee = ctx.getOrInsertFunction(symbolName, termTy,
+                                                  {termTy, termPtrTy, termTy});
+            auto calleeSymbol =
+                FlatSymbolRefAttr::get(symbolName, callee->getContext());
+            rewriter.replaceOpWithNewOp<mlir::CallOp>(
+                op, calleeSymbol, termTy,
+                ArrayRef<Value>{keysTerm, valuesPtr, len});
+            return success();
         }
 
-        rewriter.replaceOp(op, {newMap});
+        Value elementsPtr = buildBuffer(operands);
+        Value len = llvm_constant(termTy, ctx.getIntegerAttr(numElements / 2));
+
+        StringRef symbolName("__lumen_builtin_map.from_slice");
+        auto callee =
+            ctx.getOrInsertFunction(symbolName, termTy, {termPtrTy, termTy});
+        auto calleeSymbol =
+            FlatSymbolRefAttr::get(symbolName, callee->getContext());
+        rewriter.replaceOpWithNewOp<mlir::CallOp>(
+            op, calleeSymbol, termTy, ArrayRef<Value>{elementsPtr, len});
         return success();
     }
 };
@@ -119,6 +367,73 @@ struct MapUpdateOpConversion : public EIROpConversion<MapUpdateOp> {
     }
 };
 
+struct MapUpdateManyOpConversion : public EIROpConversion<MapUpdateManyOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        MapUpdateManyOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        auto ctx = getRewriteContext(op, rewriter);
+        auto loc = op.getLoc();
+        MapUpdateManyOpAdaptor adaptor(operands);
+
+        auto termTy = ctx.getUsizeType();
+        auto i32Ty = ctx.getI32Type();
+        auto termPtrTy = termTy.getPointerTo();
+
+        // Each action is passed to the runtime as a `[kind, key, value]`
+        // triple in a buffer on the stack, where kind is 1 for an update, and
+        // 0 for an insert, so that all of them are applied with a single
+        // allocation of the resulting map
+        Value map = adaptor.map();
+        auto args = adaptor.args();
+        auto updates = op.updates().getValue();
+        unsigned numActions = updates.size();
+        assert(args.size() == numActions * 2 &&
+               "expected a key/value pair for each action");
+
+        auto bufferTy = LLVMType::getArrayTy(termTy, numActions * 3);
+        Value buffer = ctx.buildStackAlloc(bufferTy);
+        Value badKeyPtr = ctx.buildStackAlloc(termTy);
+        Value zero = llvm_constant(i32Ty, ctx.getI32Attr(0));
+        auto storeElement = [&](Value element, unsigned i) {
+            Value index = llvm_constant(i32Ty, ctx.getI32Attr(i));
+            Value elementPtr =
+                llvm_gep(termPtrTy, buffer, ArrayRef<Value>{zero, index});
+            llvm_store(element, elementPtr);
+        };
+        for (unsigned i = 0; i < numActions; i++) {
+            bool isUpdate = updates[i].cast<BoolAttr>().getValue();
+            Value kind = llvm_constant(termTy, ctx.getIntegerAttr(isUpdate));
+            storeElement(kind, i * 3);
+            storeElement(args[i * 2], i * 3 + 1);
+            storeElement(args[i * 2 + 1], i * 3 + 2);
+        }
+        Value actionsPtr =
+            llvm_gep(termPtrTy, buffer, ArrayRef<Value>{zero, zero});
+        Value len = llvm_constant(termTy, ctx.getIntegerAttr(numActions));
+
+        StringRef symbolName("__lumen_builtin_map.update_many");
+        auto callee = ctx.getOrInsertFunction(
+            symbolName, termTy, {termTy, termPtrTy, termTy, termPtrTy});
+        auto calleeSymbol =
+            FlatSymbolRefAttr::get(symbolName, callee->getContext());
+        auto newMapOp = rewriter.create<mlir::CallOp>(
+            loc, calleeSymbol, termTy,
+            ArrayRef<Value>{map, actionsPtr, len, badKeyPtr});
+        Value newMap = newMapOp.getResult(0);
+        Value noneVal = llvm_constant(
+            termTy, ctx.getIntegerAttr(
+                        ctx.targetInfo.getNoneValue().getLimitedValue()));
+        Value isOk = llvm_icmp(LLVM::ICmpPredicate::ne, newMap, noneVal);
+        // Only written by the runtime on failure
+        Value badKey = llvm_load(badKeyPtr);
+
+        rewriter.replaceOp(op, {newMap, isOk, badKey});
+        return success();
+    }
+};
+
 struct MapContainsKeyOpConversion : public EIROpConversion<MapContainsKeyOp> {
     using EIROpConversion::EIROpConversion;
 
@@ -128,6 +443,15 @@ struct MapContainsKeyOpConversion : public EIROpConversion<MapContainsKeyOp> {
         auto ctx = getRewriteContext(op, rewriter);
         MapContainsKeyOpAdaptor adaptor(operands);
 
+        Value map = adaptor.map();
+        Value key = adaptor.key();
+
+        if (getConstantKey(op.key())) {
+            Value value = buildLookup(ctx, map, key);
+            rewriter.replaceOp(op, buildIsFound(ctx, value));
+            return success();
+        }
+
         auto termTy = ctx.getUsizeType();
         auto i1Ty = ctx.getI1Type();
         StringRef symbolName("__lumen_builtin_map.is_key");
@@ -135,11 +459,9 @@ struct MapContainsKeyOpConversion : public EIROpConversion<MapContainsKeyOp> {
             ctx.getOrInsertFunction(symbolName, i1Ty, {termTy, termTy});
         auto calleeSymbol =
             FlatSymbolRefAttr::get(symbolName, callee->getContext());
-
-        Value map = adaptor.map();
-        Value key = adaptor.key();
-        rewriter.replaceOpWithNewOp<mlir::CallOp>(op, calleeSymbol, i1Ty,
-                                                  ArrayRef<Value>{map, key});
+        Operation *callOp = std_call(calleeSymbol, ArrayRef<Type>{i1Ty},
+                                     ArrayRef<Value>{map, key});
+        rewriter.replaceOp(op, callOp->getResult(0));
         return success();
     }
 };
@@ -153,17 +475,26 @@ struct MapGetKeyOpConversion : public EIROpConversion<MapGetKeyOp> {
         auto ctx = getRewriteContext(op, rewriter);
         MapGetKeyOpAdaptor adaptor(operands);
 
-        auto termTy = ctx.getUsizeType();
-        StringRef symbolName("__lumen_builtin_map.get");
-        auto callee =
-            ctx.getOrInsertFunction(symbolName, termTy, {termTy, termTy});
-        auto calleeSymbol =
-            FlatSymbolRefAttr::get(symbolName, callee->getContext());
+        Value value = buildLookup(ctx, adaptor.map(), adaptor.key());
+        rewriter.replaceOp(op, value);
+        return success();
+    }
+};
 
-        Value map = adaptor.map();
-        Value key = adaptor.key();
-        rewriter.replaceOpWithNewOp<mlir::CallOp>(op, calleeSymbol, termTy,
-                                                  ArrayRef<Value>{map, key});
+// The value is none when the key is not found, so both results come from a
+// single lookup
+struct MapFindKeyOpConversion : public EIROpConversion<MapFindKeyOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        MapFindKeyOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        auto ctx = getRewriteContext(op, rewriter);
+        MapFindKeyOpAdaptor adaptor(operands);
+
+        Value value = buildLookup(ctx, adaptor.map(), adaptor.key());
+        Value found = buildIsFound(ctx, value);
+        rewriter.replaceOp(op, {value, found});
         return success();
     }
 };
@@ -174,7 +505,8 @@ void populateMapOpConversionPatterns(OwningRewritePatternList &patterns,
                                      TargetInfo &targetInfo) {
     patterns
         .insert<MapOpConversion, MapInsertOpConversion, MapUpdateOpConversion,
-                MapContainsKeyOpConversion, MapGetKeyOpConversion>(
+                MapUpdateManyOpConversion, MapContainsKeyOpConversion,
+                MapGetKeyOpConversion, MapFindKeyOpConversion>(
             context, converter, targetInfo);
 }
 
@@ -8,8 +8,10 @@ namespace eir {
 class MapOpConversion;
 class MapInsertOpConversion;
 class MapUpdateOpConversion;
+class MapUpdateManyOpConversion;
 class MapContainsKeyOpConversion;
 class MapGetKeyOpConversion;
+class MapFindKeyOpConversion;
 
 void populateMapOpConversionPatterns(OwningRewritePatternList &patterns,
                                      MLIRContext *context,
@@ -19,9 +19,12 @@ static void buildDeoptimizationPath(Location loc,
     auto callee = ctx.rewriter.getSymbolRefAttr(intrinsicFn);
     auto i1Ty = ctx.getI1Type();
     auto termTy = ctx.getUsizeType();
-    auto i64Ty = ctx.getI64Type();
-    // TODO: Need to handle 32-bit or non-nanboxed 64 arches here
-    auto iFixTy = LLVMType::getIntNTy(ctx.rewriter.getContext(), 46);
+    // Perform the operation at the width of a fixnum for the target, so that
+    // the overflow bit tells us whether the result still fits in an immediate.
+    // With shifted encodings, fixnums are one bit narrower than the payload.
+    unsigned fixnumBits = ctx.targetInfo.immediateBits();
+    if (ctx.targetInfo.immediateMask().requiresShift()) fixnumBits -= 1;
+    auto iFixTy = LLVMType::getIntNTy(ctx.rewriter.getContext(), fixnumBits);
     auto resTy = LLVMType::getStructTy(ctx.rewriter.getContext(),
                                        ArrayRef<LLVMType>{iFixTy, i1Ty},
                                        /*packed=*/false);
@@ -57,11 +60,11 @@ static void buildDeoptimizationPath(Location loc,
     // block where we re-encode the result and continue
     // execution where we left off
     ctx.rewriter.setInsertionPointToEnd(current);
-    llvm_condbr(obit, normal, ValueRange(), overflow, ValueRange());
+    llvm_condbr(obit, overflow, ValueRange(), normal, ValueRange());
 
     // Handle normal
     ctx.rewriter.setInsertionPointToEnd(normal);
-    Value extended = llvm_zext(termTy, resultFix);
+    Value extended = llvm_sext(termTy, resultFix);
     Value encoded = ctx.encodeImmediate(concreteTy, extended);
     llvm_br(ValueRange(encoded), cont);
 
@@ -20,21 +20,118 @@ struct MallocOpConversion : public EIROpConversion<MallocOp> {
         if (!innerTy) return op.emitOpError("unsupported target type");
 
         auto ty = ctx.typeConverter.convertType(innerTy).cast<LLVMType>();
+        auto kind = innerTy.getTypeKind().getValue();
 
         if (innerTy.hasDynamicExtent()) {
-            Value allocPtr = ctx.buildMalloc(
-                ty, innerTy.getTypeKind().getValue(), adaptor.arity());
+            Value arity = adaptor.arity();
+            // Tuples and closures have a header word followed by `arity`
+            // words, so when the arity is a constant, the size is known
+            // statically and we can allocate inline
+            auto words = getStaticSizeInWords(innerTy, arity);
+            if (op.isReserved() && !words.hasValue())
+                return op.emitOpError(
+                    "reserved allocations must have a static size");
+            Value allocPtr;
+            if (op.isReserved())
+                allocPtr = ctx.buildReservedMalloc(ty, words.getValue());
+            else if (words.hasValue())
+                allocPtr =
+                    ctx.buildInlineMalloc(ty, kind, arity, words.getValue());
+            else
+                allocPtr = ctx.buildMalloc(ty, kind, arity);
             rewriter.replaceOp(op, allocPtr);
         } else {
             Value zero =
                 llvm_constant(ctx.getUsizeType(), ctx.getIntegerAttr(0));
-            Value allocPtr =
-                ctx.buildMalloc(ty, innerTy.getTypeKind().getValue(), zero);
+            Value allocPtr;
+            if (innerTy.isNonEmptyList() && op.isReserved())
+                allocPtr = ctx.buildReservedMalloc(ty, /*words=*/2);
+            else if (op.isReserved())
+                return op.emitOpError(
+                    "reserved allocations must have a static size");
+            else if (innerTy.isNonEmptyList())
+                allocPtr = ctx.buildInlineMalloc(ty, kind, zero, /*words=*/2);
+            else
+                allocPtr = ctx.buildMalloc(ty, kind, zero);
             rewriter.replaceOp(op, allocPtr);
         }
 
         return success();
     }
+
+   private:
+    static Optional<unsigned> getStaticSizeInWords(OpaqueTermType innerTy,
+                                                   Value arity) {
+        if (!innerTy.isa<TupleType>() && !innerTy.isa<ClosureType>())
+            return llvm::None;
+
+        auto constOp =
+            dyn_cast_or_null<LLVM::ConstantOp>(arity.getDefiningOp());
+        if (!constOp) return llvm::None;
+        auto arityAttr = constOp.value().dyn_cast<IntegerAttr>();
+        if (!arityAttr) return llvm::None;
+
+        return arityAttr.getValue().getLimitedValue() + 1;
+    }
+};
+
+struct HeapReserveOpConversion : public EIROpConversion<HeapReserveOp> {
+    using EIROpConversion::EIROpConversion;
+
+    LogicalResult matchAndRewrite(
+        HeapReserveOp op, ArrayRef<Value> operands,
+        ConversionPatternRewriter &rewriter) const override {
+        auto ctx = getRewriteContext(op, rewriter);
+
+        auto i8PtrTy = ctx.targetInfo.getI8Type().getPointerTo();
+        auto usizeTy = ctx.getUsizeType();
+        auto voidTy = LLVMType::getVoidTy(ctx.context);
+        unsigned words = op.words();
+
+        Value heapTopPtr = ctx.getOrInsertGlobal(
+            "__lumen_heap_top", i8PtrTy, nullptr, LLVM::Linkage::External,
+            LLVM::ThreadLocalMode::LocalExec);
+        Value heapLimitPtr = ctx.getOrInsertGlobal(
+            "__lumen_heap_limit", i8PtrTy, nullptr, LLVM::Linkage::External,
+            LLVM::ThreadLocalMode::LocalExec);
+
+        // Check whether the buffer has room for all of the reserved words
+        Value top = llvm_load(heapTopPtr);
+        Value limit = llvm_load(heapLimitPtr);
+        unsigned sizeInBytes = words * (ctx.targetInfo.pointerSizeInBits / 8);
+        Value size = llvm_constant(usizeTy, ctx.getIntegerAttr(sizeInBytes));
+        Value newTop = llvm_gep(i8PtrTy, top, ArrayRef<Value>{size});
+        Value newTopInt = llvm_ptrtoint(usizeTy, newTop);
+        Value limitInt = llvm_ptrtoint(usizeTy, limit);
+        Value fits = llvm_icmp(LLVM::ICmpPredicate::ule, newTopInt, limitInt);
+
+        Block *current = rewriter.getInsertionBlock();
+        Block *cont =
+            rewriter.splitBlock(current, rewriter.getInsertionPoint());
+        Block *refill = new Block();
+        current->getParent()->getBlocks().insert(
+            std::next(Region::iterator(current)), refill);
+
+        rewriter.setInsertionPointToEnd(current);
+        llvm_condbr(fits, cont, ValueRange(), refill, ValueRange());
+
+        // The buffer is exhausted, ask the runtime for a new one large
+        // enough to hold the entire reservation
+        rewriter.setInsertionPointToEnd(refill);
+        StringRef symbolName("__lumen_builtin_heap.reserve");
+        auto callee = ctx.getOrInsertFunction(symbolName, voidTy, {usizeTy});
+        auto calleeSymbol =
+            FlatSymbolRefAttr::get(symbolName, callee->getContext());
+        Value wordsConst = llvm_constant(usizeTy, ctx.getIntegerAttr(words));
+        rewriter.create<mlir::CallOp>(op.getLoc(), calleeSymbol,
+                                      ArrayRef<Type>{},
+                                      ArrayRef<Value>{wordsConst});
+        llvm_br(ValueRange(), cont);
+
+        rewriter.setInsertionPointToStart(cont);
+        rewriter.eraseOp(op);
+        return success();
+    }
 };
 
 struct CastOpConversion : public EIROpConversion<CastOp> {
@@ -358,8 +455,9 @@ void populateMemoryOpConversionPatterns(OwningRewritePatternList &patterns,
                                         MLIRContext *context,
                                         EirTypeConverter &converter,
                                         TargetInfo &targetInfo) {
-    patterns.insert<MallocOpConversion, CastOpConversion,
-                    GetElementPtrOpConversion, LoadOpConversion>(
+    patterns.insert<MallocOpConversion, HeapReserveOpConversion,
+                    CastOpConversion, GetElementPtrOpConversion,
+                    LoadOpConversion>(
         context, converter, targetInfo);
 }
 
@@ -9,7 +9,9 @@
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Pass/PassRegistry.h"
 
+#include "lumen/EIR/Conversion/CoalesceAllocations.h"
 #include "lumen/EIR/Conversion/ConvertEIRToLLVM.h"
+#include "lumen/EIR/Conversion/PresizeBinaries.h"
 #include "lumen/EIR/IR/EIROps.h"
 #include "lumen/llvm/Target.h"
 #include "lumen/mlir/MLIR.h"
@@ -40,6 +42,7 @@ struct PassManagerOptions {
     bool printAfterPass;
     bool printModuleScopeAlways;
     bool printAfterOnlyOnChange;
+    uint32_t maxReductions;
 };
 }
 
@@ -85,30 +88,55 @@ extern "C" MLIRPassManagerRef MLIRCreatePassManager(
     // TODO: Hook driver into instrumentation
     // pm.addInstrumentation(...);
 
-    // Convert EIR to LLVM dialect
-    pm->addPass(::lumen::eir::createConvertEIRToLLVMPass(targetMachine));
-
-    // Canonicalize
-    pm->addNestedPass<::mlir::LLVM::LLVMFuncOp>(
-        mlir::createCanonicalizerPass());
-
-    // Add optimizations if enabled
+    // Optimize EIR before lowering it, while its calls, type checks and
+    // constants can still be reasoned about
     if (optLevel > CodeGenOptLevel::None) {
+        pm->addNestedPass<::lumen::eir::FuncOp>(
+            mlir::createCanonicalizerPass());
+
         // When optimizing for size, avoid aggressive inlining
-        if (sizeLevel == 0) {
-            // pm->addPass(mlir::createInlinerPass());
+        if (optLevel >= CodeGenOptLevel::Default && sizeLevel == 0) {
+            pm->addPass(mlir::createInlinerPass());
         }
 
-        // Canonicalize generated LLVM dialect, and perform optimizations
-        // OpPassManager &optPM = pm->nest<::mlir::LLVM::LLVMFuncOp>();
-        // optPM.addPass(mlir::createCanonicalizerPass());
+        OpPassManager &optPM = pm->nest<::lumen::eir::FuncOp>();
         // Sparse conditional constant propagation
-        // optPM.addPass(mlir::createSCCPPass());
-        // Common sub-expression elimination
-        // optPM.addPass(mlir::createCSEPass());
+        optPM.addPass(mlir::createSCCPPass());
+        // Common sub-expression elimination, which folds repeated type checks,
+        // casts and loads of the same term
+        optPM.addPass(mlir::createCSEPass());
+        optPM.addPass(mlir::createCanonicalizerPass());
+
         // Remove dead/unreachable symbols
-        // pm->addPass(mlir::createSymbolDCEPass());
+        pm->addPass(mlir::createSymbolDCEPass());
     }
 
+    // Reserve heap space for runs of constructors in a single check, and
+    // allocate binaries whose segments all have a static size up front
+    if (optLevel > CodeGenOptLevel::None) {
+        pm->addNestedPass<::lumen::eir::FuncOp>(
+            ::lumen::eir::createCoalesceAllocationsPass(targetMachine));
+        pm->addNestedPass<::lumen::eir::FuncOp>(
+            ::lumen::eir::createPresizeBinariesPass());
+    }
+
+    // Convert EIR to LLVM dialect
+    //
+    // Each function is converted in a nested module of its own, which allows
+    // the conversion to run on many functions in parallel when the context
+    // has multi-threading enabled. The results are then merged back into the
+    // parent module, and whatever remains there, i.e. declarations, is
+    // converted last.
+    pm->addPass(::lumen::eir::createIsolateFunctionsPass());
+    pm->addNestedPass<ModuleOp>(::lumen::eir::createConvertEIRToLLVMPass(
+        targetMachine, options->maxReductions));
+    pm->addPass(::lumen::eir::createMergeIsolatedFunctionsPass());
+    pm->addPass(::lumen::eir::createConvertEIRToLLVMPass(
+        targetMachine, options->maxReductions));
+
+    // Canonicalize
+    pm->addNestedPass<::mlir::LLVM::LLVMFuncOp>(
+        mlir::createCanonicalizerPass());
+
     return wrap(pm);
 }
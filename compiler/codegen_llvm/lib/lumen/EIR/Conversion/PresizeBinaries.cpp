@@ -0,0 +1,162 @@
+#include "lumen/EIR/Conversion/PresizeBinaries.h"
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/Interfaces/ControlFlowInterfaces.h"
+
+#include "lumen/EIR/IR/EIRAttributes.h"
+#include "lumen/EIR/IR/EIRDialect.h"
+#include "lumen/EIR/IR/EIROps.h"
+
+using ::llvm::dyn_cast;
+using ::llvm::dyn_cast_or_null;
+using ::llvm::Optional;
+using ::llvm::SmallVector;
+using ::mlir::Block;
+using ::mlir::BranchOpInterface;
+using ::mlir::DialectRegistry;
+using ::mlir::OpBuilder;
+using ::mlir::Operation;
+using ::mlir::OperationPass;
+using ::mlir::PassWrapper;
+using ::mlir::Value;
+
+namespace {
+
+using namespace ::lumen::eir;
+
+// The most segments we will follow in a single binary, anything larger is
+// left to the runtime's builder
+const unsigned MAX_SEGMENTS = 256;
+
+// This pass finds binary constructions in which the size of every segment is
+// known statically, i.e. an `eir.binary.start`, followed by a chain of
+// `eir.binary.push`, ending in an `eir.binary.finish`, with the binary under
+// construction passed directly from one to the next, possibly through
+// branches.
+//
+// Each op in the chain is given the total size of the binary in bytes, as
+// `binary_size`, and each push the offset in bytes of its segment, as
+// `binary_offset`. These are lowered to a single allocation of the finished
+// binary by `eir.binary.start`, with each segment written in place, and no
+// intermediate builder at all.
+struct PresizeBinariesPass
+    : public PassWrapper<PresizeBinariesPass, OperationPass<FuncOp>> {
+    void getDependentDialects(DialectRegistry &registry) const override {
+        registry.insert<mlir::StandardOpsDialect, mlir::LLVM::LLVMDialect,
+                        lumen::eir::eirDialect>();
+    }
+
+    void runOnOperation() override {
+        FuncOp op = getOperation();
+        if (op.isExternal()) return;
+
+        SmallVector<BinaryStartOp, 2> starts;
+        op.walk([&](BinaryStartOp start) { starts.push_back(start); });
+        for (BinaryStartOp start : starts) presize(start);
+    }
+
+   private:
+    void presize(BinaryStartOp start) {
+        SmallVector<std::pair<BinaryPushOp, uint64_t>, 8> segments;
+        uint64_t bits = 0;
+
+        Value bin = start.binRef();
+        Operation *user;
+        while ((user = getNextUser(bin))) {
+            auto push = dyn_cast<BinaryPushOp>(user);
+            if (!push) break;
+            if (push.bin() != bin || segments.size() == MAX_SEGMENTS) return;
+            auto segmentBits = getSegmentBits(push);
+            if (!segmentBits) return;
+            segments.push_back(std::make_pair(push, bits / 8));
+            bits += segmentBits.getValue();
+            bin = push.newBin();
+        }
+        auto finish = dyn_cast_or_null<BinaryFinishOp>(user);
+        if (!finish) return;
+
+        OpBuilder builder(start);
+        auto size = builder.getI64IntegerAttr(bits / 8);
+        start.setAttr("binary_size", size);
+        finish.setAttr("binary_size", size);
+        for (auto &segment : segments) {
+            BinaryPushOp push = segment.first;
+            push.setAttr("binary_size", size);
+            push.setAttr("binary_offset",
+                         builder.getI64IntegerAttr(segment.second));
+        }
+    }
+
+    // Returns the op which the binary under construction is given to next,
+    // following it through branches to blocks with a single predecessor, or
+    // null if it is used by anything else, or more than once
+    static Operation *getNextUser(Value bin) {
+        for (unsigned i = 0; i < MAX_SEGMENTS; ++i) {
+            if (!bin.hasOneUse()) return nullptr;
+            Operation *user = bin.getUses().begin()->getOwner();
+            auto branch = dyn_cast<BranchOpInterface>(user);
+            if (!branch) return user;
+
+            Value next;
+            for (unsigned s = 0; s < user->getNumSuccessors(); ++s) {
+                auto succOperands = branch.getSuccessorOperands(s);
+                if (!succOperands) return nullptr;
+                for (auto it : llvm::enumerate(*succOperands)) {
+                    if (it.value() != bin) continue;
+                    Block *succ = user->getSuccessor(s);
+                    if (next || !succ->getSinglePredecessor()) return nullptr;
+                    next = succ->getArgument(it.index());
+                }
+            }
+            if (!next) return nullptr;
+            bin = next;
+        }
+        return nullptr;
+    }
+
+    // Returns the size in bits of the segment pushed by `op`, if it is known
+    // statically, and is a whole number of bytes. Only integer, float and
+    // binary segments are considered, as the size of a utf segment depends
+    // on the character being pushed.
+    static Optional<uint64_t> getSegmentBits(BinaryPushOp op) {
+        Value size = op.size();
+        if (!size) return llvm::None;
+        auto intOp = dyn_cast_or_null<ConstantIntOp>(size.getDefiningOp());
+        if (!intOp) return llvm::None;
+        auto value = intOp.getValue().cast<APIntAttr>().getValue();
+        if (value.isNegative() || !value.isIntN(16)) return llvm::None;
+        auto unitAttr = op.getAttrOfType<mlir::IntegerAttr>("unit");
+        uint64_t unit = unitAttr ? unitAttr.getValue().getLimitedValue() : 1;
+        uint64_t bits = value.getLimitedValue() * unit;
+        if (bits % 8 != 0) return llvm::None;
+
+        auto pushType = op.getAttrOfType<mlir::IntegerAttr>("type")
+                            .getValue()
+                            .getLimitedValue();
+        switch (pushType) {
+        case BinarySpecifierType::Integer:
+        case BinarySpecifierType::Bytes:
+            return bits;
+        case BinarySpecifierType::Float:
+            if (bits == 32 || bits == 64) return bits;
+            return llvm::None;
+        default:
+            return llvm::None;
+        }
+    }
+};
+
+}  // namespace
+
+namespace lumen {
+namespace eir {
+std::unique_ptr<mlir::Pass> createPresizeBinariesPass() {
+    return std::make_unique<PresizeBinariesPass>();
+}
+}  // namespace eir
+}  // namespace lumen
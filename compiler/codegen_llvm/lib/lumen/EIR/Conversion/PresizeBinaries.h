@@ -0,0 +1,14 @@
+#ifndef LUMEN_COMPILER_DIALECT_EIR_CONVERSION_PRESIZEBINARIES_H_
+#define LUMEN_COMPILER_DIALECT_EIR_CONVERSION_PRESIZEBINARIES_H_
+
+#include "mlir/Pass/Pass.h"
+
+#include <memory>
+
+namespace lumen {
+namespace eir {
+std::unique_ptr<mlir::Pass> createPresizeBinariesPass();
+}  // namespace eir
+}  // namespace lumen
+
+#endif
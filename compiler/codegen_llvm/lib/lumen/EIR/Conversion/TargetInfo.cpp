@@ -128,6 +128,7 @@ TargetInfo::TargetInfo(llvm::TargetMachine *targetMachine, MLIRContext *ctx)
     impl->listMask = lumen_list_mask(&impl->encoding);
     impl->boxTag = lumen_box_tag(&impl->encoding);
     impl->literalTag = lumen_literal_tag(&impl->encoding);
+    impl->matchContextTag = lumen_match_context_tag(&impl->encoding);
     impl->immediateMask = lumen_immediate_mask(&impl->encoding);
     impl->headerMask = lumen_header_mask(&impl->encoding);
 
@@ -226,6 +227,9 @@ uint64_t TargetInfo::listTag() const { return impl->listTag; }
 uint64_t TargetInfo::listMask() const { return impl->listMask; }
 uint64_t TargetInfo::boxTag() const { return impl->boxTag; }
 uint64_t TargetInfo::literalTag() const { return impl->literalTag; }
+uint64_t TargetInfo::matchContextTag() const {
+    return impl->matchContextTag;
+}
 uint32_t TargetInfo::closureHeaderArity(uint32_t envLen) const {
     uint32_t wordSize;
     if (pointerSizeInBits == 64) {
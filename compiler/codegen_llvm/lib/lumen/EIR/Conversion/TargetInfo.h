@@ -53,6 +53,7 @@ struct TargetInfoImpl {
           listMask(other.listMask),
           boxTag(other.boxTag),
           literalTag(other.literalTag),
+          matchContextTag(other.matchContextTag),
           immediateMask(other.immediateMask),
           headerMask(other.headerMask),
           immediateBits(other.immediateBits) {}
@@ -79,6 +80,7 @@ struct TargetInfoImpl {
     uint64_t listMask;
     uint64_t boxTag;
     uint64_t literalTag;
+    uint64_t matchContextTag;
     MaskInfo immediateMask;
     MaskInfo headerMask;
     uint8_t immediateBits;
@@ -145,6 +147,7 @@ class TargetInfo {
     uint64_t listMask() const;
     uint64_t boxTag() const;
     uint64_t literalTag() const;
+    uint64_t matchContextTag() const;
     uint32_t closureHeaderArity(uint32_t envLen) const;
     MaskInfo &immediateMask() const;
     MaskInfo &headerMask() const;
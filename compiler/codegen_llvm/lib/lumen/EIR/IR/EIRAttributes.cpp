@@ -4,6 +4,7 @@
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
 #include "mlir/IR/Dialect.h"
 #include "mlir/IR/DialectImplementation.h"
 #include "mlir/IR/MLIRContext.h"
@@ -14,7 +15,11 @@
 using ::llvm::hash_combine;
 using ::mlir::AttributeStorage;
 using ::mlir::AttributeStorageAllocator;
+using ::mlir::BoolAttr;
 using ::mlir::DialectAsmPrinter;
+using ::mlir::FlatSymbolRefAttr;
+using ::mlir::FloatAttr;
+using ::mlir::IntegerAttr;
 
 using namespace lumen;
 using namespace lumen::eir;
@@ -388,3 +393,57 @@ SeqAttr SeqAttr::getChecked(Type type, ArrayRef<Attribute> value,
 }
 
 ArrayRef<Attribute> &SeqAttr::getValue() const { return getImpl()->value; }
+
+// Feeds a canonical encoding of a constant into `hasher`, each element is
+// prefixed with a tag for its kind, and terminated, so that distinct
+// constants never produce the same input
+static void hashConstant(llvm::SHA1 &hasher, Attribute attr) {
+    std::string buffer;
+    llvm::raw_string_ostream os(buffer);
+    if (auto seqAttr = attr.dyn_cast<SeqAttr>()) {
+        Type type = seqAttr.getType();
+        if (type.isa<TupleType>())
+            os << 't';
+        else if (type.isa<ConsType>())
+            os << 'l';
+        else if (type.isa<MapType>())
+            os << 'm';
+        else
+            os << 's';
+        os << seqAttr.size() << '[';
+        hasher.update(os.str());
+        for (auto element : seqAttr) hashConstant(hasher, element);
+        hasher.update("]");
+        return;
+    }
+
+    if (auto atomAttr = attr.dyn_cast<AtomAttr>()) {
+        os << 'a' << atomAttr.getValue().getLimitedValue();
+    } else if (auto boolAttr = attr.dyn_cast<BoolAttr>()) {
+        // Booleans are just the atoms 'false' and 'true'
+        os << 'a' << (boolAttr.getValue() ? 1 : 0);
+    } else if (auto intAttr = attr.dyn_cast<APIntAttr>()) {
+        os << 'i' << intAttr.getValueAsString();
+    } else if (auto intAttr = attr.dyn_cast<IntegerAttr>()) {
+        os << 'i' << intAttr.getValue().toString(10, /*signed=*/true);
+    } else if (auto floatAttr = attr.dyn_cast<APFloatAttr>()) {
+        os << 'f' << floatAttr.getValue().bitcastToAPInt().getLimitedValue();
+    } else if (auto floatAttr = attr.dyn_cast<FloatAttr>()) {
+        os << 'f' << floatAttr.getValue().bitcastToAPInt().getLimitedValue();
+    } else if (auto binAttr = attr.dyn_cast<BinaryAttr>()) {
+        os << 'b' << binAttr.getHeader().getLimitedValue() << ':'
+           << binAttr.getFlags().getLimitedValue() << ':' << binAttr.getHash();
+    } else if (auto symAttr = attr.dyn_cast<FlatSymbolRefAttr>()) {
+        os << '@' << symAttr.getValue();
+    } else {
+        attr.print(os);
+    }
+    os << ';';
+    hasher.update(os.str());
+}
+
+std::string SeqAttr::getHash() const {
+    llvm::SHA1 hasher;
+    hashConstant(hasher, *this);
+    return llvm::toHex(hasher.result(), true);
+}
@@ -139,6 +139,10 @@ class SeqAttr : public Attribute::AttrBase<SeqAttr, Attribute,
 
     ArrayRef<Attribute> &getValue() const;
 
+    /// Returns a SHA-1 hash of the type and contents of this sequence, such
+    /// that equal constants have the same hash regardless of where they occur
+    std::string getHash() const;
+
     /// Support range iteration.
     using iterator = ArrayRef<Attribute>::iterator;
     using reverse_iterator = ArrayRef<Attribute>::reverse_iterator;
@@ -11,6 +11,8 @@
 #include "lumen/EIR/IR/EIROps.h"
 #include "lumen/EIR/IR/EIRTypes.h"
 
+#include <climits>
+
 using namespace lumen::eir;
 
 using ::llvm::SmallString;
@@ -18,6 +20,85 @@ using ::mlir::Attribute;
 using ::mlir::DialectAsmParser;
 using ::mlir::DialectAsmPrinter;
 
+namespace {
+/// The maximum cost of a function which will be inlined into its callers,
+/// see `EIRInlinerInterface::getInlineCost`
+static const unsigned kInlineThreshold = 64;
+
+/// Calls are weighted more heavily than other operations, as each one is a
+/// potential yield point, and grows the caller by more than a single call
+/// instruction once lowered
+static const unsigned kCallInlineCost = 8;
+
+/// Defines how EIR functions are inlined into their callers
+struct EIRInlinerInterface : public mlir::DialectInlinerInterface {
+    using DialectInlinerInterface::DialectInlinerInterface;
+
+    /// Functions are inlined if they are not marked `noinline`, and are
+    /// cheap enough according to `getInlineCost`
+    bool isLegalToInline(mlir::Region *dest, mlir::Region *src,
+                         mlir::BlockAndValueMapping &) const final {
+        if (auto fn = llvm::dyn_cast_or_null<FuncOp>(src->getParentOp()))
+            if (fn.noinline()) return false;
+        return getInlineCost(src) <= kInlineThreshold;
+    }
+
+    /// All EIR operations can be inlined, the decision is made per-function
+    bool isLegalToInline(Operation *, mlir::Region *,
+                         mlir::BlockAndValueMapping &) const final {
+        return true;
+    }
+
+    /// Handle the terminator of a callee with a single block, by forwarding
+    /// the returned values to the users of the call
+    void handleTerminator(Operation *op,
+                          ArrayRef<Value> valuesToRepl) const final {
+        auto returnOp = llvm::cast<ReturnOp>(op);
+        assert(returnOp.getNumOperands() == valuesToRepl.size());
+        for (auto it : llvm::enumerate(returnOp.getOperands()))
+            valuesToRepl[it.index()].replaceAllUsesWith(it.value());
+    }
+
+    /// Handle the terminators of a callee with multiple blocks, by replacing
+    /// returns with branches to the block following the call
+    void handleTerminator(Operation *op, Block *newDest) const final {
+        auto returnOp = llvm::dyn_cast<ReturnOp>(op);
+        if (!returnOp) return;
+
+        mlir::OpBuilder builder(op);
+        builder.create<BranchOp>(op->getLoc(), newDest,
+                                 returnOp.getOperands());
+        op->erase();
+    }
+
+   private:
+    /// Returns the cost of inlining the given function body, or UINT_MAX if
+    /// it must not be inlined at all.
+    ///
+    /// Functions containing calls which must be tail calls, direct or
+    /// indirect, are never inlined, as once inlined, the call would no longer
+    /// be in tail position. Calls which are only hinted as tail calls (as
+    /// every call is) don't prevent inlining, the hint remains valid wherever
+    /// the call ends up.
+    static unsigned getInlineCost(mlir::Region *body) {
+        unsigned cost = 0;
+        auto result = body->walk([&](Operation *op) {
+            if (op->getAttr("musttail")) return mlir::WalkResult::interrupt();
+            if (llvm::isa<mlir::CallOpInterface>(op) ||
+                llvm::isa<CallIndirectOp>(op) ||
+                llvm::isa<InvokeIndirectOp>(op)) {
+                cost += kCallInlineCost;
+            } else if (!op->hasTrait<mlir::OpTrait::ConstantLike>()) {
+                cost += 1;
+            }
+            return mlir::WalkResult::advance();
+        });
+        if (result.wasInterrupted()) return UINT_MAX;
+        return cost;
+    }
+};
+}  // namespace
+
 /// Create an instance of the EIR dialect, owned by the context.
 ///
 /// This is where EIR types, operations, and attributes are registered.
@@ -37,6 +118,8 @@ void eirDialect::initialize() {
         RefType, PtrType, TraceRefType, ReceiveRefType>();
 
     addAttributes<AtomAttr, APIntAttr, APFloatAttr, BinaryAttr, SeqAttr>();
+
+    addInterfaces<EIRInlinerInterface>();
 }
 
 Operation *eirDialect::materializeConstant(mlir::OpBuilder &builder,
@@ -1,5 +1,6 @@
 #include "lumen/EIR/IR/EIROps.h"
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/SMLoc.h"
@@ -1265,6 +1266,178 @@ static LogicalResult verify(CastOp op) {
 // eir.match
 //===----------------------------------------------------------------------===//
 
+// Ensures the destination block argument types of a match branch agree with
+// the types of the base arguments passed to it
+static void propagateDestArgTypes(const MatchBranch &branch) {
+    auto dest = branch.getDest();
+    auto baseDestArgs = branch.getDestArgs();
+    for (unsigned i = 0; i < baseDestArgs.size(); i++) {
+        BlockArgument arg = dest->getArgument(i);
+        auto destArgTy = baseDestArgs[i].getType();
+        if (arg.getType() != destArgTy) arg.setType(destArgTy);
+    }
+}
+
+// Given a selector known to be a tuple of the given arity, extracts the tuple
+// elements as values and unconditionally branches to the branch destination,
+// with the elements as additional destArgs
+static void lowerTupleElements(OpBuilder &builder, const MatchBranch &branch,
+                               Value selector, unsigned arity) {
+    Location branchLoc = branch.getLoc();
+    auto dest = branch.getDest();
+    auto baseDestArgs = branch.getDestArgs();
+    auto numBaseDestArgs = baseDestArgs.size();
+
+    auto tupleType = builder.getType<eir::TupleType>(arity);
+    auto ptrTupleType = builder.getType<PtrType>(tupleType);
+    auto castOp = builder.create<CastOp>(branchLoc, selector, ptrTupleType);
+    auto tuplePtr = castOp.getResult();
+    unsigned ai = numBaseDestArgs > 0 ? numBaseDestArgs - 1 : 0;
+    SmallVector<Value, 2> destArgs({baseDestArgs.begin(), baseDestArgs.end()});
+    destArgs.reserve(arity);
+    for (unsigned i = 0; i < arity; i++) {
+        auto getElemOp =
+            builder.create<GetElementPtrOp>(branchLoc, tuplePtr, i + 1);
+        auto elemPtr = getElemOp.getResult();
+        auto elemLoadOp = builder.create<LoadOp>(branchLoc, elemPtr);
+        auto elemLoadResult = elemLoadOp.getResult();
+        dest->getArgument(ai++).setType(elemLoadResult.getType());
+        destArgs.push_back(elemLoadResult);
+    }
+    builder.create<BranchOp>(branchLoc, dest, destArgs);
+}
+
+// Lowers a run of two or more consecutive tuple patterns as a decision tree
+//
+// Rather than testing the type and arity of the selector once per pattern,
+// the selector is checked for being a tuple once, its arity is read from the
+// header once, and then dispatched on by comparing against each distinct
+// arity in the order the patterns appear. Since a tuple pattern matches any
+// tuple of its arity, a pattern which repeats an earlier arity is unreachable
+// and is dropped. LLVM folds the resulting compare chain into a switch.
+static void lowerTuplePatternRun(OpBuilder &builder, Region *region,
+                                 ArrayRef<MatchBranch> run, Value selectorArg,
+                                 Block *nextPatternBlock) {
+    assert(nextPatternBlock != nullptr &&
+           "last match block must end in unconditional branch");
+    Location runLoc = run.front().getLoc();
+    ArrayRef<Value> emptyArgs{};
+    ArrayRef<Value> withSelectorArgs{selectorArg};
+
+    // 1. Conditionally branch to the dispatch block if is_tuple, otherwise
+    // the next pattern
+    auto cip = builder.saveInsertionPoint();
+    Block *dispatch =
+        builder.createBlock(region, Region::iterator(nextPatternBlock));
+    builder.restoreInsertionPoint(cip);
+    auto anyTupleType = builder.getType<eir::TupleType>();
+    auto boxedTupleType = builder.getType<BoxType>(anyTupleType);
+    auto isTupleOp =
+        builder.create<IsTypeOp>(runLoc, selectorArg, boxedTupleType);
+    builder.create<CondBranchOp>(runLoc, isTupleOp.getResult(), dispatch,
+                                 emptyArgs, nextPatternBlock,
+                                 withSelectorArgs);
+
+    // 2. In the dispatch block, read the arity from the tuple header
+    builder.setInsertionPointToEnd(dispatch);
+    auto ptrTupleType = builder.getType<PtrType>(anyTupleType);
+    auto castOp = builder.create<CastOp>(runLoc, selectorArg, ptrTupleType);
+    auto arityOp = builder.create<TupleArityOp>(runLoc, castOp.getResult());
+    Value arity = arityOp.getResult();
+
+    // 3. For each distinct arity, branch to a block which extracts the
+    // elements for that pattern, otherwise try the next arity; if no arity
+    // matches, fall through to the next pattern
+    SmallVector<unsigned, 4> seen;
+    for (auto &b : run) {
+        Location branchLoc = b.getLoc();
+        auto *pattern = b.getPatternTypeOrNull<TuplePattern>();
+        unsigned expectedArity = pattern->getArity();
+        if (llvm::is_contained(seen, expectedArity)) continue;
+        seen.push_back(expectedArity);
+
+        Block *current = builder.getInsertionBlock();
+        Block *next =
+            builder.createBlock(region, Region::iterator(nextPatternBlock));
+        Block *matched = builder.createBlock(region, Region::iterator(next));
+        builder.setInsertionPointToEnd(current);
+        auto expected = builder.create<mlir::ConstantIntOp>(
+            branchLoc, expectedArity, builder.getI32Type());
+        auto isArity = builder.create<mlir::CmpIOp>(
+            branchLoc, mlir::CmpIPredicate::eq, arity, expected);
+        builder.create<CondBranchOp>(branchLoc, isArity.getResult(), matched,
+                                     emptyArgs, next, emptyArgs);
+
+        builder.setInsertionPointToEnd(matched);
+        lowerTupleElements(builder, b, selectorArg, expectedArity);
+
+        builder.setInsertionPointToEnd(next);
+    }
+    builder.create<BranchOp>(runLoc, nextPatternBlock, withSelectorArgs);
+}
+
+// Returns true if the branch compares the selector against a constant atom,
+// fixnum or nil. Such constants are immediates, so their equality tests reduce
+// to comparisons of the raw term word.
+static bool isImmediateValuePattern(const MatchBranch &branch) {
+    if (branch.getPatternType() != MatchPatternType::Value) return false;
+    auto *pattern = branch.getPatternTypeOrNull<ValuePattern>();
+    Operation *definition = pattern->getValue().getDefiningOp();
+    if (!definition) return false;
+    if (auto atomOp = dyn_cast<ConstantAtomOp>(definition))
+        return !atomOp.getType().isa<BooleanType>();
+    return isa<ConstantIntOp>(definition) || isa<ConstantNilOp>(definition);
+}
+
+// Returns true if the two adjacent branches can be lowered as part of the
+// same decision tree
+static bool canLowerAsRun(const MatchBranch &lhs, const MatchBranch &rhs) {
+    if (lhs.getPatternType() == MatchPatternType::Tuple)
+        return rhs.getPatternType() == MatchPatternType::Tuple;
+    return isImmediateValuePattern(lhs) && isImmediateValuePattern(rhs);
+}
+
+// Lowers a run of two or more consecutive value patterns against immediate
+// constants
+//
+// All of the tests are made against the same selector value in a chain of
+// blocks which carry no arguments of their own, and each test is a strict
+// equality with an immediate, which is lowered to a comparison of the raw
+// term word. LLVM folds the resulting compare chain into a single switch. A
+// constant which repeats an earlier one can never match and is dropped.
+static void lowerValuePatternRun(OpBuilder &builder, Region *region,
+                                 ArrayRef<MatchBranch> run, Value selectorArg,
+                                 Block *nextPatternBlock) {
+    assert(nextPatternBlock != nullptr &&
+           "last match block must end in unconditional branch");
+    ArrayRef<Value> emptyArgs{};
+
+    SmallVector<Attribute, 4> seen;
+    for (auto &b : run) {
+        Location branchLoc = b.getLoc();
+        auto *pattern = b.getPatternTypeOrNull<ValuePattern>();
+        auto expected = pattern->getValue();
+        Attribute expectedAttr;
+        if (matchPattern(expected, mlir::m_Constant(&expectedAttr))) {
+            if (llvm::is_contained(seen, expectedAttr)) continue;
+            seen.push_back(expectedAttr);
+        }
+
+        Block *current = builder.getInsertionBlock();
+        Block *next =
+            builder.createBlock(region, Region::iterator(nextPatternBlock));
+        builder.setInsertionPointToEnd(current);
+        auto isEq = builder.create<CmpEqOp>(branchLoc, selectorArg, expected,
+                                            /*strict=*/true);
+        builder.create<CondBranchOp>(branchLoc, isEq.getResult(), b.getDest(),
+                                     b.getDestArgs(), next, emptyArgs);
+        builder.setInsertionPointToEnd(next);
+    }
+    ArrayRef<Value> withSelectorArgs{selectorArg};
+    builder.create<BranchOp>(run.back().getLoc(), nextPatternBlock,
+                             withSelectorArgs);
+}
+
 LogicalResult lowerPatternMatch(OpBuilder &builder, Location loc,
                                 Value selector,
                                 ArrayRef<MatchBranch> branches) {
@@ -1279,24 +1452,34 @@ LogicalResult lowerPatternMatch(OpBuilder &builder, Location loc,
     // Save our insertion point in the current block
     auto startIp = builder.saveInsertionPoint();
 
+    // Consecutive tuple patterns, and consecutive value patterns against
+    // immediates, are lowered together as a single decision tree, so find the
+    // end of each such run. For every match arm, this holds the index of the
+    // next arm which needs a block of its own.
+    SmallVector<unsigned, 3> nextArm(numBranches);
+    for (unsigned i = numBranches; i > 0; i--) {
+        unsigned j = i - 1;
+        nextArm[j] = i;
+        if (i < numBranches && canLowerAsRun(branches[j], branches[i]))
+            nextArm[j] = nextArm[i];
+    }
+
     // Create blocks for all match arms
     bool needsFallbackBranch = true;
-    SmallVector<Block *, 3> blocks;
-    // The first match arm is evaluated in the current block, so we
-    // handle it specially
-    blocks.reserve(numBranches);
-    blocks.push_back(currentBlock);
-    if (branches[0].isCatchAll()) {
-        needsFallbackBranch = false;
-    }
-    // All other match arms need blocks for the evaluation of their patterns
-    for (auto &branch : branches.take_back(numBranches - 1)) {
+    SmallVector<Block *, 3> blocks(numBranches, nullptr);
+    for (auto &branch : branches) {
         if (branch.isCatchAll()) {
             needsFallbackBranch = false;
         }
+    }
+    // The first match arm is evaluated in the current block, so we
+    // handle it specially; all other match arms which begin a new
+    // test need blocks for the evaluation of their patterns
+    blocks[0] = currentBlock;
+    for (unsigned i = 0; nextArm[i] < numBranches; i = nextArm[i]) {
         Block *block = builder.createBlock(region);
         block->addArgument(selectorType);
-        blocks.push_back(block);
+        blocks[nextArm[i]] = block;
     }
 
     // Create fallback block, if needed, after all other match blocks, so
@@ -1327,10 +1510,10 @@ LogicalResult lowerPatternMatch(OpBuilder &builder, Location loc,
     // appropriate conditional branching instruction to either jump
     // to the success block, or to the next branches' block (or in
     // the case of the last branch, the 'failed' block)
-    for (unsigned i = 0; i < numBranches; i++) {
+    for (unsigned i = 0; i < numBranches; i = nextArm[i]) {
         auto &b = branches[i];
         Location branchLoc = b.getLoc();
-        bool isLast = i == numBranches - 1;
+        bool isLast = nextArm[i] == numBranches;
         Block *block = blocks[i];
 
         // Set our insertion point to the end of the pattern block
@@ -1353,22 +1536,30 @@ LogicalResult lowerPatternMatch(OpBuilder &builder, Location loc,
         // an unreachable op
         Block *nextPatternBlock = nullptr;
         if (!isLast) {
-            nextPatternBlock = blocks[i + 1];
+            nextPatternBlock = blocks[nextArm[i]];
         } else if (needsFallbackBranch) {
             nextPatternBlock = failed;
         }
 
+        // A run of tuple or immediate value patterns is lowered as a unit
+        if (nextArm[i] - i > 1) {
+            auto run = branches.slice(i, nextArm[i] - i);
+            for (auto &rb : run) propagateDestArgTypes(rb);
+            if (b.getPatternType() == MatchPatternType::Tuple)
+                lowerTuplePatternRun(builder, region, run, selectorArg,
+                                     nextPatternBlock);
+            else
+                lowerValuePatternRun(builder, region, run, selectorArg,
+                                     nextPatternBlock);
+            continue;
+        }
+
         auto dest = b.getDest();
         auto baseDestArgs = b.getDestArgs();
         auto numBaseDestArgs = baseDestArgs.size();
 
         // Ensure the destination block argument types are propagated
-        for (unsigned i = 0; i < baseDestArgs.size(); i++) {
-            BlockArgument arg = dest->getArgument(i);
-            auto destArg = baseDestArgs[i];
-            auto destArgTy = destArg.getType();
-            if (arg.getType() != destArgTy) arg.setType(destArgTy);
-        }
+        propagateDestArgTypes(b);
 
         switch (b.getPatternType()) {
         case MatchPatternType::Any: {
@@ -1442,41 +1633,21 @@ LogicalResult lowerPatternMatch(OpBuilder &builder, Location loc,
             auto ifOp = builder.create<CondBranchOp>(
                 branchLoc, isTupleCond, split, emptyArgs, nextPatternBlock,
                 withSelectorArgs);
-            // 2. In the split, extract the tuple elements as values
+            // 2. In the split, extract the tuple elements as values, and
+            // unconditionally branch to the destination with them
             builder.setInsertionPointToEnd(split);
-            auto ptrTupleType = builder.getType<PtrType>(tupleType);
-            auto castOp =
-                builder.create<CastOp>(branchLoc, selectorArg, ptrTupleType);
-            auto tuplePtr = castOp.getResult();
-            unsigned ai = numBaseDestArgs > 0 ? numBaseDestArgs - 1 : 0;
-            SmallVector<Value, 2> destArgs(
-                {baseDestArgs.begin(), baseDestArgs.end()});
-            destArgs.reserve(arity);
-            for (int64_t i = 0; i < arity; i++) {
-                auto getElemOp =
-                    builder.create<GetElementPtrOp>(branchLoc, tuplePtr, i + 1);
-                auto elemPtr = getElemOp.getResult();
-                auto elemLoadOp = builder.create<LoadOp>(branchLoc, elemPtr);
-                auto elemLoadResult = elemLoadOp.getResult();
-                dest->getArgument(ai++).setType(elemLoadResult.getType());
-                destArgs.push_back(elemLoadResult);
-            }
-            // 3. Unconditionally branch to the destination, with the tuple
-            // elements as additional destArgs
-            builder.create<BranchOp>(branchLoc, dest, destArgs);
+            lowerTupleElements(builder, b, selectorArg, arity);
             break;
         }
 
         case MatchPatternType::MapItem: {
             assert(nextPatternBlock != nullptr &&
                    "last match block must end in unconditional branch");
-            // 1. Split block twice, and conditionally branch to the first split
-            // if is_map, otherwise the next pattern
+            // 1. Split block, and conditionally branch to the split if is_map,
+            // otherwise the next pattern
             auto cip = builder.saveInsertionPoint();
-            Block *split2 =
-                builder.createBlock(region, Region::iterator(nextPatternBlock));
             Block *split =
-                builder.createBlock(region, Region::iterator(split2));
+                builder.createBlock(region, Region::iterator(nextPatternBlock));
             builder.restoreInsertionPoint(cip);
             auto *pattern = b.getPatternTypeOrNull<MapPattern>();
             auto key = pattern->getKey();
@@ -1487,31 +1658,21 @@ LogicalResult lowerPatternMatch(OpBuilder &builder, Location loc,
             auto ifOp = builder.create<CondBranchOp>(
                 branchLoc, isMapCond, split, emptyArgs, nextPatternBlock,
                 withSelectorArgs);
-            // 2. In the split, call runtime function `is_map_key` to confirm
-            // existence of the key in the map,
-            //    then conditionally branch to the second split if successful,
-            //    otherwise the next pattern
+            // 2. In the split, look up the key in the map, then conditionally
+            // branch to the destination if found, with the key's value as an
+            // additional destArg, otherwise the next pattern
             builder.setInsertionPointToEnd(split);
-            auto hasKeyOp =
-                builder.create<MapContainsKeyOp>(branchLoc, selectorArg, key);
-            auto hasKeyCond = hasKeyOp.getResult();
-            builder.create<CondBranchOp>(branchLoc, hasKeyCond, split2,
-                                         emptyArgs, nextPatternBlock,
-                                         withSelectorArgs);
-            // 3. In the second split, call runtime function `map_get` to obtain
-            // the value for the key
-            builder.setInsertionPointToEnd(split2);
-            auto mapGetOp =
-                builder.create<MapGetKeyOp>(branchLoc, selectorArg, key);
-            auto valueTerm = mapGetOp.getResult();
+            auto findOp =
+                builder.create<MapFindKeyOp>(branchLoc, selectorArg, key);
+            auto valueTerm = findOp.value();
+            auto foundCond = findOp.found();
             unsigned i = numBaseDestArgs > 0 ? numBaseDestArgs - 1 : 0;
             dest->getArgument(i).setType(valueTerm.getType());
-            // 4. Unconditionally branch to the destination, with the key's
-            // value as an additional destArg
             SmallVector<Value, 2> destArgs(baseDestArgs.begin(),
                                            baseDestArgs.end());
             destArgs.push_back(valueTerm);
-            builder.create<BranchOp>(branchLoc, dest, destArgs);
+            builder.create<CondBranchOp>(branchLoc, foundCond, dest, destArgs,
+                                         nextPatternBlock, withSelectorArgs);
             break;
         }
 
@@ -2469,6 +2630,16 @@ Optional<MutableOperandRange> InvokeOp::getMutableSuccessorOperands(
     return index == okIndex ? llvm::None : Optional(errDestOperandsMutable());
 }
 
+//===----------------------------------------------------------------------===//
+// eir.invoke.indirect
+//===----------------------------------------------------------------------===//
+
+Optional<MutableOperandRange> InvokeIndirectOp::getMutableSuccessorOperands(
+    unsigned index) {
+    assert(index < getNumSuccessors() && "invalid successor index");
+    return index == okIndex ? llvm::None : Optional(errDestOperandsMutable());
+}
+
 //===----------------------------------------------------------------------===//
 // eir.yield.check
 //===----------------------------------------------------------------------===//
@@ -2669,6 +2840,41 @@ struct CanonicalizeMapMutation : public OpRewritePattern<OpType> {
     }
 };
 
+struct CanonicalizeMapUpdateMany : public OpRewritePattern<MapUpdateManyOp> {
+    using OpRewritePattern<MapUpdateManyOp>::OpRewritePattern;
+
+    LogicalResult matchAndRewrite(MapUpdateManyOp op,
+                                  PatternRewriter &rewriter) const override {
+        if (op.use_empty()) {
+            rewriter.eraseOp(op);
+            return success();
+        }
+
+        bool changed = false;
+        Value map = op.map();
+        Value m = castToTermEquivalent(rewriter, map);
+        if (m != map) {
+            auto mapOperand = op.mapMutable();
+            mapOperand.assign(m);
+            changed = true;
+        }
+
+        // The slice is relative to the start of the args, which follow the map
+        auto argsOperandsMut = op.argsMutable();
+        unsigned index = 0;
+        for (auto arg : op.args()) {
+            Value a = castToTermEquivalent(rewriter, arg);
+            if (a != arg) {
+                argsOperandsMut.slice(index, 1).assign(a);
+                changed = true;
+            }
+            index++;
+        }
+
+        return success(changed);
+    }
+};
+
 template <typename OpType>
 struct CanonicalizeMapKeyOp : public OpRewritePattern<OpType> {
     using OpRewritePattern<OpType>::OpRewritePattern;
@@ -2714,6 +2920,11 @@ void MapUpdateOp::getCanonicalizationPatterns(OwningRewritePatternList &results,
     results.insert<CanonicalizeMapMutation<MapUpdateOp>>(context);
 }
 
+void MapUpdateManyOp::getCanonicalizationPatterns(
+    OwningRewritePatternList &results, MLIRContext *context) {
+    results.insert<CanonicalizeMapUpdateMany>(context);
+}
+
 void MapContainsKeyOp::getCanonicalizationPatterns(
     OwningRewritePatternList &results, MLIRContext *context) {
     results.insert<CanonicalizeMapKeyOp<MapContainsKeyOp>>(context);
@@ -2724,6 +2935,11 @@ void MapGetKeyOp::getCanonicalizationPatterns(OwningRewritePatternList &results,
     results.insert<CanonicalizeMapKeyOp<MapGetKeyOp>>(context);
 }
 
+void MapFindKeyOp::getCanonicalizationPatterns(
+    OwningRewritePatternList &results, MLIRContext *context) {
+    results.insert<CanonicalizeMapKeyOp<MapFindKeyOp>>(context);
+}
+
 //===----------------------------------------------------------------------===//
 // eir.binary.push
 //===----------------------------------------------------------------------===//
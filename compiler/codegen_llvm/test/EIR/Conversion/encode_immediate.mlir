@@ -0,0 +1,37 @@
+// Fixnum results on the fast arithmetic path must be encoded inline, for all
+// supported term encodings, without calling into the runtime.
+//
+// RUN: out=$(mktemp -d) && lumen compile --target=x86_64-apple-darwin --emit=llvm-ir --output-dir=$out %s && cat $out/*.ll | LumenFileCheck %s --check-prefixes=CHECK,NANBOX
+// RUN: out=$(mktemp -d) && lumen compile --target=aarch64-apple-darwin --emit=llvm-ir --output-dir=$out %s && cat $out/*.ll | LumenFileCheck %s --check-prefixes=CHECK,ARCH64
+// RUN: out=$(mktemp -d) && lumen compile --target=wasm32-unknown-unknown --emit=llvm-ir --output-dir=$out %s && cat $out/*.ll | LumenFileCheck %s --check-prefixes=CHECK,WASM32
+
+module @encode_immediate {
+  // CHECK-LABEL: @"encode_immediate:add/2"
+  // NANBOX: with.overflow{{.*}}i47
+  // ARCH64: with.overflow{{.*}}i60
+  // WASM32: with.overflow{{.*}}i28
+  // CHECK-NOT: __lumen_builtin_encode_immediate
+  // NANBOX: [[EXT:%[0-9]+]] = sext i47 {{%[0-9]+}} to i64
+  // NANBOX: [[PAYLOAD:%[0-9]+]] = and i64 [[EXT]], 140737488355327
+  // NANBOX: or i64 [[PAYLOAD]], 140737488355328
+  // ARCH64: [[EXT:%[0-9]+]] = sext i60 {{%[0-9]+}} to i64
+  // ARCH64: [[PAYLOAD:%[0-9]+]] = shl i64 [[EXT]], 3
+  // ARCH64: or i64 [[PAYLOAD]], 4
+  // WASM32: [[EXT:%[0-9]+]] = sext i28 {{%[0-9]+}} to i32
+  // WASM32: [[PAYLOAD:%[0-9]+]] = shl i32 [[EXT]], 3
+  // WASM32: or i32 [[PAYLOAD]], 4
+  // CHECK-NOT: __lumen_builtin_encode_immediate
+  // CHECK: }
+  eir.func @"encode_immediate:add/2"(%a: !eir.fixnum, %b: !eir.fixnum) -> !eir.fixnum {
+    %0 = eir.math.add(%a, %b) : (!eir.fixnum, !eir.fixnum) -> !eir.fixnum
+    eir.return %0 : !eir.fixnum
+  }
+
+  // CHECK-LABEL: @"encode_immediate:sub/2"
+  // CHECK-NOT: __lumen_builtin_encode_immediate
+  // CHECK: }
+  eir.func @"encode_immediate:sub/2"(%a: !eir.fixnum, %b: !eir.fixnum) -> !eir.fixnum {
+    %0 = eir.math.sub(%a, %b) : (!eir.fixnum, !eir.fixnum) -> !eir.fixnum
+    eir.return %0 : !eir.fixnum
+  }
+}
@@ -0,0 +1,23 @@
+// Functions whose body ends in a call which must be a tail call, direct or
+// indirect, are never inlined, as the call would no longer be in tail
+// position in the caller.
+//
+// RUN: out=$(mktemp -d) && lumen compile --target=x86_64-apple-darwin --opt-level=2 --emit=llvm-ir --output-dir=$out %s && cat $out/*.ll | LumenFileCheck %s
+
+module @inline_musttail {
+  // CHECK-LABEL: @"inline_musttail:apply/2"
+  // CHECK: musttail call {{.*}}
+  // CHECK-NEXT: ret
+  eir.func @"inline_musttail:apply/2"(%callee: !eir.ptr<i8>, %x: !eir.term) -> !eir.term {
+    %0 = eir.call.indirect %callee(%x) {musttail} : !eir.ptr<i8>, (!eir.term) -> !eir.term
+    eir.return %0 : !eir.term
+  }
+
+  // CHECK-LABEL: @"inline_musttail:caller/2"
+  // CHECK: call {{.*}}@"inline_musttail:apply/2"
+  // CHECK: }
+  eir.func @"inline_musttail:caller/2"(%callee: !eir.ptr<i8>, %x: !eir.term) -> !eir.term {
+    %0 = eir.call @"inline_musttail:apply/2"(%callee, %x) : (!eir.ptr<i8>, !eir.term) -> !eir.term
+    eir.return %0 : !eir.term
+  }
+}
@@ -0,0 +1,31 @@
+// List type checks must compare the list tag inline, and on nanboxed targets
+// must also reject floats. A float whose encoded bits are 0x0009800000000000
+// has 0b0011 in bits 47-50, the list tag, so the check has to mask all of
+// the bits above the pointer rather than just the tag bits.
+//
+// RUN: out=$(mktemp -d) && lumen compile --target=x86_64-apple-darwin --emit=llvm-ir --output-dir=$out %s && cat $out/*.ll | LumenFileCheck %s --check-prefixes=CHECK,NANBOX
+// RUN: out=$(mktemp -d) && lumen compile --target=aarch64-apple-darwin --emit=llvm-ir --output-dir=$out %s && cat $out/*.ll | LumenFileCheck %s --check-prefixes=CHECK,ARCH64
+
+module @is_list {
+  // CHECK-LABEL: @"is_list:is_list/1"
+  // CHECK-NOT: __lumen_builtin_is_type
+  // NANBOX: [[MASKED:%[0-9]+]] = and i64 {{%[0-9]+}}, -140737488355328
+  // NANBOX: icmp eq i64 [[MASKED]], 422212465065984
+  // ARCH64: [[MASKED:%[0-9]+]] = and i64 {{%[0-9]+}}, 7
+  // ARCH64: icmp eq i64 [[MASKED]], 2
+  // CHECK: }
+  eir.func @"is_list:is_list/1"(%x: !eir.term) -> i1 {
+    %0 = eir.typeof %x is !eir.list : (!eir.term) -> i1
+    eir.return %0 : i1
+  }
+
+  // CHECK-LABEL: @"is_list:is_cons/1"
+  // CHECK-NOT: __lumen_builtin_is_boxed_type
+  // NANBOX: [[MASKED:%[0-9]+]] = and i64 {{%[0-9]+}}, -140737488355328
+  // NANBOX: icmp eq i64 [[MASKED]], 422212465065984
+  // CHECK: }
+  eir.func @"is_list:is_cons/1"(%x: !eir.term) -> i1 {
+    %0 = eir.typeof %x is !eir.box<!eir.cons> : (!eir.term) -> i1
+    eir.return %0 : i1
+  }
+}
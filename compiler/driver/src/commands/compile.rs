@@ -1,10 +1,11 @@
+use std::fs;
 use std::ops::Deref;
 use std::path::PathBuf;
 use std::sync::Arc;
 use std::thread;
 use std::time::Instant;
 
-use anyhow::anyhow;
+use anyhow::{anyhow, Context};
 
 use clap::ArgMatches;
 
@@ -12,14 +13,15 @@ use log::debug;
 
 use liblumen_codegen as codegen;
 use liblumen_codegen::linker::{self, LinkerInfo};
-use liblumen_codegen::meta::{CodegenResults, ProjectInfo};
+use liblumen_codegen::meta::{CodegenResults, CompiledModule, ProjectInfo};
+use liblumen_llvm::lto::ThinLTOLink;
 use liblumen_session::{CodegenOptions, DebuggingOptions, Options};
 use liblumen_util::diagnostics::{CodeMap, Emitter};
 use liblumen_util::time::HumanDuration;
 
 use crate::commands::*;
 use crate::compiler::prelude::{Compiler as CompilerQueryGroup, *};
-use crate::compiler::Compiler;
+use crate::compiler::{codegen_thin_lto_module, Compiler};
 use crate::task;
 
 const NUM_GENERATED_MODULES: usize = 3;
@@ -88,15 +90,28 @@ pub fn handle_command<'a>(
     debug!("awaiting results from workers ({} units)", num_inputs);
 
     let diagnostics = db.diagnostics();
-    for task in tasks.drain(..) {
+    let mut compiled_modules = Vec::with_capacity(num_inputs);
+    for (input, task) in inputs.iter().cloned().zip(tasks.drain(..)) {
         if let Ok(compiled) = task::join(task).unwrap() {
-            codegen_results.modules.push(compiled);
+            compiled_modules.push((input, compiled));
         }
     }
 
     // Do not proceed to linking if there were compilation errors
     diagnostics.abort_if_errors();
 
+    // With ThinLTO, the modules have only been prepared for the link so far,
+    // they are compiled to objects once it has been performed
+    if options.lto().is_thin() {
+        debug!("performing thinlto link ({} units)", compiled_modules.len());
+        let modules = thin_lto(&db, compiled_modules)?;
+        codegen_results.modules.extend(modules);
+    } else {
+        codegen_results
+            .modules
+            .extend(compiled_modules.drain(..).map(|(_, compiled)| compiled));
+    }
+
     // Generate LLVM module containing atom table data
     //
     // NOTE: This does not go through the query system, since atoms
@@ -144,3 +159,57 @@ pub fn handle_command<'a>(
     );
     Ok(())
 }
+
+/// Performs the ThinLTO link of the given modules, then runs the ThinLTO backend
+/// for each of them on the worker pool, in parallel
+fn thin_lto(
+    db: &Compiler,
+    compiled_modules: Vec<(InternedInput, Arc<CompiledModule>)>,
+) -> anyhow::Result<Vec<Arc<CompiledModule>>> {
+    let mut buffers = Vec::with_capacity(compiled_modules.len());
+    for (_, compiled) in compiled_modules.iter() {
+        let path = compiled
+            .bytecode()
+            .expect("expected thinlto bitcode to have been emitted");
+        let buffer = fs::read(path)
+            .with_context(|| format!("unable to read thinlto bitcode ({})", path.display()))?;
+        buffers.push((compiled.name().to_string(), buffer));
+    }
+
+    let link = Arc::new(ThinLTOLink::new(buffers)?);
+
+    let tasks = compiled_modules
+        .iter()
+        .enumerate()
+        .map(|(index, (input, _))| {
+            let input = *input;
+            let link = link.clone();
+            let snapshot = db.snapshot();
+            task::spawn(async move {
+                let result = codegen_thin_lto_module(&*snapshot, input, &link, index);
+                if result.is_err() {
+                    let diagnostics = snapshot.diagnostics();
+                    let input_info = snapshot.lookup_intern_input(input);
+                    diagnostics.failed("Failed", format!("{}", input_info.source_name()));
+                }
+                result
+            })
+        })
+        .collect::<Vec<_>>();
+
+    debug!(
+        "awaiting results from thinlto backends ({} units)",
+        tasks.len()
+    );
+
+    let mut modules = Vec::with_capacity(tasks.len());
+    for task in tasks {
+        if let Ok(compiled) = task::join(task).unwrap() {
+            modules.push(compiled);
+        }
+    }
+
+    db.diagnostics().abort_if_errors();
+
+    Ok(modules)
+}
@@ -24,6 +24,8 @@ use crate::parser::{Parser, ParserStorage};
 
 use self::query_groups::{CompilerExt, CompilerStorage};
 
+pub(crate) use self::queries::codegen_thin_lto_module;
+
 pub(crate) mod prelude {
     pub use super::query_groups::{Compiler, CompilerExt};
     pub use crate::diagnostics::*;
@@ -1,4 +1,6 @@
+use std::io::Write;
 use std::ops::Deref;
+use std::path::PathBuf;
 use std::sync::Arc;
 use std::thread::{self, ThreadId};
 
@@ -8,9 +10,11 @@ use log::debug;
 
 use liblumen_codegen as codegen;
 use liblumen_codegen::meta::CompiledModule;
+use liblumen_llvm::lto::{ThinBuffer, ThinLTOLink};
+use liblumen_llvm::passes::{OptStage, PassBuilderOptLevel, PassManager};
 use liblumen_llvm::{self as llvm, target::TargetMachineConfig};
 use liblumen_mlir as mlir;
-use liblumen_session::{Input, InputType, OutputType};
+use liblumen_session::{Input, InputType, Options, OutputType};
 
 use super::prelude::*;
 
@@ -234,9 +238,6 @@ pub(super) fn get_llvm_module<C>(
 where
     C: Compiler,
 {
-    use liblumen_llvm::passes::{PassBuilderOptLevel, PassManager};
-    use liblumen_session::Sanitizer;
-
     let options = db.options();
     let context = db.mlir_context(thread_id);
     let mlir_module = db.get_llvm_dialect_module(thread_id, input)?;
@@ -258,35 +259,35 @@ where
     let mut module = lower_result.unwrap();
 
     // Run optimizations
-    let mut pass_manager = PassManager::new();
-    pass_manager.verify(options.debugging_opts.verify_llvm_ir);
-    pass_manager.debug(options.debug_assertions);
-    let (speed, size) = llvm::enums::to_llvm_opt_settings(options.opt_level);
-    pass_manager.optimize(PassBuilderOptLevel::from_codegen_opts(speed, size));
-    if let Some(sanitizer) = options.debugging_opts.sanitizer {
-        match sanitizer {
-            Sanitizer::Memory => pass_manager.sanitize_memory(/* track_origins */ 0),
-            Sanitizer::Thread => pass_manager.sanitize_thread(),
-            Sanitizer::Address => pass_manager.sanitize_address(),
-            _ => (),
-        }
-    }
+    //
+    // With ThinLTO, this only prepares the module for the link, the rest of
+    // the optimizations happen in `codegen_thin_lto_module`
+    let stage = if options.lto().is_thin() {
+        OptStage::PreLinkThinLTO
+    } else {
+        OptStage::PreLinkNoLTO
+    };
+    let pass_manager = build_pass_manager(&options, stage);
     let target_machine = db.get_target_machine(thread_id);
     db.to_query_result(pass_manager.run(&mut module, &target_machine))?;
 
-    // Emit LLVM IR
-    db.maybe_emit_file_with_opts(&options, input, &module)?;
-
-    // Emit LLVM bitcode
-    db.maybe_emit_file_with_callback_and_opts(
-        &options,
-        input,
-        OutputType::LLVMBitcode,
-        |outfile| {
-            debug!("emitting llvm bitcode for {:?}", input);
-            module.emit_bc(outfile)
-        },
-    )?;
+    // With ThinLTO, the IR and bitcode are emitted once the module is fully
+    // optimized, see `codegen_thin_lto_module`
+    if !options.lto().is_thin() {
+        // Emit LLVM IR
+        db.maybe_emit_file_with_opts(&options, input, &module)?;
+
+        // Emit LLVM bitcode
+        db.maybe_emit_file_with_callback_and_opts(
+            &options,
+            input,
+            OutputType::LLVMBitcode,
+            |outfile| {
+                debug!("emitting llvm bitcode for {:?}", input);
+                module.emit_bc(outfile)
+            },
+        )?;
+    }
 
     Ok(Arc::new(module))
 }
@@ -314,6 +315,87 @@ where
     // request for a module if the query occurs on the same thread
     let module = db.get_llvm_module(thread_id, input)?;
 
+    let compiled = if options.lto().is_thin() {
+        // Objects are emitted after the ThinLTO link, so for now we only write
+        // out the module with its summary, for use by the link
+        let buffer = ThinBuffer::new(&module);
+        let name = input_info.file_stem().to_string_lossy().into_owned();
+        let outfile = db.output_dir().join(format!("{}.thinlto.bc", &name));
+        let bc_path = db.emit_file_with_callback(outfile, |f| {
+            debug!("emitting thinlto bitcode for {:?}", input);
+            f.write_all(buffer.data()).map_err(|e| e.into())
+        })?;
+        Arc::new(CompiledModule::new(name, None, Some(bc_path)))
+    } else {
+        let bc_path = options
+            .output_types
+            .maybe_emit(&input_info, OutputType::LLVMBitcode)
+            .map(|filename| db.output_dir().join(filename));
+        codegen_module(db, input, &module, bc_path)?
+    };
+
+    debug!("compilation finished for {:?}", input);
+    diagnostics.success("Compiled", format!("{}", &source_name));
+    Ok(compiled)
+}
+
+/// Runs the ThinLTO backend for the module at `index` in the given link, which
+/// was compiled from `input`. The module is optimized along with the functions
+/// it imports from other modules, then compiled to an object file.
+///
+/// Backends are independent of each other, so this is run on all of the modules
+/// in the link in parallel.
+pub(crate) fn codegen_thin_lto_module<C>(
+    db: &C,
+    input: InternedInput,
+    link: &ThinLTOLink,
+    index: usize,
+) -> QueryResult<Arc<CompiledModule>>
+where
+    C: Compiler,
+{
+    let thread_id = thread::current().id();
+
+    let options = db.options();
+    let context = db.llvm_context(thread_id);
+    let target_machine = db.get_target_machine(thread_id);
+
+    debug!("running thinlto backend for {:?} on {:?}", input, thread_id);
+    let mut module = db.to_query_result(link.load_module(index, &context, &target_machine))?;
+
+    let pass_manager = build_pass_manager(&options, OptStage::ThinLTO);
+    db.to_query_result(pass_manager.run(&mut module, &target_machine))?;
+
+    // Emit LLVM IR
+    db.maybe_emit_file_with_opts(&options, input, &module)?;
+
+    // Emit LLVM bitcode
+    let bc_path = db.maybe_emit_file_with_callback_and_opts(
+        &options,
+        input,
+        OutputType::LLVMBitcode,
+        |outfile| {
+            debug!("emitting llvm bitcode for {:?}", input);
+            module.emit_bc(outfile)
+        },
+    )?;
+
+    codegen_module(db, input, &module, bc_path)
+}
+
+/// Emits the assembly and/or object file for a fully optimized module
+fn codegen_module<C>(
+    db: &C,
+    input: InternedInput,
+    module: &llvm::Module,
+    bc_path: Option<PathBuf>,
+) -> QueryResult<Arc<CompiledModule>>
+where
+    C: Compiler,
+{
+    let options = db.options();
+    let input_info = db.lookup_intern_input(input);
+
     // Emit textual assembly file
     db.maybe_emit_file_with_callback_and_opts(&options, input, OutputType::Assembly, |outfile| {
         debug!("emitting asm for {:?}", input);
@@ -331,21 +413,41 @@ where
         },
     )?;
 
-    // Gather compiled module metadata
-    let bc_path = options
-        .output_types
-        .maybe_emit(&input_info, OutputType::LLVMBitcode)
-        .map(|filename| db.output_dir().join(filename));
-
-    let compiled = Arc::new(CompiledModule::new(
+    Ok(Arc::new(CompiledModule::new(
         input_info.file_stem().to_string_lossy().into_owned(),
         obj_path,
         bc_path,
-    ));
+    )))
+}
 
-    debug!("compilation finished for {:?}", input);
-    diagnostics.success("Compiled", format!("{}", &source_name));
-    Ok(compiled)
+/// Constructs the pass manager used to optimize LLVM IR, for the given stage
+fn build_pass_manager(options: &Options, stage: OptStage) -> PassManager {
+    use liblumen_session::Sanitizer;
+
+    let mut pass_manager = PassManager::new();
+    pass_manager.verify(options.debugging_opts.verify_llvm_ir);
+    pass_manager.debug(options.debug_assertions);
+    let (speed, size) = llvm::enums::to_llvm_opt_settings(options.opt_level);
+    pass_manager.optimize(PassBuilderOptLevel::from_codegen_opts(speed, size));
+    pass_manager.stage(stage);
+    if options.codegen_opts.no_vectorize_loops {
+        pass_manager.vectorize_loops(false);
+    }
+    if options.codegen_opts.no_vectorize_slp {
+        pass_manager.vectorize_slp(false);
+    }
+    if options.codegen_opts.no_unroll_loops {
+        pass_manager.unroll_loops(false);
+    }
+    if let Some(sanitizer) = options.debugging_opts.sanitizer {
+        match sanitizer {
+            Sanitizer::Memory => pass_manager.sanitize_memory(/* track_origins */ 0),
+            Sanitizer::Thread => pass_manager.sanitize_thread(),
+            Sanitizer::Address => pass_manager.sanitize_address(),
+            _ => (),
+        }
+    }
+    pass_manager
 }
 
 fn get_input_source_name<C>(db: &C, input: InternedInput) -> Option<String>
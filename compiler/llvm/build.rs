@@ -137,6 +137,7 @@ fn main() {
        .file("c_src/ErrorHandling.cpp")
        .file("c_src/Diagnostics.cpp")
        .file("c_src/Options.cpp")
+       .file("c_src/LTO.cpp")
        .file("c_src/Passes.cpp")
        .file("c_src/Target.cpp")
        .file("c_src/Version.cpp")
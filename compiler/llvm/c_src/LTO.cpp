@@ -0,0 +1,291 @@
+#include "llvm-c/Core.h"
+#include "llvm-c/TargetMachine.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Support/CBindingWrapping.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/FunctionImport.h"
+#include "llvm/Transforms/Utils.h"
+#include "llvm/Transforms/Utils/FunctionImportUtils.h"
+
+#include <memory>
+#include <string>
+
+using ::llvm::DenseMap;
+using ::llvm::DenseSet;
+using ::llvm::FunctionImporter;
+using ::llvm::GlobalValue;
+using ::llvm::GlobalValueSummary;
+using ::llvm::MemoryBufferRef;
+using ::llvm::Module;
+using ::llvm::ModuleSummaryIndex;
+using ::llvm::StringMap;
+using ::llvm::StringRef;
+using ::llvm::TargetMachine;
+using ::llvm::unwrap;
+using ::llvm::ValueInfo;
+using ::llvm::wrap;
+
+// A module serialized to bitcode along with its ThinLTO summary
+struct LLVMLumenThinLTOBuffer {
+  std::string data;
+};
+
+// A module to be included in a ThinLTO link, the data is a buffer
+// produced by LLVMLumenThinLTOBufferCreate
+struct LLVMLumenThinLTOModule {
+  const char *identifier;
+  const char *data;
+  size_t len;
+};
+
+// The result of the ThinLTO link step, i.e. the combined summary index of
+// every module in the link, along with the import/export decisions made from
+// it. This is only read once constructed, so it is shared by all of the
+// backend jobs, which may run concurrently.
+//
+// NOTE: The module buffers are not owned by this structure, they must outlive it
+struct LLVMLumenThinLTOData {
+  ModuleSummaryIndex index;
+  StringMap<MemoryBufferRef> moduleMap;
+  DenseSet<GlobalValue::GUID> guidPreservedSymbols;
+  StringMap<FunctionImporter::ImportMapTy> importLists;
+  StringMap<FunctionImporter::ExportSetTy> exportLists;
+  StringMap<llvm::GVSummaryMapTy> moduleToDefinedGVSummaries;
+
+  LLVMLumenThinLTOData() : index(/*haveGVs=*/false) {}
+};
+
+static bool setError(llvm::Error err, char **errorMessage) {
+  *errorMessage = strdup(llvm::toString(std::move(err)).c_str());
+  return true;
+}
+
+// When linking an ELF shared object, dso_local should be dropped from
+// declarations, we conservatively do so for any position-independent code
+static bool clearDSOLocalOnDeclarations(Module &mod, TargetMachine &tm) {
+  return tm.getTargetTriple().isOSBinFormatELF() &&
+         tm.getRelocationModel() != llvm::Reloc::Static &&
+         mod.getPIELevel() == llvm::PIELevel::Default;
+}
+
+// Returns the definition of a symbol the linker would pick, i.e. the first
+// strong definition, otherwise the first weak one
+static const GlobalValueSummary *
+getFirstDefinitionForLinker(const llvm::GlobalValueSummaryList &summaries) {
+  auto strong = llvm::find_if(summaries, [](const auto &summary) {
+    auto linkage = summary->linkage();
+    return !GlobalValue::isAvailableExternallyLinkage(linkage) &&
+           !GlobalValue::isWeakForLinker(linkage);
+  });
+  if (strong != summaries.end())
+    return strong->get();
+
+  auto weak = llvm::find_if(summaries, [](const auto &summary) {
+    return !GlobalValue::isAvailableExternallyLinkage(summary->linkage());
+  });
+  if (weak != summaries.end())
+    return weak->get();
+
+  return nullptr;
+}
+
+extern "C" LLVMLumenThinLTOBuffer *
+LLVMLumenThinLTOBufferCreate(LLVMModuleRef m) {
+  auto buffer = std::make_unique<LLVMLumenThinLTOBuffer>();
+  {
+    llvm::raw_string_ostream os(buffer->data);
+    llvm::legacy::PassManager pm;
+    // Summaries can only refer to named globals, this is normally done by the
+    // pre-link pipeline, but that pipeline isn't run when not optimizing
+    pm.add(llvm::createNameAnonGlobalPass());
+    pm.add(llvm::createWriteThinLTOBitcodePass(os));
+    pm.run(*unwrap(m));
+  }
+  return buffer.release();
+}
+
+extern "C" void LLVMLumenThinLTOBufferFree(LLVMLumenThinLTOBuffer *buffer) {
+  delete buffer;
+}
+
+extern "C" const char *
+LLVMLumenThinLTOBufferData(const LLVMLumenThinLTOBuffer *buffer) {
+  return buffer->data.data();
+}
+
+extern "C" size_t
+LLVMLumenThinLTOBufferLen(const LLVMLumenThinLTOBuffer *buffer) {
+  return buffer->data.length();
+}
+
+// Performs the ThinLTO link step over the given modules, returning null and
+// setting `errorMessage` if any of the modules could not be read.
+//
+// Modules are only ever linked against code which is not part of the link
+// (i.e. the runtime, and the generated dispatch/atom tables), by name, so
+// every externally visible symbol is preserved. Functions are still imported
+// into the modules which call them, which is what allows calls across Erlang
+// modules to be inlined.
+extern "C" LLVMLumenThinLTOData *
+LLVMLumenCreateThinLTOData(const LLVMLumenThinLTOModule *modules,
+                           unsigned numModules,
+                           char **errorMessage) {
+  auto data = std::make_unique<LLVMLumenThinLTOData>();
+
+  // Load the summary of every module into the combined index
+  for (unsigned i = 0; i < numModules; i++) {
+    const LLVMLumenThinLTOModule *module = &modules[i];
+    StringRef buffer(module->data, module->len);
+    MemoryBufferRef memBuffer(buffer, module->identifier);
+    data->moduleMap[module->identifier] = memBuffer;
+    if (auto err = llvm::readModuleSummaryIndex(memBuffer, data->index, i)) {
+      setError(std::move(err), errorMessage);
+      return nullptr;
+    }
+  }
+
+  for (auto &entry : data->index) {
+    for (auto &summary : entry.second.SummaryList) {
+      if (!GlobalValue::isLocalLinkage(summary->linkage())) {
+        data->guidPreservedSymbols.insert(entry.first);
+        break;
+      }
+    }
+  }
+
+  data->index.collectDefinedGVSummariesPerModule(
+      data->moduleToDefinedGVSummaries);
+
+  // When a symbol has multiple definitions, the linker picks the first one
+  DenseMap<GlobalValue::GUID, const GlobalValueSummary *> prevailingCopy;
+  for (auto &entry : data->index) {
+    if (entry.second.SummaryList.size() > 1)
+      prevailingCopy[entry.first] =
+          getFirstDefinitionForLinker(entry.second.SummaryList);
+  }
+  auto isPrevailing = [&](GlobalValue::GUID guid,
+                          const GlobalValueSummary *summary) {
+    auto prevailing = prevailingCopy.find(guid);
+    if (prevailing == prevailingCopy.end())
+      return true;
+    return prevailing->second == summary;
+  };
+
+  llvm::computeDeadSymbolsWithConstProp(data->index,
+                                        data->guidPreservedSymbols,
+                                        isPrevailing,
+                                        /*importEnabled=*/true);
+  llvm::ComputeCrossModuleImport(data->index,
+                                 data->moduleToDefinedGVSummaries,
+                                 data->importLists,
+                                 data->exportLists);
+
+  // The new linkage is recorded in the index, which is what each backend
+  // applies to its module, so there is nothing else to do with it here
+  auto recordNewLinkage = [](StringRef moduleIdentifier,
+                             GlobalValue::GUID guid,
+                             GlobalValue::LinkageTypes newLinkage) {};
+  llvm::thinLTOResolvePrevailingInIndex(data->index, isPrevailing,
+                                        recordNewLinkage,
+                                        data->guidPreservedSymbols);
+
+  auto isExported = [&](StringRef moduleIdentifier, ValueInfo vi) {
+    auto exports = data->exportLists.find(moduleIdentifier);
+    return (exports != data->exportLists.end() && exports->second.count(vi)) ||
+           data->guidPreservedSymbols.count(vi.getGUID());
+  };
+  llvm::thinLTOInternalizeAndPromoteInIndex(data->index, isExported,
+                                            isPrevailing);
+
+  return data.release();
+}
+
+extern "C" void LLVMLumenFreeThinLTOData(LLVMLumenThinLTOData *data) {
+  delete data;
+}
+
+// Parses a module from a buffer which is part of a ThinLTO link, the
+// identifier must be the same as the one the module was given in the link
+extern "C" LLVMModuleRef
+LLVMLumenParseBitcodeForLTO(LLVMContextRef context,
+                            const char *data,
+                            size_t len,
+                            const char *identifier,
+                            char **errorMessage) {
+  StringRef buffer(data, len);
+  MemoryBufferRef memBuffer(buffer, identifier);
+  unwrap(context)->enableDebugTypeODRUniquing();
+  auto result = llvm::parseBitcodeFile(memBuffer, *unwrap(context));
+  if (!result) {
+    setError(result.takeError(), errorMessage);
+    return nullptr;
+  }
+  return wrap(std::move(*result).release());
+}
+
+// Applies the results of the ThinLTO link to a module parsed with
+// LLVMLumenParseBitcodeForLTO, in preparation for running the ThinLTO
+// optimization pipeline on it:
+//
+// * Local symbols referenced from other modules are promoted and renamed
+// * Linkage of symbols with multiple definitions is resolved
+// * Symbols not referenced from other modules are internalized
+// * Functions chosen for import are copied in from the modules defining them
+//
+// Returns true and sets `errorMessage` on failure
+extern "C" bool
+LLVMLumenPrepareThinLTOModule(const LLVMLumenThinLTOData *data,
+                              LLVMModuleRef m,
+                              LLVMTargetMachineRef tm,
+                              char **errorMessage) {
+  Module &mod = *unwrap(m);
+  TargetMachine &targetMachine = *unwrap(tm);
+  StringRef identifier = mod.getModuleIdentifier();
+
+  bool clearDSOLocal = clearDSOLocalOnDeclarations(mod, targetMachine);
+  if (llvm::renameModuleForThinLTO(mod, data->index, clearDSOLocal)) {
+    *errorMessage = strdup("failed to promote local symbols for thinlto");
+    return true;
+  }
+
+  const auto &definedGlobals =
+      data->moduleToDefinedGVSummaries.lookup(identifier);
+  llvm::thinLTOResolvePrevailingInModule(mod, definedGlobals);
+  llvm::thinLTOInternalizeModule(mod, definedGlobals);
+
+  // Imported functions are loaded lazily from the module buffers, in the
+  // context of the module they are being imported into
+  auto loader = [&](StringRef moduleIdentifier)
+      -> llvm::Expected<std::unique_ptr<Module>> {
+    MemoryBufferRef memBuffer = data->moduleMap.lookup(moduleIdentifier);
+    auto lazy = llvm::getLazyBitcodeModule(memBuffer, mod.getContext(),
+                                           /*shouldLazyLoadMetadata=*/true,
+                                           /*isImporting=*/true);
+    if (!lazy)
+      return lazy.takeError();
+    if (auto err = (*lazy)->materializeMetadata())
+      return std::move(err);
+    return lazy;
+  };
+
+  const auto &importList = data->importLists.lookup(identifier);
+  FunctionImporter importer(data->index, loader, clearDSOLocal);
+  auto result = importer.importFunctions(mod, importList);
+  if (!result)
+    return setError(result.takeError(), errorMessage);
+
+  return false;
+}
@@ -224,6 +224,10 @@ struct OptimizerConfig {
   bool emitSummaryIndex;
   bool emitModuleHash;
   bool preserveUseListOrder;
+  bool loopVectorize;
+  bool slpVectorize;
+  bool loopInterleave;
+  bool loopUnroll;
   void* profiler;
   LLVMLumenSelfProfileBeforePassCallback beforePass;
   LLVMLumenSelfProfileAfterPassCallback afterPass;
@@ -241,10 +245,10 @@ LLVMLumenOptimize(LLVMModuleRef m,
   auto optLevel = fromRust(config.optLevel);
 
   llvm::PipelineTuningOptions tuningOpts;
-  tuningOpts.LoopInterleaving = false;
-  tuningOpts.LoopVectorization = false;
-  tuningOpts.SLPVectorization = false;
-  tuningOpts.LoopUnrolling = false;
+  tuningOpts.LoopInterleaving = config.loopInterleave;
+  tuningOpts.LoopVectorization = config.loopVectorize;
+  tuningOpts.SLPVectorization = config.slpVectorize;
+  tuningOpts.LoopUnrolling = config.loopUnroll;
   tuningOpts.Coroutines = false;
 
   bool debug = config.debug;
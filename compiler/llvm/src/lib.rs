@@ -11,6 +11,7 @@ pub mod context;
 pub mod diagnostics;
 pub mod enums;
 pub mod funclet;
+pub mod lto;
 pub mod module;
 pub mod passes;
 pub mod profiling;
@@ -0,0 +1,195 @@
+///! Support for ThinLTO
+///!
+///! A ThinLTO build runs in three phases:
+///!
+///! 1. Each module is optimized using the `PreLinkThinLTO` stage, then serialized
+///!    along with a summary of its contents into a `ThinBuffer`
+///! 2. The summaries of all modules are combined into a `ThinLTOData`, which
+///!    decides which functions get imported into which modules
+///! 3. Each module is loaded from its buffer with `ThinLTOData::load_module`,
+///!    then optimized using the `ThinLTO` stage and compiled to an object file
+///!
+///! Phases 1 and 3 are independent for each module, and can run in parallel.
+use std::ffi::CString;
+use std::mem::MaybeUninit;
+use std::slice;
+
+use anyhow::anyhow;
+
+use libc::{c_char, c_uint, size_t};
+
+use crate::context::{Context, ContextRef};
+use crate::module::{Module, ModuleRef};
+use crate::target::{TargetMachine, TargetMachineRef};
+use crate::utils::LLVMString;
+use crate::Result;
+
+extern "C" {
+    type ThinLTOBuffer;
+    type ThinLTOData;
+}
+
+#[repr(C)]
+struct ThinLTOModule {
+    identifier: *const c_char,
+    data: *const u8,
+    len: size_t,
+}
+
+/// A module serialized to bitcode along with its ThinLTO summary
+pub struct ThinBuffer(*mut ThinLTOBuffer);
+unsafe impl Send for ThinBuffer {}
+unsafe impl Sync for ThinBuffer {}
+impl ThinBuffer {
+    pub fn new(module: &Module) -> Self {
+        Self(unsafe { LLVMLumenThinLTOBufferCreate(module.as_ref()) })
+    }
+
+    pub fn data(&self) -> &[u8] {
+        unsafe {
+            let ptr = LLVMLumenThinLTOBufferData(self.0);
+            let len = LLVMLumenThinLTOBufferLen(self.0);
+            slice::from_raw_parts(ptr, len)
+        }
+    }
+}
+impl Drop for ThinBuffer {
+    fn drop(&mut self) {
+        unsafe {
+            LLVMLumenThinLTOBufferFree(self.0);
+        }
+    }
+}
+
+/// The result of linking the summaries of a set of modules, which determines
+/// how each of those modules is prepared before being optimized and compiled.
+///
+/// This owns the module buffers it was created from, and is only read after
+/// construction, so it can be shared by backends running on multiple threads.
+pub struct ThinLTOLink {
+    raw: *mut ThinLTOData,
+    names: Vec<CString>,
+    buffers: Vec<Vec<u8>>,
+}
+unsafe impl Send for ThinLTOLink {}
+unsafe impl Sync for ThinLTOLink {}
+impl ThinLTOLink {
+    /// Links the given modules, each given by its name (which must be unique),
+    /// and the contents of a `ThinBuffer` created from it
+    pub fn new(modules: Vec<(String, Vec<u8>)>) -> Result<Self> {
+        let (names, buffers): (Vec<_>, Vec<_>) = modules
+            .into_iter()
+            .map(|(name, buffer)| (CString::new(name).unwrap(), buffer))
+            .unzip();
+
+        let ffi_modules = names
+            .iter()
+            .zip(buffers.iter())
+            .map(|(name, buffer)| ThinLTOModule {
+                identifier: name.as_ptr(),
+                data: buffer.as_ptr(),
+                len: buffer.len(),
+            })
+            .collect::<Vec<_>>();
+
+        let mut err_string = MaybeUninit::uninit();
+        let raw = unsafe {
+            LLVMLumenCreateThinLTOData(
+                ffi_modules.as_ptr(),
+                ffi_modules.len() as c_uint,
+                err_string.as_mut_ptr(),
+            )
+        };
+        if raw.is_null() {
+            let err_string = LLVMString::new(unsafe { err_string.assume_init() });
+            return Err(anyhow!("thinlto link failed: {}", err_string));
+        }
+
+        Ok(Self {
+            raw,
+            names,
+            buffers,
+        })
+    }
+
+    /// Returns the number of modules in this link
+    pub fn len(&self) -> usize {
+        self.names.len()
+    }
+
+    /// Loads the module at `index` into the given context, with the functions
+    /// it imports from other modules, ready for the `ThinLTO` optimization stage
+    pub fn load_module(
+        &self,
+        index: usize,
+        context: &Context,
+        target_machine: &TargetMachine,
+    ) -> Result<Module> {
+        let name = &self.names[index];
+        let buffer = &self.buffers[index];
+
+        let mut err_string = MaybeUninit::uninit();
+        let module = unsafe {
+            LLVMLumenParseBitcodeForLTO(
+                context.as_ref(),
+                buffer.as_ptr(),
+                buffer.len(),
+                name.as_ptr(),
+                err_string.as_mut_ptr(),
+            )
+        };
+        if module.is_null() {
+            let err_string = LLVMString::new(unsafe { err_string.assume_init() });
+            return Err(anyhow!("{}", err_string));
+        }
+
+        let mut err_string = MaybeUninit::uninit();
+        let failed = unsafe {
+            LLVMLumenPrepareThinLTOModule(
+                self.raw,
+                module,
+                target_machine.as_ref(),
+                err_string.as_mut_ptr(),
+            )
+        };
+        if failed {
+            let err_string = LLVMString::new(unsafe { err_string.assume_init() });
+            return Err(anyhow!("{}", err_string));
+        }
+
+        Ok(Module::new(module, target_machine.as_ref()))
+    }
+}
+impl Drop for ThinLTOLink {
+    fn drop(&mut self) {
+        unsafe {
+            LLVMLumenFreeThinLTOData(self.raw);
+        }
+    }
+}
+
+extern "C" {
+    fn LLVMLumenThinLTOBufferCreate(module: ModuleRef) -> *mut ThinLTOBuffer;
+    fn LLVMLumenThinLTOBufferFree(buffer: *mut ThinLTOBuffer);
+    fn LLVMLumenThinLTOBufferData(buffer: *const ThinLTOBuffer) -> *const u8;
+    fn LLVMLumenThinLTOBufferLen(buffer: *const ThinLTOBuffer) -> size_t;
+    fn LLVMLumenCreateThinLTOData(
+        modules: *const ThinLTOModule,
+        num_modules: c_uint,
+        error_message: *mut *const c_char,
+    ) -> *mut ThinLTOData;
+    fn LLVMLumenFreeThinLTOData(data: *mut ThinLTOData);
+    fn LLVMLumenParseBitcodeForLTO(
+        context: ContextRef,
+        data: *const u8,
+        len: size_t,
+        identifier: *const c_char,
+        error_message: *mut *const c_char,
+    ) -> ModuleRef;
+    fn LLVMLumenPrepareThinLTOModule(
+        data: *const ThinLTOData,
+        module: ModuleRef,
+        target_machine: TargetMachineRef,
+        error_message: *mut *const c_char,
+    ) -> bool;
+}
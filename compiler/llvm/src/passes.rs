@@ -41,7 +41,7 @@ pub fn print() {
 }
 
 #[repr(u32)]
-#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq, PartialOrd, Ord)]
 pub enum PassBuilderOptLevel {
     O0 = 0,
     O1,
@@ -114,6 +114,10 @@ pub struct OptimizerConfig {
     emit_summary_index: bool,
     emit_module_hash: bool,
     preserve_use_list_order: bool,
+    loop_vectorize: bool,
+    slp_vectorize: bool,
+    loop_interleave: bool,
+    loop_unroll: bool,
     profiler: *mut libc::c_void,
     before_pass: SelfProfileBeforePassCallback,
     after_pass: SelfProfileAfterPassCallback,
@@ -132,6 +136,10 @@ impl Default for OptimizerConfig {
             emit_summary_index: false,
             emit_module_hash: false,
             preserve_use_list_order: false,
+            loop_vectorize: false,
+            slp_vectorize: false,
+            loop_interleave: false,
+            loop_unroll: false,
             profiler: ptr::null_mut(),
             before_pass: profiling::selfprofile_before_pass_callback,
             after_pass: profiling::selfprofile_after_pass_callback,
@@ -157,12 +165,47 @@ impl PassManager {
         self.config.verify = verify;
     }
 
+    /// Sets the optimization level, along with the default loop/vectorization
+    /// tuning for that level, which matches what clang uses:
+    ///
+    /// * Loop vectorization is enabled at O2, O3 and Os
+    /// * SLP vectorization is enabled at O2, O3, Os and Oz
+    /// * Loop unrolling and interleaving are enabled at O2, O3, Os and Oz
+    ///
+    /// The tuning can be overridden after calling this
     pub fn optimize(&mut self, level: PassBuilderOptLevel) {
+        use PassBuilderOptLevel::*;
+
         self.config.opt_level = level;
+        self.config.loop_vectorize = match level {
+            O2 | O3 | Os => true,
+            O0 | O1 | Oz => false,
+        };
+        self.config.slp_vectorize = level > O1;
+        self.config.loop_interleave = level > O1;
+        self.config.loop_unroll = level > O1;
+    }
+
+    pub fn vectorize_loops(&mut self, enabled: bool) {
+        self.config.loop_vectorize = enabled;
+    }
+
+    pub fn vectorize_slp(&mut self, enabled: bool) {
+        self.config.slp_vectorize = enabled;
+    }
+
+    pub fn unroll_loops(&mut self, enabled: bool) {
+        self.config.loop_interleave = enabled;
+        self.config.loop_unroll = enabled;
     }
 
+    /// Sets the LTO stage the pipeline is built for
+    ///
+    /// When preparing modules for ThinLTO, this also makes sure they can
+    /// be summarized, see `lto::ThinBuffer`
     pub fn stage(&mut self, stage: OptStage) {
         self.config.opt_stage = stage;
+        self.config.use_thinlto_buffers = stage == OptStage::PreLinkThinLTO;
     }
 
     pub fn sanitize_memory(&mut self, track_origins: u32) {
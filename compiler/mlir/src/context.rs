@@ -87,6 +87,10 @@ impl Context {
             print_after_pass: options.debugging_opts.print_passes_after,
             print_module_scope_always: options.debugging_opts.print_mlir_module_scope_always,
             print_after_only_on_change: options.debugging_opts.print_passes_on_change,
+            max_reductions: options
+                .codegen_opts
+                .max_reductions
+                .unwrap_or(DEFAULT_MAX_REDUCTIONS as u64) as u32,
         };
         let pass_manager = unsafe { MLIRCreatePassManager(context, target_machine, &pass_options) };
         Self {
@@ -177,6 +181,10 @@ impl PartialEq for Context {
     }
 }
 
+/// The number of reductions a process may perform before it must yield, unless
+/// overridden with `-C max-reductions`
+const DEFAULT_MAX_REDUCTIONS: u32 = 20;
+
 #[repr(C)]
 pub struct PassManagerOptions {
     opt: CodeGenOptLevel,
@@ -187,6 +195,7 @@ pub struct PassManagerOptions {
     print_after_pass: bool,
     print_module_scope_always: bool,
     print_after_only_on_change: bool,
+    max_reductions: u32,
 }
 impl Default for PassManagerOptions {
     fn default() -> Self {
@@ -199,6 +208,7 @@ impl Default for PassManagerOptions {
             print_after_pass: false,
             print_module_scope_always: false,
             print_after_only_on_change: true,
+            max_reductions: DEFAULT_MAX_REDUCTIONS,
         }
     }
 }
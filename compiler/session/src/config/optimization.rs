@@ -54,6 +54,15 @@ pub enum Lto {
     /// Do a full crate graph LTO with "fat" LTO
     Fat,
 }
+impl Lto {
+    /// Returns true if this is one of the ThinLTO modes
+    pub fn is_thin(&self) -> bool {
+        match self {
+            Self::Thin | Self::ThinLocal => true,
+            _ => false,
+        }
+    }
+}
 
 /// The different settings that the `-C lto` flag can have.
 #[derive(Clone, Copy, PartialEq, Hash, Debug)]
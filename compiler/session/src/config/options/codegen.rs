@@ -99,9 +99,21 @@ pub struct CodegenOptions {
     )]
     /// Perform link-time optimization
     pub lto: LtoCli,
+    #[option(default_value("20"), value_name("N"), takes_value(true), hidden(true))]
+    /// Set the number of reductions a process may perform before yielding
+    pub max_reductions: Option<u64>,
     #[option(hidden(true))]
     /// Don't pre-populate the pass manager with a list of passes
     pub no_prepopulate_passes: bool,
+    #[option]
+    /// Disable loop unrolling and interleaving
+    pub no_unroll_loops: bool,
+    #[option]
+    /// Disable loop vectorization optimization passes
+    pub no_vectorize_loops: bool,
+    #[option]
+    /// Disable LLVM's SLP vectorization pass
+    pub no_vectorize_slp: bool,
     #[option(hidden(true))]
     /// When set, does not implicitly link the Lumen runtime
     pub no_std: Option<bool>,
@@ -30,6 +30,7 @@ extern "C" uint64_t lumen_list_tag(::lumen::Encoding *encoding);
 extern "C" uint64_t lumen_list_mask(::lumen::Encoding *encoding);
 extern "C" uint64_t lumen_box_tag(::lumen::Encoding *encoding);
 extern "C" uint64_t lumen_literal_tag(::lumen::Encoding *encoding);
+extern "C" uint64_t lumen_match_context_tag(::lumen::Encoding *encoding);
 extern "C" ::lumen::MaskInfo lumen_immediate_mask(::lumen::Encoding *encoding);
 extern "C" ::lumen::MaskInfo lumen_header_mask(::lumen::Encoding *encoding);
 
@@ -248,6 +248,18 @@ pub extern "C" fn literal_tag(encoding: *const EncodingInfo) -> u64 {
     }
 }
 
+#[unwind(allowed)]
+#[export_name = "lumen_match_context_tag"]
+pub extern "C" fn match_context_tag(encoding: *const EncodingInfo) -> u64 {
+    let encoding = unsafe { &*encoding };
+    match encoding.pointer_size {
+        32 => Encoding32::TAG_MATCH_CTX as u64,
+        64 if encoding.supports_nanboxing => Encoding64Nanboxed::TAG_MATCH_CTX,
+        64 => Encoding64::TAG_MATCH_CTX,
+        _ => unreachable!(),
+    }
+}
+
 #[unwind(allowed)]
 #[export_name = "lumen_immediate_mask"]
 pub extern "C" fn immediate_mask(encoding: *const EncodingInfo) -> MaskInfo {
@@ -445,6 +445,7 @@ struct _LIBUNWIND_HIDDEN dl_iterate_cb_data {
   LocalAddressSpace *addressSpace;
   UnwindInfoSections *sects;
   uintptr_t targetAddr;
+  size_t objectCount;
 };
 
 #if defined(_LIBUNWIND_SUPPORT_DWARF_UNWIND)
@@ -454,8 +455,9 @@ struct _LIBUNWIND_HIDDEN dl_iterate_cb_data {
 
 #include "FrameHeaderCache.hpp"
 
-// There should be just one of these per process.
-static FrameHeaderCache ProcessFrameHeaderCache;
+// There is one of these per thread, see FrameHeaderCache.hpp.
+static _LIBUNWIND_FRAMEHEADERCACHE_THREAD_LOCAL FrameHeaderCache
+    ThreadFrameHeaderCache;
 
 static bool checkAddrInSegment(const Elf_Phdr *phdr, size_t image_base,
                                dl_iterate_cb_data *cbdata) {
@@ -474,10 +476,18 @@ static bool checkAddrInSegment(const Elf_Phdr *phdr, size_t image_base,
 int findUnwindSectionsByPhdr(struct dl_phdr_info *pinfo, size_t pinfo_size,
                              void *data) {
   auto cbdata = static_cast<dl_iterate_cb_data *>(data);
+  FrameHeaderCache::checkLoadedObjects(pinfo, pinfo_size);
+
+  // The first object is the main program. Now that the loaded objects have
+  // been checked, any entry of this thread's cache can be trusted.
+  bool isMainProgram = cbdata->objectCount++ == 0;
+  if (isMainProgram &&
+      ThreadFrameHeaderCache.find(cbdata->targetAddr, cbdata->sects,
+                                  /*PinnedOnly=*/false))
+    return 1;
+
   if (pinfo->dlpi_phnum == 0 || cbdata->targetAddr < pinfo->dlpi_addr)
     return 0;
-  if (ProcessFrameHeaderCache.find(pinfo, pinfo_size, data))
-    return 1;
 
   Elf_Addr image_base = calculateImageBase(pinfo);
   bool found_obj = false;
@@ -505,7 +515,8 @@ int findUnwindSectionsByPhdr(struct dl_phdr_info *pinfo, size_t pinfo_size,
       found_obj = checkAddrInSegment(phdr, image_base, cbdata);
     }
     if (found_obj && found_hdr) {
-      ProcessFrameHeaderCache.add(cbdata->sects);
+      ThreadFrameHeaderCache.add(cbdata->targetAddr, cbdata->sects,
+                                 isMainProgram);
       return 1;
     }
   }
@@ -641,7 +652,13 @@ inline bool LocalAddressSpace::findUnwindSections(pint_t targetAddr,
   if (info.arm_section && info.arm_section_length)
     return true;
 #elif defined(_LIBUNWIND_ARM_EHABI) || defined(_LIBUNWIND_SUPPORT_DWARF_UNWIND)
-  dl_iterate_cb_data cb_data = {this, &info, targetAddr};
+#if defined(_LIBUNWIND_SUPPORT_DWARF_UNWIND)
+  // Try the pinned entries of this thread's cache first, which avoids taking
+  // the load lock
+  if (ThreadFrameHeaderCache.find(targetAddr, &info, /*PinnedOnly=*/true))
+    return true;
+#endif
+  dl_iterate_cb_data cb_data = {this, &info, targetAddr, 0};
   int found = dl_iterate_phdr(findUnwindSectionsByPhdr, &cb_data);
   return static_cast<bool>(found);
 #endif
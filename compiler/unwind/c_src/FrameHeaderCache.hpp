@@ -14,6 +14,7 @@
 
 #include "config.h"
 #include <limits.h>
+#include <stddef.h>
 
 #ifdef _LIBUNWIND_DEBUG_FRAMEHEADER_CACHE
 #define _LIBUNWIND_FRAMEHEADERCACHE_TRACE0(x) _LIBUNWIND_LOG0(x)
@@ -24,44 +25,95 @@
 #define _LIBUNWIND_FRAMEHEADERCACHE_TRACE(msg, ...)
 #endif
 
-// This cache should only be be used from within a dl_iterate_phdr callback.
-// dl_iterate_phdr does the necessary synchronization to prevent problems
-// with concurrent access via the libc load lock. Adding synchronization
-// for other uses is possible, but not currently done.
+#if defined(_LIBUNWIND_HAS_NO_THREADS)
+#define _LIBUNWIND_FRAMEHEADERCACHE_THREAD_LOCAL
+#elif defined(__GNUC__) || defined(__clang__)
+#define _LIBUNWIND_FRAMEHEADERCACHE_THREAD_LOCAL __thread
+#else
+#define _LIBUNWIND_FRAMEHEADERCACHE_THREAD_LOCAL thread_local
+#endif
+
+// The geometry of the cache can be tuned at build time. Addresses are mapped
+// to a set by their granule (2^GRANULE_SHIFT bytes), and each set holds WAYS
+// entries, replaced in least recently used order.
+#ifndef _LIBUNWIND_FRAMEHEADER_CACHE_SETS
+#define _LIBUNWIND_FRAMEHEADER_CACHE_SETS 16
+#endif
+#ifndef _LIBUNWIND_FRAMEHEADER_CACHE_WAYS
+#define _LIBUNWIND_FRAMEHEADER_CACHE_WAYS 4
+#endif
+#ifndef _LIBUNWIND_FRAMEHEADER_CACHE_GRANULE_SHIFT
+#define _LIBUNWIND_FRAMEHEADER_CACHE_GRANULE_SHIFT 16
+#endif
+
+static_assert(_LIBUNWIND_FRAMEHEADER_CACHE_SETS > 0 &&
+                  (_LIBUNWIND_FRAMEHEADER_CACHE_SETS &
+                   (_LIBUNWIND_FRAMEHEADER_CACHE_SETS - 1)) == 0 &&
+                  _LIBUNWIND_FRAMEHEADER_CACHE_WAYS > 0,
+              "FrameHeaderCache needs power of two sets and at least one way");
+
+// Each thread has its own cache. Entries are only added from within a
+// dl_iterate_phdr callback, where the libc load lock is held.
+//
+// Loading and unloading shared libraries is detected through the adds and subs
+// counters of dl_phdr_info, which every callback inspects. A change bumps a
+// process-wide generation, and a thread discards its entries the next time it
+// sees that its cache was filled under an older generation.
+//
+// Since the generation only changes when some thread calls dl_iterate_phdr,
+// it says nothing about an object another thread has unloaded since. So only
+// entries for the main program, which is never unloaded, are pinned and may be
+// returned before dl_iterate_phdr is called, without taking any locks. Any
+// other entry is only returned from the first callback of an iteration, once
+// checkLoadedObjects has brought the generation up to date, which still saves
+// visiting every loaded object.
 
 class _LIBUNWIND_HIDDEN FrameHeaderCache {
   struct CacheEntry {
     uintptr_t LowPC() { return Info.dso_base; };
     uintptr_t HighPC() { return Info.dso_base + Info.dwarf_section_length; };
     UnwindInfoSections Info;
-    CacheEntry *Next;
+    bool Pinned;
+  };
+
+  static const size_t kCacheSetCount = _LIBUNWIND_FRAMEHEADER_CACHE_SETS;
+  static const size_t kCacheWayCount = _LIBUNWIND_FRAMEHEADER_CACHE_WAYS;
+  static const size_t kCacheGranuleShift =
+      _LIBUNWIND_FRAMEHEADER_CACHE_GRANULE_SHIFT;
+
+  // Entries are ordered from most to least recently used, and only the first
+  // Count of them are valid.
+  struct CacheSet {
+    CacheEntry Entries[kCacheWayCount];
+    size_t Count;
   };
 
-  static const size_t kCacheEntryCount = 8;
+  // This must stay trivially constructible, so that instances can be placed
+  // in thread-local storage without dynamic initialization. Zero-initialized,
+  // every set is empty.
+  CacheSet Sets[kCacheSetCount];
+  unsigned long Generation;
 
-  // Can't depend on the C++ standard library in libunwind, so use an array to
-  // allocate the entries, and two linked lists for ordering unused and recently
-  // used entries.  FIXME: Would the the extra memory for a doubly-linked list
-  // be better than the runtime cost of traversing a very short singly-linked
-  // list on a cache miss? The entries themselves are all small and consecutive,
-  // so unlikely to cause page faults when following the pointers. The memory
-  // spent on additional pointers could also be spent on more entries.
+  static unsigned long *processGeneration() {
+    static unsigned long ProcessGeneration = 0;
+    return &ProcessGeneration;
+  }
 
-  CacheEntry Entries[kCacheEntryCount];
-  CacheEntry *MostRecentlyUsed;
-  CacheEntry *Unused;
+  CacheSet &setFor(uintptr_t PC) {
+    return Sets[(PC >> kCacheGranuleShift) & (kCacheSetCount - 1)];
+  }
 
-  void resetCache() {
+  void resetCache(unsigned long NewGeneration) {
     _LIBUNWIND_FRAMEHEADERCACHE_TRACE0("FrameHeaderCache reset");
-    MostRecentlyUsed = nullptr;
-    Unused = &Entries[0];
-    for (size_t i = 0; i < kCacheEntryCount - 1; i++) {
-      Entries[i].Next = &Entries[i + 1];
-    }
-    Entries[kCacheEntryCount - 1].Next = nullptr;
+    for (size_t i = 0; i < kCacheSetCount; i++)
+      Sets[i].Count = 0;
+    Generation = NewGeneration;
   }
 
-  bool cacheNeedsReset(dl_phdr_info *PInfo) {
+public:
+  // Called from each dl_iterate_phdr callback, before anything else, so that
+  // changes to the set of loaded objects are noticed as soon as possible.
+  static void checkLoadedObjects(dl_phdr_info *PInfo, size_t PInfoSize) {
     // C libraries increment dl_phdr_info.adds and dl_phdr_info.subs when
     // loading and unloading shared libraries. If these values change between
     // iterations of dl_iterate_phdr, then invalidate the cache.
@@ -69,80 +121,90 @@ class _LIBUNWIND_HIDDEN FrameHeaderCache {
     // These are static to avoid needing an initializer, and unsigned long long
     // because that is their type within the extended dl_phdr_info.  Initialize
     // these to something extremely unlikely to be found upon the first call to
-    // dl_iterate_phdr.
+    // dl_iterate_phdr. They are only accessed with the load lock held.
     static unsigned long long LastAdds = ULLONG_MAX;
     static unsigned long long LastSubs = ULLONG_MAX;
-    if (PInfo->dlpi_adds != LastAdds || PInfo->dlpi_subs != LastSubs) {
-      // Resetting the entire cache is a big hammer, but this path is rare--
-      // usually just on the very first call, when the cache is empty anyway--so
-      // added complexity doesn't buy much.
+
+    // Without the extended fields there is no way to tell when entries become
+    // stale, so never let one outlive the iteration that produced it.
+    bool HasCounters = PInfoSize >= offsetof(dl_phdr_info, dlpi_subs) +
+                                        sizeof(PInfo->dlpi_subs);
+    if (HasCounters && PInfo->dlpi_adds == LastAdds &&
+        PInfo->dlpi_subs == LastSubs)
+      return;
+    if (HasCounters) {
       LastAdds = PInfo->dlpi_adds;
       LastSubs = PInfo->dlpi_subs;
-      resetCache();
-      return true;
     }
-    return false;
+    unsigned long *ProcessGeneration = processGeneration();
+    __atomic_store_n(ProcessGeneration, *ProcessGeneration + 1,
+                     __ATOMIC_RELEASE);
   }
 
-public:
-  bool find(dl_phdr_info *PInfo, size_t, void *data) {
-    if (cacheNeedsReset(PInfo) || MostRecentlyUsed == nullptr)
+  // Unless called from within a dl_iterate_phdr callback, after
+  // checkLoadedObjects, only pinned entries may be returned.
+  bool find(uintptr_t TargetAddr, UnwindInfoSections *Sects, bool PinnedOnly) {
+    unsigned long Current =
+        __atomic_load_n(processGeneration(), __ATOMIC_ACQUIRE);
+    if (Current != Generation) {
+      resetCache(Current);
       return false;
+    }
 
-    auto *CBData = static_cast<dl_iterate_cb_data *>(data);
-    CacheEntry *Current = MostRecentlyUsed;
-    CacheEntry *Previous = nullptr;
-    while (Current != nullptr) {
+    CacheSet &Set = setFor(TargetAddr);
+    for (size_t i = 0; i < Set.Count; i++) {
+      CacheEntry &Entry = Set.Entries[i];
+      if (PinnedOnly && !Entry.Pinned)
+        continue;
       _LIBUNWIND_FRAMEHEADERCACHE_TRACE(
-          "FrameHeaderCache check %lx in [%lx - %lx)", CBData->targetAddr,
-          Current->LowPC(), Current->HighPC());
-      if (Current->LowPC() <= CBData->targetAddr &&
-          CBData->targetAddr < Current->HighPC()) {
+          "FrameHeaderCache check %lx in [%lx - %lx)", TargetAddr,
+          Entry.LowPC(), Entry.HighPC());
+      if (Entry.LowPC() <= TargetAddr && TargetAddr < Entry.HighPC()) {
         _LIBUNWIND_FRAMEHEADERCACHE_TRACE(
-            "FrameHeaderCache hit %lx in [%lx - %lx)", CBData->targetAddr,
-            Current->LowPC(), Current->HighPC());
-        if (Previous) {
-          // If there is no Previous, then Current is already the
-          // MostRecentlyUsed, and no need to move it up.
-          Previous->Next = Current->Next;
-          Current->Next = MostRecentlyUsed;
-          MostRecentlyUsed = Current;
+            "FrameHeaderCache hit %lx in [%lx - %lx)", TargetAddr,
+            Entry.LowPC(), Entry.HighPC());
+        *Sects = Entry.Info;
+        if (i != 0) {
+          // Move the entry up to the most recently used position
+          CacheEntry Hit = Entry;
+          for (size_t j = i; j > 0; j--)
+            Set.Entries[j] = Set.Entries[j - 1];
+          Set.Entries[0] = Hit;
         }
-        *CBData->sects = Current->Info;
         return true;
       }
-      Previous = Current;
-      Current = Current->Next;
     }
     _LIBUNWIND_FRAMEHEADERCACHE_TRACE("FrameHeaderCache miss for address %lx",
-                                      CBData->targetAddr);
+                                      TargetAddr);
     return false;
   }
 
-  void add(const UnwindInfoSections *UIS) {
-    CacheEntry *Current = nullptr;
-
-    if (Unused != nullptr) {
-      Current = Unused;
-      Unused = Unused->Next;
+  // Must only be called from within a dl_iterate_phdr callback, after
+  // checkLoadedObjects, since the generation is read without synchronization.
+  // Pinned must only be set for an object that can never be unloaded.
+  void add(uintptr_t TargetAddr, const UnwindInfoSections *UIS, bool Pinned) {
+    unsigned long Current =
+        __atomic_load_n(processGeneration(), __ATOMIC_RELAXED);
+    if (Current != Generation)
+      resetCache(Current);
+
+    CacheSet &Set = setFor(TargetAddr);
+    size_t Last = Set.Count;
+    if (Last < kCacheWayCount) {
+      Set.Count++;
     } else {
-      Current = MostRecentlyUsed;
-      CacheEntry *Previous = nullptr;
-      while (Current->Next != nullptr) {
-        Previous = Current;
-        Current = Current->Next;
-      }
-      Previous->Next = nullptr;
+      Last = kCacheWayCount - 1;
       _LIBUNWIND_FRAMEHEADERCACHE_TRACE("FrameHeaderCache evict [%lx - %lx)",
-                                        Current->LowPC(), Current->HighPC());
+                                        Set.Entries[Last].LowPC(),
+                                        Set.Entries[Last].HighPC());
     }
-
-    Current->Info = *UIS;
-    Current->Next = MostRecentlyUsed;
-    MostRecentlyUsed = Current;
+    for (size_t j = Last; j > 0; j--)
+      Set.Entries[j] = Set.Entries[j - 1];
+    Set.Entries[0].Info = *UIS;
+    Set.Entries[0].Pinned = Pinned;
     _LIBUNWIND_FRAMEHEADERCACHE_TRACE("FrameHeaderCache add [%lx - %lx)",
-                                      MostRecentlyUsed->LowPC(),
-                                      MostRecentlyUsed->HighPC());
+                                      Set.Entries[0].LowPC(),
+                                      Set.Entries[0].HighPC());
   }
 };
 
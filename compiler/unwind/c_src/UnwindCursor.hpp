@@ -77,6 +77,12 @@ namespace libunwind {
 
 #if defined(_LIBUNWIND_SUPPORT_DWARF_UNWIND)
 /// Cache of recently found FDEs.
+///
+/// Entries are kept sorted by ip_start, with no two entries covering the same
+/// address, so lookups are a binary search. Lookups take no locks and perform
+/// no atomic read-modify-write operations; instead, updates (which are
+/// serialized by _lock) are bracketed by increments of a sequence number, and
+/// a lookup which overlapped with an update is simply retried.
 template <typename A>
 class _LIBUNWIND_HIDDEN DwarfFDECache {
   typedef typename A::pint_t pint_t;
@@ -97,6 +103,33 @@ private:
     pint_t fde;
   };
 
+  // The entries of a table immediately follow it in memory. The capacity of
+  // a table never changes, so a reader can always bound its search by it,
+  // even when it has observed a count from an update it raced with.
+  struct table {
+    size_t capacity;
+    size_t count;
+    entry *entries() { return reinterpret_cast<entry *>(this + 1); }
+  };
+
+  static pint_t search(table *t, pint_t mh, pint_t pc);
+  static size_t lowerBound(table *t, pint_t ip);
+  static void beginUpdate();
+  static void endUpdate();
+
+  static pint_t load(const pint_t *field) {
+    return __atomic_load_n(field, __ATOMIC_RELAXED);
+  }
+  static void store(pint_t *field, pint_t value) {
+    __atomic_store_n(field, value, __ATOMIC_RELAXED);
+  }
+  static void storeEntry(entry *dest, const entry &src) {
+    store(&dest->mh, src.mh);
+    store(&dest->ip_start, src.ip_start);
+    store(&dest->ip_end, src.ip_end);
+    store(&dest->fde, src.fde);
+  }
+
   // These fields are all static to avoid needing an initializer.
   // There is only one instance of this class per process.
   static RWMutex _lock;
@@ -104,26 +137,25 @@ private:
   static void dyldUnloadHook(const struct mach_header *mh, intptr_t slide);
   static bool _registeredForDyldUnloads;
 #endif
-  static entry *_buffer;
-  static entry *_bufferUsed;
-  static entry *_bufferEnd;
-  static entry _initialBuffer[64];
+  // Odd while an update is in progress
+  static unsigned long _sequence;
+  static table *_table;
+  static struct initial_table {
+    table header;
+    entry entries[64];
+  } _initialTable;
 };
 
 template <typename A>
-typename DwarfFDECache<A>::entry *
-DwarfFDECache<A>::_buffer = _initialBuffer;
+unsigned long DwarfFDECache<A>::_sequence = 0;
 
 template <typename A>
-typename DwarfFDECache<A>::entry *
-DwarfFDECache<A>::_bufferUsed = _initialBuffer;
+typename DwarfFDECache<A>::table *
+DwarfFDECache<A>::_table = &DwarfFDECache<A>::_initialTable.header;
 
 template <typename A>
-typename DwarfFDECache<A>::entry *
-DwarfFDECache<A>::_bufferEnd = &_initialBuffer[64];
-
-template <typename A>
-typename DwarfFDECache<A>::entry DwarfFDECache<A>::_initialBuffer[64];
+typename DwarfFDECache<A>::initial_table DwarfFDECache<A>::_initialTable = {
+    {64, 0}, {}};
 
 template <typename A>
 RWMutex DwarfFDECache<A>::_lock;
@@ -133,44 +165,128 @@ template <typename A>
 bool DwarfFDECache<A>::_registeredForDyldUnloads = false;
 #endif
 
+template <typename A>
+void DwarfFDECache<A>::beginUpdate() {
+  __atomic_store_n(&_sequence, _sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+template <typename A>
+void DwarfFDECache<A>::endUpdate() {
+  __atomic_store_n(&_sequence, _sequence + 1, __ATOMIC_RELEASE);
+}
+
+// Returns the index of the first entry of the table which starts at or after
+// the given address
+template <typename A>
+size_t DwarfFDECache<A>::lowerBound(table *t, pint_t ip) {
+  size_t count = __atomic_load_n(&t->count, __ATOMIC_RELAXED);
+  if (count > t->capacity)
+    count = t->capacity;
+  entry *entries = t->entries();
+  size_t low = 0;
+  size_t high = count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (load(&entries[mid].ip_start) < ip)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+template <typename A>
+typename A::pint_t DwarfFDECache<A>::search(table *t, pint_t mh, pint_t pc) {
+  // The only entry which may contain pc is the last one starting at or
+  // before it, i.e. the one before the first entry starting after it
+  size_t index = lowerBound(t, pc + 1);
+  if (index == 0)
+    return 0;
+  entry *p = &t->entries()[index - 1];
+  if ((mh == load(&p->mh)) || (mh == 0)) {
+    if ((load(&p->ip_start) <= pc) && (pc < load(&p->ip_end)))
+      return load(&p->fde);
+  }
+  return 0;
+}
+
 template <typename A>
 typename A::pint_t DwarfFDECache<A>::findFDE(pint_t mh, pint_t pc) {
-  pint_t result = 0;
-  _LIBUNWIND_LOG_IF_FALSE(_lock.lock_shared());
-  for (entry *p = _buffer; p < _bufferUsed; ++p) {
-    if ((mh == p->mh) || (mh == 0)) {
-      if ((p->ip_start <= pc) && (pc < p->ip_end)) {
-        result = p->fde;
-        break;
-      }
-    }
+  for (;;) {
+    unsigned long sequence = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+    if (sequence & 1)
+      continue;
+    table *t = __atomic_load_n(&_table, __ATOMIC_RELAXED);
+    pint_t result = search(t, mh, pc);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&_sequence, __ATOMIC_RELAXED) == sequence)
+      return result;
   }
-  _LIBUNWIND_LOG_IF_FALSE(_lock.unlock_shared());
-  return result;
 }
 
 template <typename A>
 void DwarfFDECache<A>::add(pint_t mh, pint_t ip_start, pint_t ip_end,
                            pint_t fde) {
 #if !defined(_LIBUNWIND_NO_HEAP)
+  if (ip_end <= ip_start)
+    return;
   _LIBUNWIND_LOG_IF_FALSE(_lock.lock());
-  if (_bufferUsed >= _bufferEnd) {
-    size_t oldSize = (size_t)(_bufferEnd - _buffer);
-    size_t newSize = oldSize * 4;
+  table *t = _table;
+  entry *entries = t->entries();
+  // Any entries overlapping the new one are stale (e.g. they belong to an
+  // image which has since been unloaded), and are replaced by it
+  size_t first = lowerBound(t, ip_start);
+  if (first > 0 && entries[first - 1].ip_end > ip_start)
+    --first;
+  size_t last = lowerBound(t, ip_end);
+  entry e = {mh, ip_start, ip_end, fde};
+  bool isCached = (last == first + 1) && (entries[first].mh == mh) &&
+                  (entries[first].ip_start == ip_start) &&
+                  (entries[first].ip_end == ip_end) &&
+                  (entries[first].fde == fde);
+  size_t newCount = t->count - (last - first) + 1;
+  table *newTable = NULL;
+  if (!isCached && newCount > t->capacity) {
+    size_t newCapacity = t->capacity * 4;
     // Can't use operator new (we are below it).
-    entry *newBuffer = (entry *)malloc(newSize * sizeof(entry));
-    memcpy(newBuffer, _buffer, oldSize * sizeof(entry));
-    if (_buffer != _initialBuffer)
-      free(_buffer);
-    _buffer = newBuffer;
-    _bufferUsed = &newBuffer[oldSize];
-    _bufferEnd = &newBuffer[newSize];
-  }
-  _bufferUsed->mh = mh;
-  _bufferUsed->ip_start = ip_start;
-  _bufferUsed->ip_end = ip_end;
-  _bufferUsed->fde = fde;
-  ++_bufferUsed;
+    newTable = (table *)malloc(sizeof(table) + newCapacity * sizeof(entry));
+    if (newTable == NULL) {
+      _LIBUNWIND_LOG_IF_FALSE(_lock.unlock());
+      return;
+    }
+    entry *newEntries = newTable->entries();
+    newTable->capacity = newCapacity;
+    newTable->count = newCount;
+    memcpy(newEntries, entries, first * sizeof(entry));
+    newEntries[first] = e;
+    memcpy(&newEntries[first + 1], &entries[last],
+           (t->count - last) * sizeof(entry));
+  }
+  if (!isCached) {
+    beginUpdate();
+    if (newTable != NULL) {
+      // The old table is never freed, as a lookup may still be searching it.
+      // Since tables grow geometrically, that is bounded by a fraction of
+      // the size of the current table.
+      __atomic_store_n(&_table, newTable, __ATOMIC_RELAXED);
+    } else {
+      // Shift the entries following the new one into place, in the
+      // direction which does not overwrite any we still need to move
+      size_t tail = t->count - last;
+      size_t dest = first + 1;
+      if (dest > last) {
+        for (size_t i = tail; i > 0; --i)
+          storeEntry(&entries[dest + i - 1], entries[last + i - 1]);
+      } else if (dest < last) {
+        for (size_t i = 0; i < tail; ++i)
+          storeEntry(&entries[dest + i], entries[last + i]);
+      }
+      storeEntry(&entries[first], e);
+      __atomic_store_n(&t->count, newCount, __ATOMIC_RELAXED);
+    }
+    endUpdate();
+  }
 #ifdef __APPLE__
   if (!_registeredForDyldUnloads) {
     _dyld_register_func_for_remove_image(&dyldUnloadHook);
@@ -184,15 +300,19 @@ void DwarfFDECache<A>::add(pint_t mh, pint_t ip_start, pint_t ip_end,
 template <typename A>
 void DwarfFDECache<A>::removeAllIn(pint_t mh) {
   _LIBUNWIND_LOG_IF_FALSE(_lock.lock());
-  entry *d = _buffer;
-  for (const entry *s = _buffer; s < _bufferUsed; ++s) {
+  table *t = _table;
+  entry *entries = t->entries();
+  beginUpdate();
+  entry *d = entries;
+  for (const entry *s = entries; s < &entries[t->count]; ++s) {
     if (s->mh != mh) {
       if (d != s)
-        *d = *s;
+        storeEntry(d, *s);
       ++d;
     }
   }
-  _bufferUsed = d;
+  __atomic_store_n(&t->count, (size_t)(d - entries), __ATOMIC_RELAXED);
+  endUpdate();
   _LIBUNWIND_LOG_IF_FALSE(_lock.unlock());
 }
 
@@ -207,7 +327,9 @@ template <typename A>
 void DwarfFDECache<A>::iterateCacheEntries(void (*func)(
     unw_word_t ip_start, unw_word_t ip_end, unw_word_t fde, unw_word_t mh)) {
   _LIBUNWIND_LOG_IF_FALSE(_lock.lock());
-  for (entry *p = _buffer; p < _bufferUsed; ++p) {
+  table *t = _table;
+  entry *entries = t->entries();
+  for (entry *p = entries; p < &entries[t->count]; ++p) {
     (*func)(p->ip_start, p->ip_end, p->fde, p->mh);
   }
   _LIBUNWIND_LOG_IF_FALSE(_lock.unlock());
@@ -2,12 +2,14 @@ use core::ffi::c_void;
 use core::mem;
 use core::slice;
 
-use hashbrown::{HashMap, HashSet};
+use alloc::boxed::Box;
+use alloc::vec::Vec;
+
+use hashbrown::HashSet;
 
 use once_cell::sync::OnceCell;
 
-use liblumen_arena::DroplessArena;
-use liblumen_core::symbols::FunctionSymbol;
+use liblumen_core::symbols::{DispatchTable, FunctionSymbol, PerfectHash};
 #[cfg(all(unix, target_arch = "x86_64"))]
 use liblumen_core::sys::dynamic_call;
 use liblumen_core::sys::dynamic_call::DynamicCallee;
@@ -16,7 +18,6 @@ use crate::erts::term::prelude::Atom;
 #[cfg(all(unix, target_arch = "x86_64"))]
 use crate::erts::term::prelude::{Encoded, Term};
 use crate::erts::ModuleFunctionArity;
-use liblumen_core::alloc::Layout;
 
 /// Dynamically invokes the function mapped to the given symbol.
 ///
@@ -88,11 +89,34 @@ pub fn module_loaded(module: Atom) -> bool {
 /// The symbol table used by the runtime system
 static SYMBOLS: OnceCell<SymbolTable> = OnceCell::new();
 
-/// Performs one-time initialization of the atom table at program start, using the
-/// array of constant atom values present in the compiled program.
+/// Performs one-time initialization of the dispatch table at program start, using the
+/// dispatch table generated by the compiler, which is used as-is.
 ///
 /// It is expected that this will be called by code generated by the compiler, during the
-/// earliest phase of startup, to ensure that nothing has tried to use the atom table yet.
+/// earliest phase of startup, to ensure that nothing has tried to use the dispatch table yet.
+#[no_mangle]
+pub unsafe extern "C" fn InitializeLumenStaticDispatchTable(
+    table: *const FunctionSymbol,
+    len: usize,
+    displacements: *const u64,
+    num_displacements: usize,
+    key: u64,
+) -> bool {
+    if table.is_null() || displacements.is_null() {
+        return false;
+    }
+    let entries = slice::from_raw_parts::<'static>(table, len);
+    let displacements = slice::from_raw_parts::<'static>(displacements, num_displacements);
+
+    set_symbol_table(SymbolTable::new(DispatchTable::new(
+        entries,
+        displacements,
+        key,
+    )))
+}
+
+/// Performs one-time initialization of the dispatch table from an arbitrary array of
+/// symbols, e.g. one constructed by hand in tests, by laying it out as a dispatch table.
 #[no_mangle]
 pub unsafe extern "C" fn InitializeLumenDispatchTable(
     table: *const FunctionSymbol,
@@ -103,93 +127,89 @@ pub unsafe extern "C" fn InitializeLumenDispatchTable(
     }
     let raw_table = slice::from_raw_parts::<'static>(table, len);
 
-    match SymbolTable::from_raw(raw_table) {
-        Err(err) => {
-            eprintln!("Error: {}", err);
-            false
-        }
-        Ok(sym_table) => {
-            if let Err(_) = SYMBOLS.set(sym_table) {
-                eprintln!("tried to initialize symbol table more than once!");
-                false
-            } else {
-                true
-            }
-        }
+    // The table lives for the rest of the program, so it is fine to leak it
+    let hash = PerfectHash::build(raw_table);
+    let entries = hash
+        .slots
+        .iter()
+        .map(|&i| raw_table[i])
+        .collect::<Vec<_>>()
+        .into_boxed_slice();
+    let entries: &'static [FunctionSymbol] = Box::leak(entries);
+    let displacements: &'static [u64] = Box::leak(hash.displacements.into_boxed_slice());
+
+    set_symbol_table(SymbolTable::new(DispatchTable::new(
+        entries,
+        displacements,
+        hash.key,
+    )))
+}
+
+fn set_symbol_table(table: SymbolTable) -> bool {
+    if let Err(_) = SYMBOLS.set(table) {
+        eprintln!("tried to initialize symbol table more than once!");
+        false
+    } else {
+        true
     }
 }
 
 struct SymbolTable {
-    functions: HashMap<&'static ModuleFunctionArity, *const c_void>,
-    idents: HashMap<*const c_void, &'static ModuleFunctionArity>,
-    modules: HashSet<Atom>,
-    arena: DroplessArena,
+    functions: DispatchTable<'static>,
+    // Only needed by `module_loaded`, so built on first use
+    modules: OnceCell<HashSet<Atom>>,
 }
 impl SymbolTable {
-    fn new(size: usize) -> Self {
+    fn new(functions: DispatchTable<'static>) -> Self {
         Self {
-            functions: HashMap::with_capacity(size),
-            idents: HashMap::with_capacity(size),
-            modules: HashSet::new(),
-            arena: DroplessArena::default(),
+            functions,
+            modules: OnceCell::new(),
         }
     }
 
     fn dump(&self) {
         eprintln!("START SymbolTable at {:p}", self);
-        for mfa in self.functions.keys() {
-            eprintln!("{:?}", mfa);
+        for symbol in self.functions.entries() {
+            eprintln!("{:?}", Self::ident(symbol));
         }
         eprintln!("END SymbolTable");
     }
 
-    /// Used to initialize the atom table from an array of null-terminated strings with static
-    /// lifetime, such as generated by codegen in order to initialize the atom table with
-    /// constant atom values in the compiled program. It is expected that this will be called
-    /// via `InitializeLumenAtomTable`
-    unsafe fn from_raw(raw_table: &'static [FunctionSymbol]) -> anyhow::Result<Self> {
-        let mut table = Self::new(raw_table.len());
-
-        for FunctionSymbol {
-            module,
-            function,
-            arity,
-            ptr,
-        } in raw_table.iter()
-        {
-            // This is safe because the underlying data is static
-            let module = Atom::from_id(*module);
-            let function = Atom::from_id(*function);
-            let callee = *ptr;
-            let size = mem::size_of::<ModuleFunctionArity>();
-            let align = mem::align_of::<ModuleFunctionArity>();
-            let layout = Layout::from_size_align(size, align)?;
-            let ptr = table.arena.alloc_raw(layout) as *mut ModuleFunctionArity;
-            ptr.write(ModuleFunctionArity {
-                module,
-                function,
-                arity: *arity,
-            });
-            let sym = mem::transmute::<&ModuleFunctionArity, &'static ModuleFunctionArity>(&*ptr);
-            assert_eq!(None, table.idents.insert(callee, sym));
-            assert_eq!(None, table.functions.insert(sym, callee));
-            table.modules.insert(sym.module);
+    fn ident(symbol: &FunctionSymbol) -> ModuleFunctionArity {
+        // This is safe because the atom ids in the table were assigned by the compiler
+        unsafe {
+            ModuleFunctionArity {
+                module: Atom::from_id(symbol.module),
+                function: Atom::from_id(symbol.function),
+                arity: symbol.arity,
+            }
         }
-
-        Ok(table)
     }
 
     #[allow(unused)]
-    fn get_ident(&self, function: *const c_void) -> Option<&'static ModuleFunctionArity> {
-        self.idents.get(&function).copied()
+    fn get_ident(&self, function: *const c_void) -> Option<ModuleFunctionArity> {
+        self.functions
+            .entries()
+            .iter()
+            .find(|symbol| symbol.ptr == function)
+            .map(Self::ident)
     }
 
     fn get_function(&self, ident: &ModuleFunctionArity) -> Option<*const c_void> {
-        self.functions.get(ident).copied()
+        self.functions
+            .get(ident.module.id(), ident.function.id(), ident.arity)
+            .map(|symbol| symbol.ptr)
     }
 
     fn contains_module(&self, module: Atom) -> bool {
-        self.modules.contains(&module)
+        let modules = self.modules.get_or_init(|| {
+            self.functions
+                .entries()
+                .iter()
+                .map(|symbol| unsafe { Atom::from_id(symbol.module) })
+                .collect()
+        });
+        modules.contains(&module)
     }
 }
 
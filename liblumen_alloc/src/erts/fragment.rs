@@ -326,6 +326,20 @@ impl HeapFragment {
         Self::new_map_from_hash_map(hash_map)
     }
 
+    pub fn new_map_from_shape(
+        keys: Term,
+        values: &[Term],
+    ) -> AllocResult<(Boxed<Map>, NonNull<Self>)> {
+        let values_layout = Tuple::recursive_layout_for(values);
+        let (layout, _) = values_layout.extend(Layout::new::<Map>()).unwrap();
+        let mut non_null_heap_fragment = Self::new(layout.pad_to_align())?;
+        let heap_fragment = unsafe { non_null_heap_fragment.as_mut() };
+
+        heap_fragment
+            .map_from_shape(keys, values)
+            .map(|boxed_map| (boxed_map, non_null_heap_fragment))
+    }
+
     pub fn new_reference(
         scheduler_id: scheduler::ID,
         number: ReferenceNumber,
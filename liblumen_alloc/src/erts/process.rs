@@ -579,6 +579,17 @@ impl Process {
         }
     }
 
+    /// Constructs a binary of `len` zeroed bytes, see `TermAlloc::zeroed_binary`
+    pub fn zeroed_binary(&self, len: usize) -> Term {
+        match self.acquire_heap().zeroed_binary(len) {
+            Ok(term) => term,
+            Err(_) => {
+                let zeroes = vec![0; len];
+                self.attach_fragment_or_panic(HeapFragment::new_binary_from_bytes(&zeroes))
+            }
+        }
+    }
+
     pub fn binary_from_str(&self, s: &str) -> Term {
         match self.acquire_heap().binary_from_str(s) {
             Ok(term) => term,
@@ -781,6 +792,15 @@ impl Process {
             .into()
     }
 
+    pub fn map_from_shape(&self, keys: Term, values: &[Term]) -> Term {
+        self.acquire_heap()
+            .map_from_shape(keys, values)
+            .unwrap_or_else(|_| {
+                self.attach_fragment_or_panic(HeapFragment::new_map_from_shape(keys, values))
+            })
+            .into()
+    }
+
     pub fn reference(&self, number: ReferenceNumber) -> Term {
         self.reference_from_scheduler(self.scheduler_id.lock().unwrap(), number)
     }
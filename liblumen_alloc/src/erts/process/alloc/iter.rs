@@ -3,7 +3,7 @@ use core::marker::PhantomData;
 use core::mem;
 
 use crate::erts;
-use crate::erts::term::prelude::{Closure, Encoded, HeapBin, Term};
+use crate::erts::term::prelude::{Closure, Encoded, HeapBin, Map, Term};
 
 use super::Heap;
 
@@ -40,6 +40,7 @@ where
         IterMut {
             heap: self as *const _ as *mut Self,
             pos: self.heap_start(),
+            skip: None,
             _marker: PhantomData,
         }
     }
@@ -48,6 +49,10 @@ where
 pub struct IterMut<'a, T: Heap> {
     heap: *mut T,
     pos: *mut Term,
+    /// While walking the fields of a map, the position after its last term
+    /// field, and the position of the next term, which the iterator skips to
+    /// from there, as the rest of the map does not hold terms
+    skip: Option<(*mut Term, *mut Term)>,
     _marker: PhantomData<&'a mut Term>,
 }
 unsafe impl<T: Heap + Sync> Sync for IterMut<'_, T> {}
@@ -68,6 +73,13 @@ where
         // are either on the stack, or are leaves in the reference tree,
         // and so can be skipped
         loop {
+            if let Some((fields_end, next)) = self.skip {
+                if self.pos == fields_end {
+                    self.pos = next;
+                    self.skip = None;
+                }
+            }
+
             let pos = self.pos;
             // Stop when we catch up to heap_top
             if pos < heap.heap_top() {
@@ -100,6 +112,15 @@ where
                             self.pos = unsafe { pos.add(arity) };
                         }
                         return Some(term);
+                    } else if term.is_map() {
+                        // The keys and values of a flat map follow the header, and
+                        // must be walked like the elements of a tuple, the rest of
+                        // the map is skipped once they have been
+                        let arity = term.arity() + 1;
+                        let fields_end = unsafe { pos.add(1 + Map::TERM_FIELDS) };
+                        self.pos = unsafe { pos.add(1) };
+                        self.skip = Some((fields_end, unsafe { pos.add(arity) }));
+                        return Some(term);
                     } else if term.is_heapbin() {
                         // Like closures, heap binaries are dynamically sized
                         let bin_box = unsafe { HeapBin::from_raw_term(pos) };
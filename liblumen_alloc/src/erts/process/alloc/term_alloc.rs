@@ -61,6 +61,32 @@ pub trait TermAlloc: Heap {
         }
     }
 
+    /// Constructs a binary of `len` zeroed bytes, associated with the given process, which the
+    /// caller then writes in place
+    ///
+    /// Like `binary_from_bytes`, binaries of more than 64 bytes are reference counted, which
+    /// is what allows the data to be written without it first being built elsewhere and copied.
+    fn zeroed_binary(&mut self, len: usize) -> AllocResult<Term>
+    where
+        Self: VirtualAllocator<ProcBin>,
+    {
+        if len > HeapBin::MAX_SIZE {
+            let bin = ProcBin::zeroed(len)?;
+            let bin_ptr = unsafe {
+                let ptr = self.alloc_layout(Layout::new::<ProcBin>())?.as_ptr() as *mut ProcBin;
+                ptr.write(bin);
+                Boxed::new_unchecked(ptr)
+            };
+            // Add the binary to the process's virtual binary heap
+            self.virtual_alloc(bin_ptr);
+
+            Ok(bin_ptr.into())
+        } else {
+            let zeroes = [0u8; HeapBin::MAX_SIZE];
+            self.heapbin_from_bytes(&zeroes[..len]).map(|nn| nn.into())
+        }
+    }
+
     /// Either returns a `&[u8]` to the pre-existing bytes in the heap binary, process binary, or
     /// aligned subbinary or creates a new aligned binary and returns the bytes from that new
     /// binary.
@@ -279,6 +305,17 @@ pub trait TermAlloc: Heap {
         Ok(ptr)
     }
 
+    /// Constructs a flat map with the shape `keys`, see `Map::from_shape`
+    fn map_from_shape(&mut self, keys: Term, values: &[Term]) -> AllocResult<Boxed<Map>>
+    where
+        Self: Sized,
+    {
+        let values = self.tuple_from_slice(values)?;
+        let boxed = Map::from_shape(keys, values.into()).clone_to_heap(self)?;
+        let ptr: Boxed<Map> = boxed.dyn_cast();
+        Ok(ptr)
+    }
+
     #[inline]
     fn local_pid_with_node_id(
         &mut self,
@@ -42,3 +42,39 @@ fn simple_collector_test() {
     assert_eq!(new_tuple_ref.get_element(0), Ok(atom!("hello")));
     assert_eq!(new_tuple_ref.get_element(1), Ok(atom!("world")));
 }
+
+#[test]
+fn simple_collector_flat_map_test() {
+    let mut fromspace = RegionHeap::new(default_heap_layout());
+    let young = RegionHeap::new(default_heap_layout());
+    let old = RegionHeap::new(default_heap_layout());
+    let mut tospace = SemispaceHeap::new(young, old);
+    // Allocate a flat map in fromspace, with both its shape and values on the heap
+    let keys = fromspace
+        .tuple_from_slice(&[atom!("hello"), atom!("world")])
+        .unwrap();
+    let map = fromspace
+        .map_from_shape(keys.into(), &[fixnum!(1), fixnum!(2)])
+        .unwrap();
+
+    let map_ptr: *mut Term = map.as_ptr() as *mut Term;
+    let mut map_root: Term = map_ptr.into();
+
+    let mut roots = RootSet::new(&mut []);
+    roots.push(&mut map_root);
+    let sweeper = MinorCollection::new(&mut fromspace, &mut tospace);
+    let mut collector = SimpleCollector::new(roots, sweeper);
+    collector.garbage_collect().unwrap();
+
+    // The map, its shape and its values must all have been moved
+    let new_map_ptr: *mut Term = map_root.dyn_cast();
+    assert_ne!(map_ptr, new_map_ptr);
+    assert!(tospace.young_generation().contains(new_map_ptr));
+    let new_map = unsafe { &*(new_map_ptr as *const Map) };
+    let (new_keys, new_values) = new_map.flat_entries().unwrap();
+    assert!(tospace.young_generation().contains(new_keys.as_ptr()));
+    assert!(tospace.young_generation().contains(new_values.as_ptr()));
+    assert_eq!(new_keys, &[atom!("hello"), atom!("world")]);
+    assert_eq!(new_values, &[fixnum!(1), fixnum!(2)]);
+    assert_eq!(new_map.get(atom!("world")), Some(fixnum!(2)));
+}
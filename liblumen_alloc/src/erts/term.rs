@@ -45,7 +45,7 @@ pub mod prelude {
         Cons, HeaplessListBuilder, ImproperList, ImproperListError, List, ListBuilder,
         MaybeImproper,
     };
-    pub use super::map::Map;
+    pub use super::map::{Map, MAX_FLAT_MAP_SIZE};
     pub use super::pid::{AnyPid, ExternalPid, InvalidPidError, Pid};
     pub use super::port::{ExternalPort, Port};
     pub use super::reference::{ExternalReference, Reference, ReferenceNumber};
@@ -76,7 +76,7 @@ impl RawTerm {
     }
 
     #[inline]
-    fn encode_literal<T: ?Sized>(value: *const T) -> Self {
+    pub(crate) fn encode_literal<T: ?Sized>(value: *const T) -> Self {
         Self(Encoding::encode_literal(value))
     }
 
@@ -127,34 +127,56 @@ impl ProcBin {
 
     /// Creates a new procbin from a raw byte slice, by copying it to the heap
     pub fn from_slice(s: &[u8], encoding: Encoding) -> AllocResult<Self> {
+        unsafe {
+            let (bin, data_ptr) = Self::alloc(s.len(), encoding)?;
+            ptr::copy_nonoverlapping(s.as_ptr(), data_ptr, s.len());
+
+            Ok(bin)
+        }
+    }
+
+    /// Creates a new procbin of `len` zeroed bytes, which the caller may then write in place,
+    /// as long as the procbin has not been shared
+    pub fn zeroed(len: usize) -> AllocResult<Self> {
+        unsafe {
+            let (bin, data_ptr) = Self::alloc(len, Encoding::Raw)?;
+            ptr::write_bytes(data_ptr, 0, len);
+
+            Ok(bin)
+        }
+    }
+
+    /// Allocates a procbin with room for `len` bytes of data, returning it along with a pointer
+    /// to its data, which is left uninitialized
+    unsafe fn alloc(len: usize, encoding: Encoding) -> AllocResult<(Self, *mut u8)> {
         use liblumen_core::sys::alloc as sys_alloc;
 
         let (base_layout, flags_offset) = ProcBinInner::base_layout();
-        let (unpadded_layout, data_offset) = base_layout.extend(Layout::for_value(s)).unwrap();
+        let (unpadded_layout, data_offset) = base_layout
+            .extend(Layout::array::<u8>(len).unwrap())
+            .unwrap();
         // We pad to alignment so that the Layout produced here
         // matches that returned by `Layout::for_value` on the
         // final `ProcBinInner`
         let layout = unpadded_layout.pad_to_align();
 
-        unsafe {
-            let non_null_byte_slice = sys_alloc::allocate(layout)?;
-            let len = s.len();
-
-            let ptr: *mut u8 = non_null_byte_slice.as_mut_ptr();
-            ptr::write(ptr as *mut AtomicUsize, AtomicUsize::new(1));
-            let flags_ptr = ptr.offset(flags_offset as isize) as *mut BinaryFlags;
-            let flags = BinaryFlags::new(encoding).set_size(len);
-            ptr::write(flags_ptr, flags);
-            let data_ptr = ptr.offset(data_offset as isize);
-            ptr::copy_nonoverlapping(s.as_ptr(), data_ptr, len);
-
-            let inner = ProcBinInner::from_raw_parts(ptr, len);
-            Ok(Self {
-                header: Default::default(),
-                inner: inner.into(),
-                link: LinkedListLink::new(),
-            })
-        }
+        let non_null_byte_slice = sys_alloc::allocate(layout)?;
+
+        let ptr: *mut u8 = non_null_byte_slice.as_mut_ptr();
+        ptr::write(ptr as *mut AtomicUsize, AtomicUsize::new(1));
+        let flags_ptr = ptr.offset(flags_offset as isize) as *mut BinaryFlags;
+        let flags = BinaryFlags::new(encoding).set_size(len);
+        ptr::write(flags_ptr, flags);
+        let data_ptr = ptr.offset(data_offset as isize);
+
+        let inner = ProcBinInner::from_raw_parts(ptr, len);
+        let bin = Self {
+            header: Default::default(),
+            inner: inner.into(),
+            link: LinkedListLink::new(),
+        };
+
+        Ok((bin, data_ptr))
     }
 
     #[inline]
@@ -9,7 +9,6 @@ use alloc::sync::Arc;
 
 use std::backtrace::Backtrace;
 
-use hashbrown::HashMap;
 use thiserror::Error;
 
 use liblumen_term::{Encoding as TermEncoding, Tag};
@@ -244,12 +243,12 @@ impl<T: ?Sized> Debug for Header<T> {
 }
 const_assert_eq!(mem::size_of::<Header<usize>>(), mem::size_of::<usize>());
 impl Header<Map> {
-    pub fn from_map(map: &HashMap<Term, Term>) -> Self {
+    /// Every map has the same size, as the entries of a flat map are held in
+    /// separate tuples, and those of a hashed map in a table outside of the heap
+    pub fn from_map() -> Self {
         let header_layout = Layout::new::<Self>();
-        let value_layout = Layout::for_value(map);
-        let (layout, _value_offset) = header_layout.extend(value_layout).unwrap();
-        // subtract the header layout size in words instead of just not including it as `extend`
-        // adds padding for field alignment.
+        let layout = Layout::new::<Map>();
+        // the arity does not include the header itself
         let arity = Self::to_word_size(layout.size()) - Self::to_word_size(header_layout.size());
         let value = Term::encode_header(arity.try_into().unwrap(), Term::HEADER_MAP);
         Self {
@@ -40,6 +40,16 @@ impl BigInteger {
         Some(Self::new(bi))
     }
 
+    /// Moves this value out of any process heap, returning a literal term
+    /// which refers to it
+    ///
+    /// The allocation is never freed, so this is only intended for constants
+    /// which live for the remainder of the program
+    pub fn into_literal(self) -> Term {
+        let ptr = Box::into_raw(Box::new(self));
+        Term::encode_literal(ptr as *const BigInteger)
+    }
+
     /// Returns the number of one bits in the byte representation
     ///
     /// NOTE: The byte representation of BigInt is compacting, and
@@ -3,8 +3,10 @@ use core::cmp;
 use core::convert::{TryFrom, TryInto};
 use core::fmt::{self, Debug, Display, Write};
 use core::hash::{Hash, Hasher};
+use core::iter::Zip;
 use core::mem;
 use core::ptr;
+use core::slice;
 
 use alloc::vec::Vec;
 
@@ -16,22 +18,63 @@ use crate::erts::process::alloc::TermAlloc;
 
 use super::prelude::*;
 
+/// The largest number of entries a flat map may have, as in OTP, maps of up to
+/// this size are cheaper to search linearly than to hash
+pub const MAX_FLAT_MAP_SIZE: usize = 32;
+
+/// A map is either flat or hashed.
+///
+/// A flat map is made up of a tuple of its keys, in ascending order, and a tuple of
+/// its values, in the same order. The tuple of keys is its shape, which is shared
+/// by every map with the same set of keys, so a flat map can be searched by comparing
+/// its shape to a known one, then indexing into its values directly. Generated code
+/// does exactly that when the keys of a map are known at compile time.
+///
+/// Any other map stores its entries in a hash table.
+///
+/// NOTE: The offsets of `keys` and `values` are relied upon by generated code, see
+/// `MapOpConversions.cpp` in the compiler
 #[derive(Clone)]
 #[repr(C)]
 pub struct Map {
     header: Header<Map>,
+    /// The shape of a flat map, otherwise `Term::NONE`
+    keys: Term,
+    /// The values of a flat map, otherwise `Term::NONE`
+    values: Term,
+    /// The entries of a hashed map, this is empty for a flat map
     value: HashMap<Term, Term>,
 }
 
 impl Map {
+    /// The number of words after the header which hold terms, `keys` and `values`,
+    /// these are walked by the garbage collector, the rest of the map is not
+    pub(in crate::erts) const TERM_FIELDS: usize = 2;
+
     pub(in crate::erts) fn from_hash_map(value: HashMap<Term, Term>) -> Self {
         Self {
-            header: Header::from_map(&value),
+            header: Header::from_map(),
+            keys: Term::NONE,
+            values: Term::NONE,
             value,
         }
     }
 
-    pub(in crate::erts) fn from_slice(slice: &[(Term, Term)]) -> Self {
+    /// Constructs a flat map from a tuple of keys and a tuple of values, see `Map`
+    ///
+    /// The keys must be unique, in ascending order, and there must be the same number
+    /// of values. The keys should be a literal, so that they remain shared with other
+    /// maps of the same shape when this map is copied to another heap.
+    pub fn from_shape(keys: Term, values: Term) -> Self {
+        Self {
+            header: Header::from_map(),
+            keys,
+            values,
+            value: HashMap::new(),
+        }
+    }
+
+    pub fn from_slice(slice: &[(Term, Term)]) -> Self {
         let mut value: HashMap<Term, Term> = HashMap::with_capacity(slice.len());
 
         for (entry_key, entry_value) in slice {
@@ -41,6 +84,17 @@ impl Map {
         Self::from_hash_map(value)
     }
 
+    /// Moves this value out of any process heap, returning a literal term
+    /// which refers to it
+    ///
+    /// The allocation is never freed, so this is only intended for constants
+    /// which live for the remainder of the program, the keys and values must
+    /// be literals themselves
+    pub fn into_literal(self) -> Term {
+        let ptr = Box::into_raw(Box::new(self));
+        Term::encode_literal(ptr as *const Map)
+    }
+
     pub fn from_list(list: Term) -> InternalResult<HashMap<Term, Term>> {
         match list.decode()? {
             TypedTerm::Nil => Ok(HashMap::new()),
@@ -82,13 +136,32 @@ impl Map {
         }
     }
 
+    /// Returns the shape of this map if it is flat, see `Map`
+    #[inline]
+    pub fn shape(&self) -> Option<Term> {
+        if self.keys.is_none() {
+            None
+        } else {
+            Some(self.keys)
+        }
+    }
+
+    /// Returns the keys of this map and its values, in the same order, if it is flat
+    pub fn flat_entries(&self) -> Option<(&[Term], &[Term])> {
+        self.shape()
+            .map(|keys| unsafe { (tuple_elements(keys), tuple_elements(self.values)) })
+    }
+
     pub fn get(&self, key: Term) -> Option<Term> {
-        self.value.get(&key).copied()
+        match self.flat_entries() {
+            Some((keys, values)) => keys.iter().position(|k| *k == key).map(|i| values[i]),
+            None => self.value.get(&key).copied(),
+        }
     }
 
     pub fn take(&self, key: Term) -> Option<(Term, HashMap<Term, Term>)> {
         if self.is_key(key) {
-            let mut map = self.value.clone();
+            let mut map = self.to_hash_map();
             let value = map.remove(&key).unwrap();
 
             Some((value, map))
@@ -98,24 +171,30 @@ impl Map {
     }
 
     pub fn is_key(&self, key: Term) -> bool {
-        self.value.contains_key(&key)
+        match self.flat_entries() {
+            Some((keys, _)) => keys.contains(&key),
+            None => self.value.contains_key(&key),
+        }
     }
 
     pub fn keys(&self) -> Vec<Term> {
-        self.value.keys().into_iter().copied().collect()
+        self.iter().map(|(key, _)| *key).collect()
     }
 
     pub fn values(&self) -> Vec<Term> {
-        self.value.values().into_iter().copied().collect()
+        self.iter().map(|(_, value)| *value).collect()
     }
 
     pub fn len(&self) -> usize {
-        self.value.len()
+        match self.flat_entries() {
+            Some((keys, _)) => keys.len(),
+            None => self.value.len(),
+        }
     }
 
     pub fn remove(&self, key: Term) -> Option<HashMap<Term, Term>> {
         if self.is_key(key) {
-            let mut map = self.value.clone();
+            let mut map = self.to_hash_map();
             map.remove(&key);
             Some(map)
         } else {
@@ -125,7 +204,7 @@ impl Map {
 
     pub fn update(&self, key: Term, value: Term) -> Option<HashMap<Term, Term>> {
         if self.is_key(key) {
-            let mut map = self.value.clone();
+            let mut map = self.to_hash_map();
             map.insert(key, value);
             Some(map)
         } else {
@@ -137,40 +216,101 @@ impl Map {
         if self.get(key).map_or(false, |val| val == value) {
             None
         } else {
-            let mut map = self.value.clone();
+            let mut map = self.to_hash_map();
             map.insert(key, value);
             Some(map)
         }
     }
 
-    pub fn iter(&self) -> hashbrown::hash_map::Iter<Term, Term> {
-        self.value.iter()
+    pub fn iter(&self) -> Iter {
+        match self.flat_entries() {
+            Some((keys, values)) => Iter::Flat(keys.iter().zip(values.iter())),
+            None => Iter::Hashed(self.value.iter()),
+        }
     }
 
-    pub fn iter_mut(&mut self) -> hashbrown::hash_map::IterMut<Term, Term> {
-        self.value.iter_mut()
+    pub fn iter_mut(&mut self) -> IterMut {
+        match self.shape() {
+            Some(keys) => unsafe {
+                let keys = tuple_elements(keys);
+                let values = tuple_elements_mut(self.values);
+                IterMut::Flat(keys.iter().zip(values.iter_mut()))
+            },
+            None => IterMut::Hashed(self.value.iter_mut()),
+        }
+    }
+
+    /// Copies the entries of this map into a new hash table
+    pub fn to_hash_map(&self) -> HashMap<Term, Term> {
+        match self.flat_entries() {
+            Some((keys, values)) => keys.iter().copied().zip(values.iter().copied()).collect(),
+            None => self.value.clone(),
+        }
     }
 
     // Private
 
     fn sorted_keys(&self) -> Vec<Term> {
-        let mut key_vec: Vec<Term> = Vec::new();
-        key_vec.extend(self.value.keys());
+        let mut key_vec: Vec<Term> = self.keys();
         key_vec.sort_unstable_by(|key1, key2| key1.cmp(&key2));
 
         key_vec
     }
 }
 
-impl AsRef<HashMap<Term, Term>> for Boxed<Map> {
-    fn as_ref(&self) -> &HashMap<Term, Term> {
-        &self.as_ref().value
+/// Returns the elements of the tuple `term`, which outlive the borrow of any map
+/// which refers to it
+unsafe fn tuple_elements<'a>(term: Term) -> &'a [Term] {
+    let tuple: Boxed<Tuple> = term.decode().unwrap().try_into().unwrap();
+    &*(tuple.as_ref().elements() as *const [Term])
+}
+
+unsafe fn tuple_elements_mut<'a>(term: Term) -> &'a mut [Term] {
+    let mut tuple: Boxed<Tuple> = term.decode().unwrap().try_into().unwrap();
+    &mut *(tuple.as_mut().elements_mut() as *mut [Term])
+}
+
+pub enum Iter<'a> {
+    Flat(Zip<slice::Iter<'a, Term>, slice::Iter<'a, Term>>),
+    Hashed(hashbrown::hash_map::Iter<'a, Term, Term>),
+}
+impl<'a> Iterator for Iter<'a> {
+    type Item = (&'a Term, &'a Term);
+
+    fn next(&mut self) -> Option<Self::Item> {
+        match self {
+            Self::Flat(iter) => iter.next(),
+            Self::Hashed(iter) => iter.next(),
+        }
     }
+
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        match self {
+            Self::Flat(iter) => iter.size_hint(),
+            Self::Hashed(iter) => iter.size_hint(),
+        }
+    }
+}
+
+pub enum IterMut<'a> {
+    Flat(Zip<slice::Iter<'a, Term>, slice::IterMut<'a, Term>>),
+    Hashed(hashbrown::hash_map::IterMut<'a, Term, Term>),
 }
+impl<'a> Iterator for IterMut<'a> {
+    type Item = (&'a Term, &'a mut Term);
 
-impl AsRef<HashMap<Term, Term>> for Map {
-    fn as_ref(&self) -> &HashMap<Term, Term> {
-        &self.value
+    fn next(&mut self) -> Option<Self::Item> {
+        match self {
+            Self::Flat(iter) => iter.next(),
+            Self::Hashed(iter) => iter.next(),
+        }
+    }
+
+    fn size_hint(&self) -> (usize, Option<usize>) {
+        match self {
+            Self::Flat(iter) => iter.size_hint(),
+            Self::Hashed(iter) => iter.size_hint(),
+        }
     }
 }
 
@@ -191,9 +331,22 @@ impl crate::borrow::CloneToProcess for Map {
             heap_value.insert(heap_entry_key, heap_entry_value);
         }
 
+        // The shape of a flat map is normally a literal, in which case it is
+        // shared rather than copied, a hashed map has neither
+        let (heap_keys, heap_values) = if self.shape().is_some() {
+            (
+                self.keys.clone_to_heap(heap)?,
+                self.values.clone_to_heap(heap)?,
+            )
+        } else {
+            (Term::NONE, Term::NONE)
+        };
+
         // Clone to ensure `value` remains valid if caller is dropped
         let heap_self = Self {
             header: self.header.clone(),
+            keys: heap_keys,
+            values: heap_values,
             value: heap_value,
         };
 
@@ -208,7 +361,16 @@ impl crate::borrow::CloneToProcess for Map {
     }
 
     fn size_in_words(&self) -> usize {
-        crate::erts::to_word_size(Layout::for_value(self).size())
+        let mut size = crate::erts::to_word_size(Layout::for_value(self).size());
+
+        if let Some(keys) = self.shape() {
+            if !keys.is_literal() {
+                size += keys.size_in_words();
+            }
+            size += self.values.size_in_words();
+        }
+
+        size
     }
 }
 
@@ -216,6 +378,8 @@ impl Debug for Map {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         f.debug_struct("Map")
             .field("header", &self.header)
+            .field("keys", &self.keys)
+            .field("values", &self.values)
             .field("value", &self.value)
             .finish()
     }
@@ -244,7 +408,7 @@ impl Eq for Map {}
 impl Hash for Map {
     fn hash<H: Hasher>(&self, state: &mut H) {
         for key in self.sorted_keys() {
-            let value = self.value[&key];
+            let value = self.get(key).unwrap();
 
             key.hash(state);
             value.hash(state);
@@ -254,7 +418,16 @@ impl Hash for Map {
 
 impl PartialEq for Map {
     fn eq(&self, other: &Map) -> bool {
-        self.value.eq(&other.value)
+        if let (Some(keys), Some(other_keys)) = (self.shape(), other.shape()) {
+            if keys == other_keys {
+                return self.flat_entries().unwrap().1 == other.flat_entries().unwrap().1;
+            }
+        }
+
+        self.len() == other.len()
+            && self
+                .iter()
+                .all(|(key, value)| other.get(*key) == Some(*value))
     }
 }
 impl<T> PartialEq<Boxed<T>> for Map
@@ -294,16 +467,10 @@ impl Ord for Map {
 
                 match self_key_vec.cmp(&other_key_vec) {
                     cmp::Ordering::Equal => {
-                        let self_value = &self.value;
-                        let other_value = &other.value;
                         let mut final_ordering = cmp::Ordering::Equal;
 
                         for key in self_key_vec {
-                            match self_value
-                                .get(&key)
-                                .unwrap()
-                                .cmp(other_value.get(&key).unwrap())
-                            {
+                            match self.get(key).unwrap().cmp(&other.get(key).unwrap()) {
                                 cmp::Ordering::Equal => continue,
                                 ordering => {
                                     final_ordering = ordering;
@@ -333,3 +500,65 @@ impl TryFrom<TypedTerm> for Boxed<Map> {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use crate::borrow::CloneToProcess;
+    use crate::erts::testing::RegionHeap;
+
+    mod clone_to_heap {
+        use super::*;
+
+        #[test]
+        fn hashed_map() {
+            let mut heap = RegionHeap::default();
+            let key = Atom::str_to_term("key");
+            let map = heap.map_from_slice(&[(key, fixnum!(1))]).unwrap();
+
+            assert_eq!(map.shape(), None);
+
+            let mut other_heap = RegionHeap::default();
+            let term: Term = map.into();
+            let copy: Boxed<Map> = term.clone_to_heap(&mut other_heap).unwrap().dyn_cast();
+
+            assert_eq!(copy.shape(), None);
+            assert_eq!(copy.get(key), Some(fixnum!(1)));
+            assert_eq!(*copy, *map);
+
+            let (fragment_term, _fragment) = term.clone_to_fragment().unwrap();
+            let fragment_copy: Boxed<Map> = fragment_term.dyn_cast();
+
+            assert_eq!(*fragment_copy, *map);
+        }
+
+        #[test]
+        fn flat_map() {
+            let mut heap = RegionHeap::default();
+            let a = Atom::str_to_term("a");
+            let b = Atom::str_to_term("b");
+            let keys = heap.tuple_from_slice(&[a, b]).unwrap();
+            let map = heap
+                .map_from_shape(keys.into(), &[fixnum!(1), fixnum!(2)])
+                .unwrap();
+
+            assert_eq!(map.shape(), Some(keys.into()));
+
+            let mut other_heap = RegionHeap::default();
+            let term: Term = map.into();
+            let copy: Boxed<Map> = term.clone_to_heap(&mut other_heap).unwrap().dyn_cast();
+
+            assert!(copy.shape().is_some());
+            assert_eq!(copy.get(a), Some(fixnum!(1)));
+            assert_eq!(copy.get(b), Some(fixnum!(2)));
+            assert_eq!(*copy, *map);
+
+            let (fragment_term, _fragment) = term.clone_to_fragment().unwrap();
+            let fragment_copy: Boxed<Map> = fragment_term.dyn_cast();
+
+            assert_eq!(fragment_copy.get(b), Some(fixnum!(2)));
+            assert_eq!(*fragment_copy, *map);
+        }
+    }
+}
@@ -1,7 +1,10 @@
+use core::cmp::Reverse;
 use core::ffi::c_void;
 #[cfg(all(unix, target_arch = "x86_64"))]
 use core::mem;
 
+use core_alloc::vec::Vec;
+
 #[cfg(all(unix, target_arch = "x86_64"))]
 use crate::sys::dynamic_call::{self, DynamicCallee};
 
@@ -83,3 +86,256 @@ impl FunctionSymbol {
 // It is safe to do so, since the data is static and lives for the life of the program
 unsafe impl Sync for FunctionSymbol {}
 unsafe impl Send for FunctionSymbol {}
+
+/// A read-only dispatch table, indexed by a minimal perfect hash of the
+/// (module, function, arity) key of each symbol
+///
+/// The compiler places every entry of the table in its hashed slot, and emits
+/// the hash parameters alongside it, so the runtime can use the table as-is,
+/// with no initialization, and a lookup is a single probe into the entries.
+///
+/// The hash follows the "hash, displace, and compress" scheme: keys are
+/// divided into small buckets, and each bucket gets a pair of displacements,
+/// chosen at build time so that the keys of all buckets land in distinct slots.
+#[derive(Clone, Copy)]
+pub struct DispatchTable<'a> {
+    entries: &'a [FunctionSymbol],
+    displacements: &'a [u64],
+    key: u64,
+}
+impl<'a> DispatchTable<'a> {
+    /// Creates a table from entries laid out by `PerfectHash::build`
+    pub const fn new(entries: &'a [FunctionSymbol], displacements: &'a [u64], key: u64) -> Self {
+        Self {
+            entries,
+            displacements,
+            key,
+        }
+    }
+
+    /// Returns all of the entries in the table, in slot order
+    #[inline]
+    pub fn entries(&self) -> &'a [FunctionSymbol] {
+        self.entries
+    }
+
+    /// Returns the entry for the given key, if present
+    pub fn get(&self, module: usize, function: usize, arity: u8) -> Option<&'a FunctionSymbol> {
+        if self.entries.is_empty() {
+            return None;
+        }
+        let hashes = SymbolHashes::new(module, function, arity, self.key);
+        let bucket = (hashes.g as usize) % self.displacements.len();
+        let index = hashes.slot(self.displacements[bucket], self.entries.len());
+        let entry = &self.entries[index];
+        if entry.module == module && entry.function == function && entry.arity == arity {
+            Some(entry)
+        } else {
+            None
+        }
+    }
+}
+
+/// The hash parameters chosen for a set of symbols by `PerfectHash::build`
+pub struct PerfectHash {
+    /// The seed of the hash function
+    pub key: u64,
+    /// The displacements of each bucket, with the first displacement in the
+    /// high 32 bits, and the second in the low 32 bits
+    pub displacements: Vec<u64>,
+    /// For each slot of the table, the index of the symbol placed in it
+    pub slots: Vec<usize>,
+}
+impl PerfectHash {
+    /// The average number of keys per bucket
+    const LAMBDA: usize = 5;
+
+    /// Chooses a perfect hash for the given symbols, which must be unique
+    ///
+    /// This is deterministic, so the same set of symbols, in the same order,
+    /// always produces the same table.
+    ///
+    /// Panics if two symbols have the same module, function and arity, as no
+    /// seed could ever place them in different slots.
+    pub fn build(symbols: &[FunctionSymbol]) -> Self {
+        let mut keys = symbols
+            .iter()
+            .map(|s| (s.module, s.function, s.arity))
+            .collect::<Vec<_>>();
+        keys.sort_unstable();
+        for pair in keys.windows(2) {
+            assert!(
+                pair[0] != pair[1],
+                "duplicate symbol in dispatch table (module = {}, function = {}, arity = {})",
+                pair[0].0,
+                pair[0].1,
+                pair[0].2
+            );
+        }
+
+        let mut key = 0x9e37_79b9_7f4a_7c15;
+        loop {
+            if let Some(hash) = Self::try_build(symbols, key) {
+                return hash;
+            }
+            key = mix(key.wrapping_add(1));
+        }
+    }
+
+    fn try_build(symbols: &[FunctionSymbol], key: u64) -> Option<Self> {
+        let table_len = symbols.len();
+        if table_len == 0 {
+            return Some(Self {
+                key,
+                displacements: Vec::new(),
+                slots: Vec::new(),
+            });
+        }
+
+        let hashes = symbols
+            .iter()
+            .map(|s| SymbolHashes::new(s.module, s.function, s.arity, key))
+            .collect::<Vec<_>>();
+
+        let buckets_len = (table_len + Self::LAMBDA - 1) / Self::LAMBDA;
+        let mut buckets = (0..buckets_len).map(|_| Vec::new()).collect::<Vec<_>>();
+        for (i, hash) in hashes.iter().enumerate() {
+            buckets[(hash.g as usize) % buckets_len].push(i);
+        }
+
+        // Place the largest buckets first, while the table is mostly empty
+        let mut order = (0..buckets_len).collect::<Vec<_>>();
+        order.sort_by_key(|&bucket| Reverse(buckets[bucket].len()));
+
+        let mut displacements = vec![0u64; buckets_len];
+        let mut slots: Vec<Option<usize>> = vec![None; table_len];
+        // Tracks the slots claimed by the displacement currently being tried,
+        // by storing the generation of the attempt which claimed them
+        let mut claimed = vec![0u64; table_len];
+        let mut generation = 0u64;
+        let mut placed = Vec::with_capacity(Self::LAMBDA);
+
+        'buckets: for bucket in order {
+            let keys = &buckets[bucket];
+            for d1 in 0..(table_len as u32) {
+                'displacements: for d2 in 0..(table_len as u32) {
+                    let displacement = ((d1 as u64) << 32) | (d2 as u64);
+                    generation += 1;
+                    placed.clear();
+                    for &i in keys.iter() {
+                        let slot = hashes[i].slot(displacement, table_len);
+                        if slots[slot].is_some() || claimed[slot] == generation {
+                            continue 'displacements;
+                        }
+                        claimed[slot] = generation;
+                        placed.push((slot, i));
+                    }
+                    displacements[bucket] = displacement;
+                    for &(slot, i) in placed.iter() {
+                        slots[slot] = Some(i);
+                    }
+                    continue 'buckets;
+                }
+            }
+            // No displacement works for this bucket, try another seed
+            return None;
+        }
+
+        Some(Self {
+            key,
+            displacements,
+            slots: slots.into_iter().map(|slot| slot.unwrap()).collect(),
+        })
+    }
+}
+
+/// The hashes of a symbol key: `g` selects the bucket, and `f1`/`f2` are
+/// combined with the bucket displacements to select the slot
+struct SymbolHashes {
+    g: u32,
+    f1: u32,
+    f2: u32,
+}
+impl SymbolHashes {
+    #[inline]
+    fn new(module: usize, function: usize, arity: u8, key: u64) -> Self {
+        let h1 = mix(key ^ (module as u64));
+        let h2 = mix(h1 ^ (function as u64));
+        let h3 = mix(h2 ^ (arity as u64));
+        Self {
+            g: (h3 >> 32) as u32,
+            f1: h3 as u32,
+            f2: (mix(h3) >> 32) as u32,
+        }
+    }
+
+    #[inline]
+    fn slot(&self, displacement: u64, table_len: usize) -> usize {
+        let d1 = (displacement >> 32) as u32;
+        let d2 = displacement as u32;
+        let slot = d2
+            .wrapping_add(self.f1.wrapping_mul(d1))
+            .wrapping_add(self.f2);
+        (slot as usize) % table_len
+    }
+}
+
+/// The 64-bit finalizer from MurmurHash3
+#[inline]
+fn mix(mut x: u64) -> u64 {
+    x ^= x >> 33;
+    x = x.wrapping_mul(0xff51_afd7_ed55_8ccd);
+    x ^= x >> 33;
+    x = x.wrapping_mul(0xc4ce_b9fe_1a85_ec53);
+    x ^= x >> 33;
+    x
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use core::ptr;
+
+    fn symbol(module: usize, function: usize, arity: u8) -> FunctionSymbol {
+        FunctionSymbol {
+            module,
+            function,
+            arity,
+            ptr: ptr::null(),
+        }
+    }
+
+    #[test]
+    fn dispatch_table_finds_every_symbol() {
+        let mut symbols = Vec::new();
+        for module in 0..20 {
+            for function in 100..150 {
+                symbols.push(symbol(module, function, (function % 4) as u8));
+            }
+        }
+        let hash = PerfectHash::build(&symbols);
+        let entries = hash.slots.iter().map(|&i| symbols[i]).collect::<Vec<_>>();
+        let table = DispatchTable::new(&entries, &hash.displacements, hash.key);
+
+        for s in symbols.iter() {
+            assert!(table.get(s.module, s.function, s.arity) == Some(s));
+        }
+        assert!(table.get(0, 100, 1).is_none());
+        assert!(table.get(20, 100, 0).is_none());
+    }
+
+    #[test]
+    #[should_panic(expected = "duplicate symbol in dispatch table")]
+    fn perfect_hash_rejects_duplicate_symbols() {
+        let symbols = [symbol(0, 100, 1), symbol(1, 100, 1), symbol(0, 100, 1)];
+        PerfectHash::build(&symbols);
+    }
+
+    #[test]
+    fn empty_dispatch_table_finds_nothing() {
+        let hash = PerfectHash::build(&[]);
+        let table = DispatchTable::new(&[], &hash.displacements, hash.key);
+        assert!(table.get(0, 0, 0).is_none());
+    }
+}
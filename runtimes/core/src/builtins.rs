@@ -1,9 +1,14 @@
 use std::convert::TryInto;
+use std::ffi::c_void;
 use std::panic;
+use std::ptr;
 
 use hashbrown::HashMap;
 
+use liblumen_alloc::erts::apply::find_symbol;
+use liblumen_alloc::erts::process::alloc::TermAlloc;
 use liblumen_alloc::erts::term::{binary, prelude::*};
+use liblumen_alloc::{Arity, ModuleFunctionArity};
 use liblumen_core::sys::Endianness;
 
 use crate::process::current_process;
@@ -34,11 +39,126 @@ pub extern "C" fn builtin_bigint_from_cstr(ptr: *const u8, size: usize) -> Term
     current_process().integer(value)
 }
 
+#[export_name = "__lumen_builtin_bigint_literal_from_cstr"]
+pub extern "C" fn builtin_bigint_literal_from_cstr(ptr: *const u8, size: usize) -> Term {
+    let bytes = unsafe { core::slice::from_raw_parts(ptr, size) };
+    BigInteger::from_bytes(bytes).unwrap().into_literal()
+}
+
+/// Constructs a map literal from a constant array of `len` key/value pairs,
+/// laid out as `[key0, value0, key1, value1, ..]`
+#[export_name = "__lumen_builtin_map_literal_from_slice"]
+pub extern "C" fn builtin_map_literal_from_slice(ptr: *const Term, len: usize) -> Term {
+    let elements = unsafe { core::slice::from_raw_parts(ptr, len * 2) };
+    let pairs = elements
+        .chunks_exact(2)
+        .map(|pair| (pair[0], pair[1]))
+        .collect::<Vec<_>>();
+    Map::from_slice(pairs.as_slice()).into_literal()
+}
+
+/// Constructs a flat map literal from the literal tuples `keys` and `values`,
+/// see `Map::from_shape`
+#[export_name = "__lumen_builtin_map_literal_from_shape"]
+pub extern "C" fn builtin_map_literal_from_shape(keys: Term, values: Term) -> Term {
+    Map::from_shape(keys, values).into_literal()
+}
+
 #[export_name = "__lumen_builtin_map.new"]
 pub extern "C" fn builtin_map_new() -> Term {
     current_process().map_from_hash_map(HashMap::default())
 }
 
+/// Constructs a map from a buffer of `len` key/value pairs, laid out as
+/// `[key0, value0, key1, value1, ..]`, with a single allocation
+#[export_name = "__lumen_builtin_map.from_slice"]
+pub extern "C" fn builtin_map_from_slice(ptr: *const Term, len: usize) -> Term {
+    let elements = unsafe { core::slice::from_raw_parts(ptr, len * 2) };
+    let mut value = HashMap::with_capacity(len);
+    for pair in elements.chunks_exact(2) {
+        value.insert(pair[0], pair[1]);
+    }
+    current_process().map_from_hash_map(value)
+}
+
+/// Constructs a flat map with the shape `keys`, from a buffer of `len` values
+/// in the same order as the keys, see `Map::from_shape`
+#[export_name = "__lumen_builtin_map.from_shape"]
+pub extern "C" fn builtin_map_from_shape(keys: Term, ptr: *const Term, len: usize) -> Term {
+    let values = unsafe { core::slice::from_raw_parts(ptr, len) };
+    current_process().map_from_shape(keys, values)
+}
+
+/// An insert (`=>`) or update (`:=`) applied by `__lumen_builtin_map.update_many`
+#[repr(C)]
+pub struct MapAction {
+    /// 0 for an insert, 1 for an update
+    kind: usize,
+    key: Term,
+    value: Term,
+}
+
+/// Applies `len` actions to `map`, in order, constructing the resulting map with a single
+/// allocation.
+///
+/// If `map` is not a map, or an update refers to a key which doesn't exist, returns
+/// `Term::NONE`, and writes the offending key to `bad_key`
+#[export_name = "__lumen_builtin_map.update_many"]
+pub extern "C" fn builtin_map_update_many(
+    map: Term,
+    actions: *const MapAction,
+    len: usize,
+    bad_key: *mut Term,
+) -> Term {
+    let actions = unsafe { core::slice::from_raw_parts(actions, len) };
+    let decoded_map: Result<Boxed<Map>, _> = map.decode().unwrap().try_into();
+    let mut value = match decoded_map {
+        Ok(m) => {
+            // Updating existing keys of a flat map preserves its shape
+            if let Some((keys, values)) = m.flat_entries() {
+                let mut new_values = values.to_vec();
+                let all_updated = actions.iter().all(|action| {
+                    match keys.iter().position(|key| *key == action.key) {
+                        Some(i) => {
+                            new_values[i] = action.value;
+                            true
+                        }
+                        None => false,
+                    }
+                });
+                if all_updated {
+                    let shape = m.shape().unwrap();
+                    return current_process().map_from_shape(shape, new_values.as_slice());
+                }
+            }
+
+            let mut value = HashMap::with_capacity(m.len() + len);
+            value.extend(m.iter().map(|(k, v)| (*k, *v)));
+            value
+        }
+        Err(_) => {
+            if let Some(action) = actions.first() {
+                unsafe {
+                    *bad_key = action.key;
+                }
+            }
+            return Term::NONE;
+        }
+    };
+
+    for action in actions {
+        if action.kind != 0 && !value.contains_key(&action.key) {
+            unsafe {
+                *bad_key = action.key;
+            }
+            return Term::NONE;
+        }
+        value.insert(action.key, action.value);
+    }
+
+    current_process().map_from_hash_map(value)
+}
+
 #[export_name = "__lumen_builtin_map.insert"]
 pub extern "C" fn builtin_map_insert(map: Term, key: Term, value: Term) -> Term {
     let decoded_map: Result<Boxed<Map>, _> = map.decode().unwrap().try_into();
@@ -82,6 +202,33 @@ pub extern "C" fn builtin_map_get(map: Term, key: Term) -> Term {
     m.get(key).unwrap_or(Term::NONE)
 }
 
+/// Looks up a constant key on behalf of a call site with an inline cache, i.e. when
+/// the map given is not of the shape cached there. When the map is flat, and the key
+/// is found, the cache is updated with the shape of the map, and the index of the key
+#[export_name = "__lumen_builtin_map.lookup"]
+pub extern "C" fn builtin_map_lookup(
+    map: Term,
+    key: Term,
+    cached_shape: *mut Term,
+    cached_index: *mut usize,
+) -> Term {
+    let decoded_map: Result<Boxed<Map>, _> = map.decode().unwrap().try_into();
+    let m = decoded_map.unwrap();
+    match m.flat_entries() {
+        Some((keys, values)) => match keys.iter().position(|k| *k == key) {
+            Some(index) => {
+                unsafe {
+                    *cached_shape = m.shape().unwrap();
+                    *cached_index = index;
+                }
+                values[index]
+            }
+            None => Term::NONE,
+        },
+        None => m.get(key).unwrap_or(Term::NONE),
+    }
+}
+
 /// Strict equality
 #[export_name = "__lumen_builtin_cmp.eq.strict"]
 pub extern "C" fn builtin_cmpeq_strict(lhs: Term, rhs: Term) -> bool {
@@ -269,6 +416,28 @@ pub extern "C" fn builtin_math_bxor(left: Term, right: Term) -> Term {
     unsafe { erlang_bxor_2(left, right) }
 }
 
+/// Resolves `module:function/arity` for the call site caches of dynamic calls,
+/// returning a null pointer if there is no such function
+#[export_name = "__lumen_builtin_apply_cache_lookup"]
+pub extern "C" fn builtin_apply_cache_lookup(
+    module: Term,
+    function: Term,
+    arity: usize,
+) -> *const c_void {
+    let module_function_arity = match (module.try_into(), function.try_into()) {
+        (Ok(module), Ok(function)) => ModuleFunctionArity {
+            module,
+            function,
+            arity: arity as Arity,
+        },
+        _ => return ptr::null(),
+    };
+
+    find_symbol(&module_function_arity)
+        .map(|callee| callee as *const c_void)
+        .unwrap_or(ptr::null())
+}
+
 /// Capture the data needed to construct a stack trace later
 #[export_name = "__lumen_builtin_trace_capture"]
 pub extern "C" fn builtin_trace_capture() -> Term {
@@ -302,6 +471,110 @@ pub extern "C" fn builtin_binary_finish(builder: *mut BinaryBuilder) -> Term {
     current_process().binary_from_bytes(bytes.as_slice())
 }
 
+/// Presized Binary Construction
+///
+/// When the size of every segment of a binary is known at compile time, the binary is
+/// allocated up front, and each segment is written in place at its offset, rather than
+/// going through a `BinaryBuilder`. The writers below are called for segments which the
+/// generated code doesn't write inline, and return false if the value doesn't fit the
+/// segment, as the `push` builtins do.
+#[export_name = "__lumen_builtin_binary_alloc"]
+pub extern "C" fn builtin_binary_alloc(size: usize) -> Term {
+    current_process().zeroed_binary(size)
+}
+
+#[export_name = "__lumen_builtin_binary_write_integer"]
+pub extern "C" fn builtin_binary_write_integer(
+    data: *mut u8,
+    value: Term,
+    bits: usize,
+    signed: bool,
+    endianness: Endianness,
+) -> bool {
+    let tt = value.decode().unwrap();
+    let val: Result<Integer, _> = tt.try_into();
+    if let Ok(i) = val {
+        let mut builder = BinaryBuilder::new();
+        let flags = BinaryPushFlags::new(signed, endianness);
+        if builder.push_integer(i, bits, flags).is_err() {
+            return false;
+        }
+        let bytes = builder.finish();
+        unsafe {
+            ptr::copy_nonoverlapping(bytes.as_ptr(), data, bytes.len().min(bits / 8));
+        }
+        true
+    } else {
+        false
+    }
+}
+
+#[export_name = "__lumen_builtin_binary_write_float"]
+pub extern "C" fn builtin_binary_write_float(
+    data: *mut u8,
+    value: Term,
+    bits: usize,
+    endianness: Endianness,
+) -> bool {
+    let tt = value.decode().unwrap();
+    let f: f64 = match tt {
+        TypedTerm::SmallInteger(small) => {
+            let i: isize = small.into();
+            i as f64
+        }
+        _ => {
+            let val: Result<Float, _> = tt.try_into();
+            match val {
+                Ok(f) => f.into(),
+                Err(_) => return false,
+            }
+        }
+    };
+    let bytes = match (bits, endianness) {
+        (64, Endianness::Big) => f.to_be_bytes().to_vec(),
+        (64, Endianness::Little) => f.to_le_bytes().to_vec(),
+        (64, Endianness::Native) => f.to_ne_bytes().to_vec(),
+        (32, Endianness::Big) => (f as f32).to_be_bytes().to_vec(),
+        (32, Endianness::Little) => (f as f32).to_le_bytes().to_vec(),
+        (32, Endianness::Native) => (f as f32).to_ne_bytes().to_vec(),
+        _ => return false,
+    };
+    unsafe {
+        ptr::copy_nonoverlapping(bytes.as_ptr(), data, bytes.len());
+    }
+    true
+}
+
+/// Writes the first `len` bytes of the binary `value`, which must have at least that many
+#[export_name = "__lumen_builtin_binary_write_bytes"]
+pub extern "C" fn builtin_binary_write_bytes(data: *mut u8, value: Term, len: usize) -> bool {
+    let dst = unsafe { core::slice::from_raw_parts_mut(data, len) };
+    let mut copy_from = |src: &[u8]| {
+        if src.len() < len {
+            false
+        } else {
+            dst.copy_from_slice(&src[..len]);
+            true
+        }
+    };
+    match value.decode().unwrap() {
+        TypedTerm::HeapBinary(bin) => copy_from(bin.as_bytes()),
+        TypedTerm::ProcBin(bin) => copy_from(bin.as_bytes()),
+        TypedTerm::BinaryLiteral(bin) => copy_from(bin.as_bytes()),
+        TypedTerm::SubBinary(bin) => {
+            if bin.full_byte_len() < len {
+                false
+            } else {
+                for (d, b) in dst.iter_mut().zip(bin.full_byte_iter()) {
+                    *d = b;
+                }
+                true
+            }
+        }
+        _ => false,
+    }
+}
+
 #[export_name = "__lumen_builtin_binary_push_integer"]
 pub extern "C" fn builtin_binary_push_integer(
     builder: &mut BinaryBuilder,
@@ -476,6 +749,25 @@ pub extern "C" fn builtin_binary_push_string(
     BinaryPushResult { builder, success }
 }
 
+/// Wraps a binary in a match context, so that generated code can match its
+/// segments inline; returns none if the input is not a binary
+#[export_name = "__lumen_builtin_binary_match.start"]
+pub extern "C" fn builtin_binary_match_start(bin: Term) -> Term {
+    let process = current_process();
+    let mut heap = process.acquire_heap();
+    let result = match bin.decode().unwrap() {
+        TypedTerm::HeapBinary(bin) => heap.match_context_from_binary(bin),
+        TypedTerm::ProcBin(bin) => heap.match_context_from_binary(bin),
+        TypedTerm::BinaryLiteral(bin) => heap.match_context_from_binary(bin),
+        TypedTerm::SubBinary(bin) => heap.match_context_from_binary(bin),
+        TypedTerm::MatchContext(_) => return bin,
+        _ => return Term::NONE,
+    };
+    result
+        .map(|match_ctx| match_ctx.into())
+        .unwrap_or(Term::NONE)
+}
+
 #[export_name = "__lumen_builtin_binary_match.raw"]
 pub extern "C" fn builtin_binary_match_raw(bin: Term, unit: u8, size: Term) -> BinaryMatchResult {
     let size_opt = if size.is_none() {
@@ -41,7 +41,16 @@ pub fn main_internal() -> i32 {
     }
 
     // Initialize the dispatch table
-    if unsafe { InitializeLumenDispatchTable(SYMBOL_TABLE, NUM_SYMBOLS) } == false {
+    let initialized = unsafe {
+        InitializeLumenStaticDispatchTable(
+            SYMBOL_TABLE,
+            NUM_SYMBOLS,
+            DISPATCH_DISPLACEMENTS,
+            NUM_DISPATCH_DISPLACEMENTS,
+            DISPATCH_HASH_KEY,
+        )
+    };
+    if initialized == false {
         return 103;
     }
 
@@ -17,6 +17,30 @@ extern "C" {
     #[link_name = "__LUMEN_SYMBOL_TABLE"]
     pub static SYMBOL_TABLE: *const FunctionSymbol;
 
+    /// This symbol is defined in the compiled executable,
+    /// and specifies the number of buckets of the perfect hash
+    /// used to lay out the symbol table.
+    #[link_name = "__LUMEN_DISPATCH_DISPLACEMENTS_SIZE"]
+    pub static NUM_DISPATCH_DISPLACEMENTS: usize;
+
+    /// This symbol is defined in the compiled executable,
+    /// and provides a pointer to the displacements of each
+    /// bucket of the perfect hash used to lay out the symbol table.
+    #[link_name = "__LUMEN_DISPATCH_DISPLACEMENTS"]
+    pub static DISPATCH_DISPLACEMENTS: *const u64;
+
+    /// This symbol is defined in the compiled executable,
+    /// and specifies the seed of the perfect hash used to
+    /// lay out the symbol table.
+    #[link_name = "__LUMEN_DISPATCH_HASH_KEY"]
+    pub static DISPATCH_HASH_KEY: u64;
+
     /// This function is defined in `liblumen_alloc::erts::apply`
-    pub fn InitializeLumenDispatchTable(table: *const FunctionSymbol, len: usize) -> bool;
+    pub fn InitializeLumenStaticDispatchTable(
+        table: *const FunctionSymbol,
+        len: usize,
+        displacements: *const u64,
+        num_displacements: usize,
+        key: u64,
+    ) -> bool;
 }
@@ -5,6 +5,8 @@ use stackmaps::{FrameInfo, StackMap};
 use liblumen_alloc::erts::term::prelude::{Boxed, Encoded, Term};
 use lumen_rt_core::process::current_process;
 
+use crate::scheduler::{refill_allocation_buffer, retire_allocation_buffer};
+
 /// On x86_64, calling this function with no arguments will result
 /// in effectively calling __lumen_builtin_gc.run with the return address
 /// of the caller, as well as the base pointer as arguments.
@@ -58,7 +60,16 @@ pub unsafe extern "C" fn builtin_gc_run(
 ) -> bool {
     let iter = RootsIter::new(StackMap::get(), return_address, base_pointer);
     let roots = iter.collect::<Vec<_>>();
-    match current_process().garbage_collect(1, roots) {
+    let process = current_process();
+
+    // The allocation buffer is retired before collecting, so that its unused
+    // remainder is walkable, and since its bounds refer to the heap as it was
+    // before the collection, a fresh buffer is reserved afterwards
+    retire_allocation_buffer();
+    let result = process.garbage_collect(1, roots);
+    refill_allocation_buffer(&process);
+
+    match result {
         Ok(_) => true,
         Err(err) => panic!("garbage collection failed: {}", err),
     }
@@ -1,5 +1,6 @@
 use std::alloc::Layout;
 use std::any::Any;
+use std::cmp;
 use std::ffi::c_void;
 use std::fmt::{self, Debug};
 use std::mem;
@@ -35,6 +36,14 @@ extern "C" {
     #[thread_local]
     static mut CURRENT_REDUCTION_COUNT: u32;
 
+    #[thread_local]
+    #[link_name = "__lumen_heap_top"]
+    static mut HEAP_TOP: *mut u8;
+
+    #[thread_local]
+    #[link_name = "__lumen_heap_limit"]
+    static mut HEAP_LIMIT: *mut u8;
+
     #[unwind(allowed)]
     #[link_name = "__lumen_trap_exceptions"]
     fn trap_exceptions_impl() -> bool;
@@ -111,6 +120,8 @@ pub unsafe extern "C" fn builtin_malloc(kind: u32, arity: usize) -> *mut u8 {
         Ok(TermKind::Closure) => ClosureLayout::for_env_len(arity).layout().clone(),
         Ok(TermKind::Tuple) => Tuple::layout_for_len(arity),
         Ok(TermKind::Cons) => Layout::new::<Cons>(),
+        // Generated code only allocates binaries when it advances a match context
+        Ok(TermKind::Binary) => Layout::new::<MatchContext>(),
         Ok(tk) => {
             unimplemented!("unhandled use of malloc for {:?}", tk);
         }
@@ -123,12 +134,83 @@ pub unsafe extern "C" fn builtin_malloc(kind: u32, arity: usize) -> *mut u8 {
         .alloc_nofrag_layout(layout.clone())
         .or_else(|_| process.alloc_fragment_layout(layout));
 
+    // Generated code only calls this function when the allocation buffer is
+    // exhausted, so reserve a fresh one for the allocations that follow
+    refill_allocation_buffer(process);
+
     match result {
         Ok(nn) => nn.as_ptr() as *mut u8,
         Err(_) => ptr::null_mut(),
     }
 }
 
+/// Ensures the allocation buffer has room for at least `words` words, so that
+/// generated code can carve a group of terms out of it without further checks.
+///
+/// This is only called by generated code when the current buffer is too small.
+#[unwind(allowed)]
+#[export_name = "__lumen_builtin_heap.reserve"]
+pub unsafe extern "C" fn builtin_heap_reserve(words: usize) {
+    let arc_dyn_scheduler = scheduler::current();
+    let s = arc_dyn_scheduler
+        .as_any()
+        .downcast_ref::<Scheduler>()
+        .unwrap();
+    let process = &s.current;
+
+    let size = cmp::max(words, ALLOCATION_BUFFER_WORDS);
+    let result = process
+        .alloc_nofrag(size)
+        .or_else(|_| process.alloc_fragment(size));
+
+    retire_allocation_buffer();
+
+    match result {
+        Ok(nn) => {
+            let start = nn.as_ptr();
+            HEAP_TOP = start as *mut u8;
+            HEAP_LIMIT = start.add(size) as *mut u8;
+        }
+        Err(_) => panic!("unable to reserve {} words on the process heap", words),
+    }
+}
+
+/// The size (in words) of the allocation buffer reserved on the process heap,
+/// from which generated code allocates small terms inline
+const ALLOCATION_BUFFER_WORDS: usize = 256;
+
+/// Reserves a new allocation buffer on the heap of the given process, retiring
+/// the current one. If the heap can't fit a new buffer, generated code will
+/// fall back to `__lumen_builtin_malloc` until the next refill succeeds.
+crate unsafe fn refill_allocation_buffer(process: &Process) {
+    retire_allocation_buffer();
+
+    if let Ok(nn) = process.alloc_nofrag(ALLOCATION_BUFFER_WORDS) {
+        let start = nn.as_ptr();
+        HEAP_TOP = start as *mut u8;
+        HEAP_LIMIT = start.add(ALLOCATION_BUFFER_WORDS) as *mut u8;
+    }
+}
+
+/// Retires the current allocation buffer, if any.
+///
+/// The unused remainder of the buffer is filled with `NONE` so that the heap
+/// remains walkable, and the bounds are reset so that the next inline allocation
+/// takes the slow path. This must be called whenever the process owning the buffer
+/// is swapped out or garbage collected.
+crate fn retire_allocation_buffer() {
+    unsafe {
+        let mut top = HEAP_TOP as *mut Term;
+        let limit = HEAP_LIMIT as *mut Term;
+        while top < limit {
+            ptr::write(top, Term::NONE);
+            top = top.add(1);
+        }
+        HEAP_TOP = ptr::null_mut();
+        HEAP_LIMIT = ptr::null_mut();
+    }
+}
+
 #[unwind(allowed)]
 #[export_name = "lumen_rt_scheduler_unregistered"]
 fn unregistered() -> Arc<dyn lumen_rt_core::scheduler::Scheduler> {
@@ -459,6 +541,10 @@ impl Scheduler {
                         let _ = CURRENT_PROCESS.with(|cp| cp.replace(Some(self.root.clone())));
                         let prev = unsafe { self.current.replace(self.root.clone()) };
 
+                        // The allocation buffer belongs to the previous process,
+                        // so make sure it isn't used by the next one
+                        retire_allocation_buffer();
+
                         // Increment reduction count if not the root process
                         let prev_reductions = reset_reduction_counter();
                         prev.total_reductions